@@ -55,6 +55,8 @@ void mp_get_memory_functions (void *(**) (size_t),
 			      void *(**) (void *, size_t, size_t),
 			      void (**) (void *, size_t));
 
+void mp_set_yield_function (void (*) (void), size_t);
+
 #ifndef MINI_GMP_LIMB_TYPE
 #define MINI_GMP_LIMB_TYPE long
 #endif
@@ -85,6 +87,8 @@ typedef const __mpz_struct *mpz_srcptr;
 
 extern const int mp_bits_per_limb;
 
+void mp_set_karatsuba_thresholds (mp_size_t, mp_size_t);
+
 void mpn_copyi (mp_ptr, mp_srcptr, mp_size_t);
 void mpn_copyd (mp_ptr, mp_srcptr, mp_size_t);
 void mpn_zero (mp_ptr, mp_size_t);
@@ -220,6 +224,7 @@ void mpz_pow_ui (mpz_t, const mpz_t, unsigned long);
 void mpz_ui_pow_ui (mpz_t, unsigned long, unsigned long);
 void mpz_powm (mpz_t, const mpz_t, const mpz_t, const mpz_t);
 void mpz_powm_ui (mpz_t, const mpz_t, unsigned long, const mpz_t);
+void mpz_powm_sec (mpz_t, const mpz_t, const mpz_t, const mpz_t);
 
 void mpz_rootrem (mpz_t, mpz_t, const mpz_t, unsigned long);
 int mpz_root (mpz_t, const mpz_t, unsigned long);
@@ -60,6 +60,25 @@
 /* limits and default values */
 #define VXSSH_AUTH_TRIES_MAX       3
 #define VXSSH_DEFAULT_PORT         22
+#define VXSSH_SESSION_STACK_SIZE   16384   /* also the curve25519 keypair pool task */
+
+/* handshake crypto: run at most RUN ticks out of every SLICE ticks */
+#define VXSSH_CRYPTO_BUDGET_RUN_TICKS      2
+#define VXSSH_CRYPTO_BUDGET_SLICE_TICKS    3
+#define VXSSH_CRYPTO_YIELD_LIMB_OPS        8192
+
+/*
+ * server initiated rekey (RFC 4344, 3.1), whichever comes first.
+ * For aes (128-bit blocks) the RFC limit is 2^32 blocks, the byte limit is far below it;
+ * the packet limit keeps the sequence numbers from wrapping.
+ */
+#define VXSSH_REKEY_BYTES                  (1024ULL * 1024 * 1024)
+#define VXSSH_REKEY_PACKETS                0x80000000
+#define VXSSH_REKEY_SECONDS                3600
+
+/* first start rsa host key generation (server_key_file) */
+#define VXSSH_RSA_KEYGEN_BITS              2048
+#define VXSSH_RSA_KEYGEN_PRIORITY          254
 
 
 typedef enum {
@@ -69,10 +88,19 @@ typedef enum {
 } vxssh_auth_type_t;
 
 typedef struct {
-    char                    *server_key;
+    char                    *server_key;            /* ssh-rsa, PEM */
+    char                    *server_key_ed25519;    /* ssh-ed25519, openssh-key-v1 */
+    char                    *server_key_file;       /* ssh-rsa, vxssh_rsa_key_save() form, generated when it doesn't exist */
+    int                     server_key_bits;        /* 0 - VXSSH_RSA_KEYGEN_BITS */
     char                    *user_key;
     char                    *listen_address;
     int                     listen_port;
+    int                     crypto_run_ticks;       /* 0 - VXSSH_CRYPTO_BUDGET_RUN_TICKS */
+    int                     crypto_slice_ticks;     /* 0 - VXSSH_CRYPTO_BUDGET_SLICE_TICKS */
+    uint64_t                rekey_bytes;            /* 0 - VXSSH_REKEY_BYTES */
+    uint32_t                rekey_packets;          /* 0 - VXSSH_REKEY_PACKETS */
+    int                     rekey_seconds;          /* 0 - VXSSH_REKEY_SECONDS */
+    size_t                  mem_pool_size;          /* slabs of vxssh_mem_alloc(), 0 - 512K */
     vxssh_auth_type_t      auth_type;
 } vxssh_server_config_t;
 
@@ -82,11 +110,23 @@ typedef struct {
     vxssh_auth_type_t      auth_type;
     vxssh_crypto_object_t  *server_key;
     vxssh_crypto_object_t  *user_key;
+    vxssh_crypto_object_t  *server_key_ed25519;
+    vxssh_mbuf_t           *server_key_blob;   /* K_S, wire encoded */
+    vxssh_mbuf_t           *server_key_ed25519_blob;
+    vxssh_mbuf_t           *kexinit;           /* KEXINIT fields after the cookie */
+    vxssh_crypto_object_t  *server_key_pending; /* generated, installed when there are no sessions */
+    char                   *server_key_file;
+    int                     server_key_bits;
+    int                     keygen_tid;
+    bool                    fl_keygen_stop;
     int                     sessions;
     int                     sessions_max;
     int                     auth_tries_max;
     int                     srv_sock;
     int                     con_mgr_tid;
+    uint64_t                rekey_bytes;
+    uint32_t                rekey_packets;
+    int                     rekey_seconds;
     bool                    fl_running;
     bool                    fl_do_shutdown;
     vxssh_session_t        *session;
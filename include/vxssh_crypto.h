@@ -15,12 +15,22 @@
 #define CRYPTO_OBJECT_RSA_PRIVATE_KEY  0x1
 #define CRYPTO_OBJECT_RSA_PUBLIC_KEY   0x2
 #define CRYPTO_OBJECT_RSA_SIGNATURE    0x3
+#define CRYPTO_OBJECT_ED25519_PRIVATE_KEY  0x4
 
 typedef struct {
     int     type;
     void    *obj;
 } vxssh_crypto_object_t;
 
+typedef struct {
+    uint8_t *buf;
+    size_t  size;
+    size_t  used;
+    size_t  top;        /* offset of the last block */
+    size_t  peak;       /* high-water mark */
+    size_t  heap_ops;   /* allocations that didn't fit and went to the heap */
+} vxssh_crypto_arena_t;
+
 typedef struct {
     mpz_t   e;
     mpz_t   n;
@@ -30,12 +40,34 @@ typedef struct {
     mpz_t   e;
     mpz_t   n;
     mpz_t   d;
+    /* CRT (PKCS#1), p = 0 if the key doesn't have it */
+    mpz_t   p;
+    mpz_t   q;
+    mpz_t   dp;
+    mpz_t   dq;
+    mpz_t   qinv;
+    vxssh_crypto_arena_t *arena;    /* bignum scratch of the private operation, sized from n */
+    /* blinding pair: bf = r^e, bfi = r^-1 (mod n), squared after each use */
+    mpz_t   bf;
+    mpz_t   bfi;
+    uint32_t bf_uses;               /* signatures since the pair was generated */
+    SEM_ID  bf_sem;
 } vxssh_crypto_rsa_private_key_t;
 
 typedef struct {
     mpz_t   s;
 } vxssh_crypto_rsa_signature_t;
 
+#define CRYPTO_ED25519_KEY_SIZE        32
+#define CRYPTO_ED25519_SIGNATURE_SIZE  64
+
+typedef struct {
+    uint8_t seed[CRYPTO_ED25519_KEY_SIZE];
+    uint8_t pub[CRYPTO_ED25519_KEY_SIZE];
+    uint8_t scalar[CRYPTO_ED25519_KEY_SIZE];    /* clamped H(seed)[0..31] */
+    uint8_t prefix[CRYPTO_ED25519_KEY_SIZE];    /* H(seed)[32..63] */
+} vxssh_crypto_ed25519_private_key_t;
+
 int vxssh_crypto_object_alloc(vxssh_crypto_object_t **obj, int type);
 
 /* ------------------------------------------------------------------------------------------------------------------------------------------- */
@@ -46,8 +78,27 @@ int vxssh_rsa_decode_public_key(vxssh_mbuf_t *mb, vxssh_crypto_rsa_public_key_t
 int vxssh_rsa_encode_signature(vxssh_mbuf_t *mb, vxssh_crypto_rsa_signature_t *sign);
 int vxssh_rsa_decode_signature(vxssh_mbuf_t *mb, vxssh_crypto_rsa_signature_t *sign);
 int vxssh_rsa_sign(vxssh_crypto_rsa_private_key_t *key, const uint8_t *data, size_t data_len, vxssh_crypto_object_t **signature);
+int vxssh_rsa_private_key_prepare(vxssh_crypto_rsa_private_key_t *key);
+int vxssh_rsa_blinding_update(vxssh_crypto_rsa_private_key_t *key, bool force);
+
+/* keygen progress: a window was sieved, a candidate went to the primality test, a prime was found */
+#define VXSSH_RSA_KEYGEN_STAGE_SIEVE       0
+#define VXSSH_RSA_KEYGEN_STAGE_CANDIDATE   1
+#define VXSSH_RSA_KEYGEN_STAGE_PRIME       2
+typedef int (*vxssh_rsa_keygen_cb_t)(int stage, uint32_t count, void *udata);
+
+int vxssh_rsa_generate_key(vxssh_crypto_object_t **key, uint32_t bits, vxssh_rsa_keygen_cb_t cb, void *udata);
+int vxssh_rsa_key_save(vxssh_mbuf_t *mb, vxssh_crypto_rsa_private_key_t *key);
+int vxssh_rsa_key_load(vxssh_mbuf_t *mb, vxssh_crypto_object_t **key);
 int vxssh_rsa_sign_verfy(vxssh_crypto_rsa_public_key_t *key, vxssh_crypto_object_t *signature, const uint8_t *data, size_t data_len);
 
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* Ed25519 */
+int vxssh_ed25519_key_init(vxssh_crypto_ed25519_private_key_t *key, const uint8_t *seed);
+int vxssh_ed25519_encode_public_key(vxssh_mbuf_t *mb, vxssh_crypto_ed25519_private_key_t *key);
+int vxssh_ed25519_encode_signature(vxssh_mbuf_t *mb, const uint8_t *sig);
+int vxssh_ed25519_sign(vxssh_crypto_ed25519_private_key_t *key, const uint8_t *data, size_t data_len, uint8_t *sig);
+
 /* ------------------------------------------------------------------------------------------------------------------------------------------- */
 /* PEM */
 int vxssh_pem_decode(char *buffer, size_t buffer_len, char *passphrase, vxssh_crypto_object_t **key);
@@ -62,6 +113,22 @@ int vxssh_asn1_get_integer(vxssh_mbuf_t *mb, mpz_t bn);
 /* curve25519 */
 #define CRYPTO_CURVE25519_SIZE 32
 int vxssh_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const unsigned char *p);
+int vxssh_scalarmult_curve25519_base(unsigned char *q, const unsigned char *n);
+int vxssh_curve25519_base_init();
+int vxssh_ed25519_scalarmult_base(unsigned char *p, const unsigned char *a);
+
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* bignum arena */
+int vxssh_crypto_arena_alloc(vxssh_crypto_arena_t **arena, size_t size);
+int vxssh_crypto_arena_begin(vxssh_crypto_arena_t *arena);
+void vxssh_crypto_arena_end(vxssh_crypto_arena_t *arena);
+
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* cpu budget */
+int vxssh_crypto_budget_set(int run_ticks, int slice_ticks);
+void vxssh_crypto_budget_begin();
+void vxssh_crypto_budget_end();
+void vxssh_crypto_yield();
 
 /* ------------------------------------------------------------------------------------------------------------------------------------------- */
 /* RND */
@@ -12,11 +12,37 @@
 #define VXSSH_DIGEST_MD5       0
 #define VXSSH_DIGEST_SHA1      1
 #define VXSSH_DIGEST_SHA256    2
+#define VXSSH_DIGEST_SHA512    3
 
 #define VXSSH_DIGEST_MD5_LENGTH    16
 #define VXSSH_DIGEST_SHA1_LENGTH   20
 #define VXSSH_DIGEST_SHA256_LENGTH 32
+#define VXSSH_DIGEST_SHA512_LENGTH 64
 #define VXSSH_DIGEST_LENGTH_MAX    64
+#define VXSSH_DIGEST_STATE_SIZE_MAX 256     /* the largest algorithm context (sha512) */
+
+/* block transform implementations */
+#define VXSSH_SHA1_IMPL_AUTO       0
+#define VXSSH_SHA1_IMPL_REF        1       /* portable C, memory workspace */
+#define VXSSH_SHA1_IMPL_C          2       /* portable C, schedule in locals */
+#define VXSSH_SHA1_IMPL_SHANI      3       /* x86 SHA extensions */
+
+#define VXSSH_SHA2_IMPL_AUTO       0
+#define VXSSH_SHA2_IMPL_REF        1       /* portable C, rolled */
+#define VXSSH_SHA2_IMPL_UNROLLED   2       /* portable C, unrolled */
+#define VXSSH_SHA2_IMPL_SHANI      3       /* x86 SHA extensions */
+#define VXSSH_SHA2_IMPL_ARMV8      4       /* ARMv8 crypto extensions */
+
+/* ------------------------------------------------------------------------------------------ */
+typedef struct {
+    int     alg;
+    size_t  digest_len;
+    size_t  block_len;
+    size_t  ctx_size;
+    void    (*init)(void *ctx);
+    void    (*update)(void *ctx, const void *data, size_t data_len);
+    void    (*final)(void *ctx, uint8_t *digest);
+} vxssh_digest_ops_t;
 
 /* ------------------------------------------------------------------------------------------ */
 struct _MD5_CTX;
@@ -27,7 +53,9 @@ size_t vxssh_md5_block_len();
 size_t vxssh_md5_ctx_size();
 int vxssh_md5_init(vxssh_md5_ctx_t **ctx);
 int vxssh_md5_update(vxssh_md5_ctx_t *ctx, const void *data, size_t data_size);
+int vxssh_md5_final(vxssh_md5_ctx_t *ctx, uint8_t *digest);
 int vxssh_md5_digest(const void *input, size_t input_len, uint8_t *digest, size_t digest_len);
+extern const vxssh_digest_ops_t vxssh_md5_ops;
 
 /* ------------------------------------------------------------------------------------------ */
 struct _SHA1_CTX;
@@ -40,6 +68,9 @@ int vxssh_sha1_init(vxssh_sha1_ctx_t **ctx);
 int vxssh_sha1_update(vxssh_sha1_ctx_t *ctx, const void *data, size_t data_size);
 int vxssh_sha1_final(vxssh_sha1_ctx_t *ctx, uint8_t *digest);
 int vxssh_sha1_digest(const void *input, size_t input_len, uint8_t *digest, size_t digest_len);
+extern const vxssh_digest_ops_t vxssh_sha1_ops;
+int vxssh_sha1_set_impl(int impl);
+int vxssh_sha1_get_impl();
 
 /* ------------------------------------------------------------------------------------------ */
 struct _SHA256_CTX;
@@ -52,19 +83,40 @@ int vxssh_sha256_init(vxssh_sha256_ctx_t **ctx);
 int vxssh_sha256_update(vxssh_sha256_ctx_t *ctx, const void *data, size_t data_size);
 int vxssh_sha256_final(vxssh_sha256_ctx_t *ctx, uint8_t *digest);
 int vxssh_sha256_digest(const void *input, size_t input_len, uint8_t *digest, size_t digest_len);
+extern const vxssh_digest_ops_t vxssh_sha256_ops;
+int vxssh_sha256_set_impl(int impl);
+int vxssh_sha256_get_impl();
+
+/* ------------------------------------------------------------------------------------------ */
+struct _SHA512_CTX;
+typedef struct _SHA512_CTX vxssh_sha512_ctx_t;
+
+size_t vxssh_sha512_digest_len();
+size_t vxssh_sha512_block_len();
+size_t vxssh_sha512_ctx_size();
+int vxssh_sha512_init(vxssh_sha512_ctx_t **ctx);
+int vxssh_sha512_update(vxssh_sha512_ctx_t *ctx, const void *data, size_t data_size);
+int vxssh_sha512_final(vxssh_sha512_ctx_t *ctx, uint8_t *digest);
+int vxssh_sha512_digest(const void *input, size_t input_len, uint8_t *digest, size_t digest_len);
+extern const vxssh_digest_ops_t vxssh_sha512_ops;
 
 /* ------------------------------------------------------------------------------------------ */
 typedef struct {
+    const vxssh_digest_ops_t *ops;
     int     alg;
     size_t  digest_len;
     size_t  block_length;
-    void    *ctx;
+    uint64_t state[];       /* algorithm context (ops->ctx_size), same allocation */
 } vxssh_digest_ctx_t;
 
+const vxssh_digest_ops_t *vxssh_digest_get_ops(int alg);
 size_t vxssh_digest_bytes(int alg);
 size_t vxssh_digest_block_size(int alg);
+size_t vxssh_digest_ctx_size(int alg);
 
 int vxssh_digest_alloc(vxssh_digest_ctx_t **ctx, int alg);
+int vxssh_digest_setup(vxssh_digest_ctx_t *ctx, int alg);
+int vxssh_digest_reset(vxssh_digest_ctx_t *ctx);
 int vxssh_digest_update(vxssh_digest_ctx_t *ctx, void *data, size_t data_len);
 int vxssh_digest_final(vxssh_digest_ctx_t *ctx, uint8_t *digest, size_t digest_len);
 int vxssh_digest_memory(int alg, const void *m, size_t mlen, uint8_t *d, size_t dlen);
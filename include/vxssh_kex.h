@@ -12,6 +12,10 @@
 
 #define VXSSH_KEX_C25519_SHA256  1
 
+/* pre-generated ephemeral keys */
+#define VXSSH_KEX_C25519_POOL_SIZE      4
+#define VXSSH_KEX_C25519_POOL_PRIORITY  250
+
 typedef struct {
     vxssh_cipher_ctx_t *enc;
     vxssh_mac_ctx_t    *mac;
@@ -22,8 +26,10 @@ typedef struct {
     int     keyringing;
     int     hash_alg;
     int     we_need;
-    vxssh_kex_newkeys_t keys_in;
+    vxssh_kex_newkeys_t keys_in;       /* active, NULL until the first NEWKEYS */
     vxssh_kex_newkeys_t keys_out;
+    vxssh_kex_newkeys_t next_in;       /* derived, waiting for NEWKEYS */
+    vxssh_kex_newkeys_t next_out;
     //
     uint8_t     *session_id;
     size_t      session_id_len;
@@ -38,7 +44,9 @@ typedef struct {
     size_t      client_kex_init_len;
     size_t      server_kex_init_len;
     //
-    uint32_t                        first_follows;
+    bool                            first_follows;
+    bool                            fl_wrong_guess;     /* the guessed packet should be ignored */
+    bool                            fl_kexinit_sent;    /* server KEXINIT is already out */
     vxssh_kex_alg_props_t          *kex_algorithm;
     vxssh_skey_alg_props_t         *server_key_algorithm;
     vxssh_cipher_alg_props_t       *cipher_algorithm;
@@ -50,12 +58,16 @@ typedef struct {
 int vxssh_kex_alloc(vxssh_kex_t **kex);
 int vxssh_kex_newkeys_realloc(vxssh_kex_t *kex);
 int vxssh_kex_newkeys_init(vxssh_kex_t *kex);
+int vxssh_kex_newkeys_activate(vxssh_kex_t *kex, bool out);
 
 int vxssh_kex_derive_keys(vxssh_kex_t *kex, uint8_t *hash, size_t hashlen, uint8_t *shared_secret, size_t shared_secret_len);
 
 /* kex25519 */
-int vxssh_kex_c25519_keygen(uint8_t *key, uint8_t *pub);
-int vxssh_kex_c25519_shared_key(const uint8_t *key, const uint8_t *pub, uint8_t **out, size_t *out_len);
+int vxssh_kex_c25519_pool_start();
+void vxssh_kex_c25519_pool_stop();
+int vxssh_kex_c25519_pool_take(uint8_t key[CRYPTO_CURVE25519_SIZE], uint8_t pub[CRYPTO_CURVE25519_SIZE]);
+int vxssh_kex_c25519_keygen(uint8_t key[CRYPTO_CURVE25519_SIZE], uint8_t pub[CRYPTO_CURVE25519_SIZE]);
+int vxssh_kex_c25519_shared_key(const uint8_t key[CRYPTO_CURVE25519_SIZE], const uint8_t pub[CRYPTO_CURVE25519_SIZE], uint8_t **out, size_t *out_len);
 int vxssh_kex_c25519_hash(int hash_alg,
     const uint8_t *client_version_string, size_t client_version_string_len,
     const uint8_t *server_version_string, size_t server_version_string_len,
@@ -50,5 +50,6 @@ int vxssh_mbuf_read_str(vxssh_mbuf_t *mb, char *str, size_t *size);
 
 int vxssh_mbuf_write_mpint(vxssh_mbuf_t *mb, const mpz_t bn);
 int vxssh_mbuf_read_mpint(vxssh_mbuf_t *mb, mpz_t bn);
+int vxssh_mbuf_write_bn_sz(vxssh_mbuf_t *mb, const mpz_t bn);
 
 #endif
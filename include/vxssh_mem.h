@@ -7,12 +7,41 @@
 #define VXSSH_MEM_H
 #include <vxWorks.h>
 
+/* pool size classes: 16, 32 .. 4096 bytes, the bigger ones go to malloc */
+#define VXSSH_MEM_POOL_CLASSES     9
+#define VXSSH_MEM_POOL_MAX_SIZE    4096
+
 typedef void (vxssh_mem_destructor_h)(void *data);
 typedef struct {
-    uint32_t nrefs;
+    uint16_t nrefs;
+    uint16_t cls;       /* pool class + 1, 0 - malloc, or an arena block */
     vxssh_mem_destructor_h *dh;
 } vxssh_mem_t;
 
+typedef struct {
+    uint32_t size;      /* the class, bytes */
+    uint32_t slabs;
+    uint32_t blocks;    /* carved from the slabs */
+    uint32_t used;
+    uint32_t peak;
+    uint32_t misses;    /* the pool limit was reached, went to malloc */
+} vxssh_mem_pool_stats_t;
+
+/*
+ * bump allocator owned by one task (not locked):
+ * the long-lived objects grow up from the bottom, a scope of short-lived ones grows down from the top
+ * and goes back in one piece. Whatever doesn't fit comes from the pool
+ */
+typedef struct {
+    uint8_t     *buf;
+    size_t      size;
+    size_t      lo;         /* the bottom objects end */
+    size_t      hi;         /* the scope start */
+    size_t      peak;       /* of both */
+    uint32_t    misses;     /* didn't fit, went to the pool */
+    bool        fl_scope;
+} vxssh_mem_arena_t;
+
 void *vxssh_mem_alloc(size_t size, vxssh_mem_destructor_h *dh);
 void *vxssh_mem_zalloc(size_t size, vxssh_mem_destructor_h *dh);
 void *vxssh_mem_realloc(void *data, size_t size);
@@ -23,5 +52,15 @@ void *vxssh_mem_ref(void *data);
 void *vxssh_mem_deref(void *data);
 uint32_t vxssh_mem_get_refs(const void *data);
 
+int vxssh_mem_pool_init(size_t max_size);
+int vxssh_mem_pool_get_stats(vxssh_mem_pool_stats_t *stats, uint32_t *large);
+void vxssh_mem_pool_show();
+
+int vxssh_mem_arena_alloc(vxssh_mem_arena_t **arena, size_t size);
+void *vxssh_mem_arena_zalloc(vxssh_mem_arena_t *arena, size_t size, vxssh_mem_destructor_h *dh);
+void *vxssh_mem_arena_scope_zalloc(vxssh_mem_arena_t *arena, size_t size, vxssh_mem_destructor_h *dh);
+int vxssh_mem_arena_scope_begin(vxssh_mem_arena_t *arena);
+int vxssh_mem_arena_scope_end(vxssh_mem_arena_t *arena);
+
 
 #endif
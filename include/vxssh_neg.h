@@ -10,6 +10,8 @@
 
 typedef struct {
     char        *name;
+    int         type;       /* CRYPTO_OBJECT_xxx_PRIVATE_KEY */
+    bool        enabled;    /* a host key of this type is loaded */
 } vxssh_skey_alg_props_t;
 
 typedef struct {
@@ -42,11 +44,13 @@ typedef struct {
     int     type;
 } vxssh_compression_alg_props_t;
 
+int vxssh_neg_enable_server_key_algorithm(int type, bool enable);
 int vxssh_neg_get_server_key_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf);
 int vxssh_neg_get_kex_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf);
 int vxssh_neg_get_mac_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf);
 int vxssh_neg_get_cipher_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf);
 int vxssh_neg_get_compression_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf);
+int vxssh_neg_get_kexinit(vxssh_mbuf_t *mb);
 
 vxssh_skey_alg_props_t* vxssh_neg_select_server_key_algorithm(vxssh_mbuf_t *mb, size_t blen);
 vxssh_kex_alg_props_t* vxssh_neg_select_kex_algorithm(vxssh_mbuf_t *mb, size_t blen);
@@ -19,7 +19,10 @@ int vxssh_packet_receive(vxssh_session_t *session, vxssh_mbuf_t *mbuf, int timeo
 int vxssh_packet_send(vxssh_session_t *session, vxssh_mbuf_t *mbuf);
 
 int vxssh_packet_io_hello(vxssh_session_t *session, int timeout);
+int vxssh_packet_kexinit_build(vxssh_session_t *session, vxssh_mbuf_t *mbuf);
+int vxssh_packet_kexinit_parse(vxssh_session_t *session, vxssh_mbuf_t *mbuf);
 int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout);
+int vxssh_packet_kexecdh_reply(vxssh_session_t *session, vxssh_mbuf_t *mbuf);
 int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout);
 int vxssh_packet_io_auth(vxssh_session_t *session, int timeout);
 
@@ -33,6 +36,7 @@ int vxssh_packet_do_channel_data(vxssh_session_t *session, size_t *data_len);
 int vxssh_packet_send_channel_eof(vxssh_session_t *session, vxssh_channel_t *channel);
 int vxssh_packet_send_channel_close(vxssh_session_t *session, vxssh_channel_t *channel);
 int vxssh_packet_send_channel_data(vxssh_session_t *session, vxssh_channel_t *channel, uint8_t *data, size_t data_len);
+int vxssh_packet_send_channel_deferred(vxssh_session_t *session);
 
 int vxssh_packet_send_disconnect(vxssh_session_t *session, int reason, char *message);
 int vxssh_packet_send_unimplemented(vxssh_session_t *session);
@@ -11,6 +11,10 @@
 #include "vxssh_channel.h"
 #include "vxssh_kex.h"
 
+#define VXSSH_SESSION_RXBUF_SIZE   1024
+#define VXSSH_SESSION_ARENA_SIZE   VXSSH_MEM_POOL_MAX_SIZE     /* one block of the biggest pool class */
+#define VXSSH_SESSION_DEFER_SIZE   1024                        /* channel replies held by a rekey */
+
 typedef enum {
     VXSSH_SESSION_STATE_HELLO,
     VXSSH_SESSION_STATE_NEG,
@@ -19,6 +23,14 @@ typedef enum {
     VXSSH_SESSION_STATE_TERMINATE
 } vxssh_session_state_t;
 
+/* key re-exchange inside the work loop */
+typedef enum {
+    VXSSH_REKEY_STATE_NONE,
+    VXSSH_REKEY_STATE_KEXINIT_SENT,     /* waiting for the client KEXINIT */
+    VXSSH_REKEY_STATE_WAIT_ECDH_INIT,
+    VXSSH_REKEY_STATE_WAIT_NEWKEYS      /* s2c is on the new keys already */
+} vxssh_rekey_state_t;
+
 
 typedef struct {
     int                     id;
@@ -28,10 +40,16 @@ typedef struct {
     vxssh_session_state_t  state;
     vxssh_kex_t            *kex;
     vxssh_mbuf_t           *iobuf;
+    vxssh_mbuf_t           *rxbuf;     /* read ahead (banner + first packets) */
+    vxssh_mbuf_t           *defer;     /* channel replies held between our KEXINIT and our NEWKEYS */
     vxssh_channel_t        *channel;
+    vxssh_mem_arena_t      *arena;     /* the session strings + the handshake scope */
     uint32_t                send_seq;
     uint32_t                recv_seq;
-    bool                    fl_rekeying_done;
+    vxssh_rekey_state_t    rekey_state;
+    uint64_t                rekey_bytes;    /* both directions, since the last NEWKEYS */
+    uint32_t                rekey_packets;
+    ULONG                   rekey_ticks;    /* tickGet() at the last NEWKEYS */
     bool                    fl_authorized;
 
 } vxssh_session_t;
@@ -40,4 +58,8 @@ int vxssh_session_alloc(vxssh_session_t **session);
 int vxssh_session_set_peerip(vxssh_session_t *session, char *ip);
 int vxssh_session_start_io_helper(vxssh_session_t *session);
 
+size_t vxssh_session_rx_pending(vxssh_session_t *session);
+int vxssh_session_rx_fill(vxssh_session_t *session);
+int vxssh_session_read(vxssh_session_t *session, void *buf, size_t size);
+
 #endif
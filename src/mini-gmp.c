@@ -94,6 +94,7 @@ see https://www.gnu.org/licenses/.  */
 #define gmp_assert_nocarry(x) do { \
     mp_limb_t __cy = (x);	   \
     assert (__cy == 0);		   \
+    (void) (__cy);		   \
   } while (0)
 
 #define gmp_clz(count, x) do {						\
@@ -133,6 +134,61 @@ see https://www.gnu.org/licenses/.  */
     (sl) = __x;								\
   } while (0)
 
+/* Double-limb multiply: (w1, w0) = u * v, and (w1, w0) = u * v + a + b,
+   which can't overflow. Native forms where the compiler or the core has
+   them, MINI_GMP_NO_ASM leaves the portable C. */
+#if defined(__GNUC__) && !defined(MINI_GMP_NO_ASM) && defined(__SIZEOF_INT128__) \
+    && (defined(__x86_64__) || defined(__aarch64__))
+/* MUL (MULX with -mbmi2) / MUL+UMULH, the carries stay in the flags */
+#define gmp_umul_ppmm(w1, w0, u, v)					\
+  do {									\
+    unsigned __int128 __ww = (unsigned __int128) (u) * (v);		\
+    (w0) = (mp_limb_t) __ww;						\
+    (w1) = (mp_limb_t) (__ww >> GMP_LIMB_BITS);				\
+  } while (0)
+
+#define gmp_umul_ppmm_add2(w1, w0, u, v, a, b)				\
+  do {									\
+    unsigned __int128 __ww = (unsigned __int128) (u) * (v)		\
+      + (mp_limb_t) (a) + (mp_limb_t) (b);				\
+    (w0) = (mp_limb_t) __ww;						\
+    (w1) = (mp_limb_t) (__ww >> GMP_LIMB_BITS);				\
+  } while (0)
+
+#elif defined(__GNUC__) && !defined(MINI_GMP_NO_ASM) && defined(__arm__) \
+    && (!defined(__thumb__) || defined(__thumb2__)) && !defined(__LP64__)
+/* UMULL, UMAAL on v6 and later, UMLAL before it (ARM7TDMI) */
+#define gmp_umul_ppmm(w1, w0, u, v)					\
+  do {									\
+    mp_limb_t __w0, __w1;						\
+    __asm__ ("umull %0, %1, %2, %3"					\
+	     : "=&r" (__w0), "=&r" (__w1) : "r" (u), "r" (v));		\
+    (w0) = __w0;							\
+    (w1) = __w1;							\
+  } while (0)
+
+#if defined(__ARM_ARCH) && (__ARM_ARCH >= 6)
+#define gmp_umul_ppmm_add2(w1, w0, u, v, a, b)				\
+  do {									\
+    mp_limb_t __w0 = (a), __w1 = (b);					\
+    __asm__ ("umaal %0, %1, %2, %3"					\
+	     : "+r" (__w0), "+r" (__w1) : "r" (u), "r" (v));		\
+    (w0) = __w0;							\
+    (w1) = __w1;							\
+  } while (0)
+#else
+#define gmp_umul_ppmm_add2(w1, w0, u, v, a, b)				\
+  do {									\
+    mp_limb_t __w0 = (a), __w1 = 0, __b = (b);				\
+    __asm__ ("umlal %0, %1, %2, %3"					\
+	     : "+&r" (__w0), "+&r" (__w1) : "r" (u), "r" (v));		\
+    __w0 += __b;							\
+    (w1) = __w1 + (__w0 < __b);						\
+    (w0) = __w0;							\
+  } while (0)
+#endif
+
+#else
 #define gmp_umul_ppmm(w1, w0, u, v)					\
   do {									\
     int LOCAL_GMP_LIMB_BITS = GMP_LIMB_BITS;				\
@@ -148,6 +204,12 @@ see https://www.gnu.org/licenses/.  */
 	w0 = (mp_limb_t) __ww;						\
 	w1 = (mp_limb_t) (__ww >> LOCAL_GMP_LIMB_BITS);			\
       }									\
+    else if (sizeof(unsigned long long) * CHAR_BIT >= 2 * GMP_LIMB_BITS) \
+      {									\
+	unsigned long long __ww = (unsigned long long) (u) * (v);	\
+	w0 = (mp_limb_t) __ww;						\
+	w1 = (mp_limb_t) (__ww >> LOCAL_GMP_LIMB_BITS);			\
+      }									\
     else {								\
       mp_limb_t __x0, __x1, __x2, __x3;					\
       unsigned __ul, __vl, __uh, __vh;					\
@@ -173,6 +235,18 @@ see https://www.gnu.org/licenses/.  */
     }									\
   } while (0)
 
+#define gmp_umul_ppmm_add2(w1, w0, u, v, a, b)				\
+  do {									\
+    mp_limb_t __h, __l, __a = (a), __b = (b);				\
+    gmp_umul_ppmm (__h, __l, u, v);					\
+    __l += __a;								\
+    __h += (__l < __a);							\
+    __l += __b;								\
+    (w1) = __h + (__l < __b);						\
+    (w0) = __l;								\
+  } while (0)
+#endif
+
 #define gmp_udiv_qrnnd_preinv(q, r, nh, nl, d, di)			\
   do {									\
     mp_limb_t _qh, _ql, _r, _mask;					\
@@ -345,6 +419,16 @@ void mp_set_memory_functions (void *(*alloc_func) (size_t), void *(*realloc_func
     gmp_free_func = free_func;
 }
 
+/* Cooperative yielding for long operations: the hook is called after
+   about INTERVAL limb multiplications. */
+static void (*gmp_yield_func) (void) = NULL;
+static size_t gmp_yield_interval = 0;
+
+void mp_set_yield_function (void (*yield_func) (void), size_t interval) {
+    gmp_yield_func = yield_func;
+    gmp_yield_interval = interval;
+}
+
 #define gmp_xalloc(size) ((*gmp_allocate_func)((size)))
 #define gmp_free(p) ((*gmp_free_func) ((p), 0))
 
@@ -490,17 +574,14 @@ mp_limb_t mpn_sub (mp_ptr rp, mp_srcptr ap, mp_size_t an, mp_srcptr bp, mp_size_
 }
 
 mp_limb_t mpn_mul_1 (mp_ptr rp, mp_srcptr up, mp_size_t n, mp_limb_t vl) {
-    mp_limb_t ul, cl, hpl, lpl;
+    mp_limb_t ul, cl, lpl;
 
     assert (n >= 1);
 
     cl = 0;
     do {
         ul = *up++;
-        gmp_umul_ppmm (hpl, lpl, ul, vl);
-
-        lpl += cl;
-        cl = (lpl < cl) + hpl;
+        gmp_umul_ppmm_add2 (cl, lpl, ul, vl, cl, 0);
 
         *rp++ = lpl;
     } while (--n != 0);
@@ -509,21 +590,15 @@ mp_limb_t mpn_mul_1 (mp_ptr rp, mp_srcptr up, mp_size_t n, mp_limb_t vl) {
 }
 
 mp_limb_t mpn_addmul_1 (mp_ptr rp, mp_srcptr up, mp_size_t n, mp_limb_t vl) {
-    mp_limb_t ul, cl, hpl, lpl, rl;
+    mp_limb_t ul, cl, lpl;
 
     assert (n >= 1);
 
     cl = 0;
     do {
         ul = *up++;
-        gmp_umul_ppmm (hpl, lpl, ul, vl);
-
-        lpl += cl;
-        cl = (lpl < cl) + hpl;
+        gmp_umul_ppmm_add2 (cl, lpl, ul, vl, cl, *rp);
 
-        rl = *rp;
-        lpl = rl + lpl;
-        cl += lpl < rl;
         *rp++ = lpl;
     } while (--n != 0);
 
@@ -538,26 +613,19 @@ mp_limb_t mpn_submul_1 (mp_ptr rp, mp_srcptr up, mp_size_t n, mp_limb_t vl) {
     cl = 0;
     do {
         ul = *up++;
-        gmp_umul_ppmm (hpl, lpl, ul, vl);
-
-        lpl += cl;
-        cl = (lpl < cl) + hpl;
+        gmp_umul_ppmm_add2 (hpl, lpl, ul, vl, cl, 0);
 
         rl = *rp;
         lpl = rl - lpl;
-        cl += lpl > rl;
+        cl = hpl + (lpl > rl);
         *rp++ = lpl;
     } while (--n != 0);
 
     return cl;
 }
 
-mp_limb_t mpn_mul (mp_ptr rp, mp_srcptr up, mp_size_t un, mp_srcptr vp, mp_size_t vn) {
-    assert (un >= vn);
-    assert (vn >= 1);
-    assert (!GMP_MPN_OVERLAP_P(rp, un + vn, up, un));
-    assert (!GMP_MPN_OVERLAP_P(rp, un + vn, vp, vn));
-
+static void
+mpn_mul_basecase (mp_ptr rp, mp_srcptr up, mp_size_t un, mp_srcptr vp, mp_size_t vn) {
     /* We first multiply by the low order limb. This result can be
        stored, not added, to rp. We also avoid a loop for zeroing this
        way. */
@@ -571,7 +639,188 @@ mp_limb_t mpn_mul (mp_ptr rp, mp_srcptr up, mp_size_t un, mp_srcptr vp, mp_size_
         rp += 1, vp += 1;
         rp[un] = mpn_addmul_1 (rp, up, un, vp[0]);
     }
-    return rp[un];
+}
+
+/* Every cross product a[i] * a[j], i < j, once, then doubled, then the
+   squares of the limbs on the diagonal. */
+static void
+mpn_sqr_basecase (mp_ptr rp, mp_srcptr ap, mp_size_t n) {
+    mp_limb_t hi, lo, cy, r;
+    mp_size_t i;
+
+    if (n == 1) {
+        gmp_umul_ppmm (rp[1], rp[0], ap[0], ap[0]);
+        return;
+    }
+
+    rp[0] = 0;
+    rp[n] = mpn_mul_1 (rp + 1, ap + 1, n - 1, ap[0]);
+    for (i = 1; i < n - 1; i++)
+        rp[n + i] = mpn_addmul_1 (rp + 2 * i + 1, ap + i + 1, n - i - 1, ap[i]);
+    rp[2 * n - 1] = mpn_lshift (rp + 1, rp + 1, 2 * n - 2, 1);
+
+    cy = 0;
+    for (i = 0; i < n; i++) {
+        gmp_umul_ppmm (hi, lo, ap[i], ap[i]);
+        lo += cy;
+        hi += (lo < cy);
+        r = rp[2 * i] + lo;
+        hi += (r < lo);
+        rp[2 * i] = r;
+        r = rp[2 * i + 1] + hi;
+        cy = (r < hi);
+        rp[2 * i + 1] = r;
+    }
+}
+
+/* Karatsuba, above the thresholds (in limbs, tunable for the target). */
+#define GMP_MUL_KARATSUBA_THRESHOLD 24
+#define GMP_SQR_KARATSUBA_THRESHOLD 32
+
+static mp_size_t gmp_mul_kara_threshold = GMP_MUL_KARATSUBA_THRESHOLD;
+static mp_size_t gmp_sqr_kara_threshold = GMP_SQR_KARATSUBA_THRESHOLD;
+
+/* 0 restores the default, anything under 4 limbs is raised to 4 */
+void mp_set_karatsuba_thresholds (mp_size_t mul, mp_size_t sqr) {
+    gmp_mul_kara_threshold = (mul > 0 ? GMP_MAX (mul, 4) : GMP_MUL_KARATSUBA_THRESHOLD);
+    gmp_sqr_kara_threshold = (sqr > 0 ? GMP_MAX (sqr, 4) : GMP_SQR_KARATSUBA_THRESHOLD);
+}
+
+/* scratch limbs of an n x n product */
+static mp_size_t
+mpn_kara_itch (mp_size_t n, mp_size_t threshold) {
+    mp_size_t n1, itch = 0;
+
+    while (n >= threshold) {
+        n1 = n - (n >> 1);
+        itch += 6 * n1 + 2;
+        n = n1;
+    }
+    return itch;
+}
+
+/* dp = |a - b|, a has n1 limbs, b has n1 or n1 - 1; tp has n1 limbs.
+   Returns all ones if a < b. Both differences are computed, no branch
+   on the values. */
+static mp_limb_t
+mpn_kara_absdiff (mp_ptr dp, mp_srcptr ap, mp_size_t n1, mp_srcptr bp, mp_size_t n2, mp_ptr tp) {
+    mp_limb_t mask;
+    mp_size_t i;
+
+    mask = -mpn_sub (dp, ap, n1, bp, n2);
+    mpn_copyi (tp, bp, n2);
+    if (n2 < n1)
+        tp[n2] = 0;
+    mpn_sub_n (tp, tp, ap, n1);
+    for (i = 0; i < n1; i++)
+        dp[i] = (dp[i] & ~mask) | (tp[i] & mask);
+    return mask;
+}
+
+/* a = a1 B^n1 + a0, b = b1 B^n1 + b0
+   a0 b1 + a1 b0 = a0 b0 + a1 b1 - (a0 - a1)(b0 - b1) */
+static void
+mpn_kara_mul_n (mp_ptr rp, mp_srcptr ap, mp_srcptr bp, mp_size_t n, mp_ptr ws) {
+    mp_size_t n1, n2, i;
+    mp_ptr da, db, z1, mid;
+    mp_limb_t mask;
+
+    if (n < gmp_mul_kara_threshold) {
+        mpn_mul_basecase (rp, ap, n, bp, n);
+        return;
+    }
+    n2 = n >> 1;
+    n1 = n - n2;
+    da = ws;
+    db = da + n1;
+    z1 = db + n1;
+    mid = z1 + 2 * n1 + 1;
+    ws = mid + 2 * n1 + 1;
+
+    /* the signs differ: the cross term is z0 + z2 + |..|, otherwise minus */
+    mask = mpn_kara_absdiff (da, ap, n1, ap + n1, n2, z1);
+    mask ^= mpn_kara_absdiff (db, bp, n1, bp + n1, n2, z1);
+    mpn_kara_mul_n (z1, da, db, n1, ws);
+
+    mpn_kara_mul_n (rp, ap, bp, n1, ws);
+    mpn_kara_mul_n (rp + 2 * n1, ap + n1, bp + n1, n2, ws);
+
+    mid[2 * n1] = mpn_add (mid, rp, 2 * n1, rp + 2 * n1, 2 * n2);
+    z1[2 * n1] = 0;
+    for (i = 0; i <= 2 * n1; i++)
+        z1[i] ^= ~mask;
+    mpn_add_1 (z1, z1, 2 * n1 + 1, ~mask & 1);
+    mpn_add_n (mid, mid, z1, 2 * n1 + 1);
+
+    gmp_assert_nocarry (mpn_add (rp + n1, rp + n1, 2 * n2 + n1, mid, 2 * n1 + 1));
+}
+
+/* a0 a1 * 2 = a0^2 + a1^2 - (a0 - a1)^2 */
+static void
+mpn_kara_sqr (mp_ptr rp, mp_srcptr ap, mp_size_t n, mp_ptr ws) {
+    mp_size_t n1, n2;
+    mp_ptr da, z1, mid;
+
+    if (n < gmp_sqr_kara_threshold) {
+        mpn_sqr_basecase (rp, ap, n);
+        return;
+    }
+    n2 = n >> 1;
+    n1 = n - n2;
+    da = ws;
+    z1 = da + n1;
+    mid = z1 + 2 * n1;
+    ws = mid + 2 * n1 + 1;
+
+    mpn_kara_absdiff (da, ap, n1, ap + n1, n2, z1);
+    mpn_kara_sqr (z1, da, n1, ws);
+
+    mpn_kara_sqr (rp, ap, n1, ws);
+    mpn_kara_sqr (rp + 2 * n1, ap + n1, n2, ws);
+
+    mid[2 * n1] = mpn_add (mid, rp, 2 * n1, rp + 2 * n1, 2 * n2);
+    gmp_assert_nocarry (mpn_sub (mid, mid, 2 * n1 + 1, z1, 2 * n1));
+
+    gmp_assert_nocarry (mpn_add (rp + n1, rp + n1, 2 * n2 + n1, mid, 2 * n1 + 1));
+}
+
+mp_limb_t mpn_mul (mp_ptr rp, mp_srcptr up, mp_size_t un, mp_srcptr vp, mp_size_t vn) {
+    mp_ptr ws, pp;
+    mp_size_t done, tail;
+    mp_limb_t cy;
+
+    assert (un >= vn);
+    assert (vn >= 1);
+    assert (!GMP_MPN_OVERLAP_P(rp, un + vn, up, un));
+    assert (!GMP_MPN_OVERLAP_P(rp, un + vn, vp, vn));
+
+    if (up == vp && un == vn) {
+        mpn_sqr (rp, up, un);
+        return rp[2 * un - 1];
+    }
+    if (vn < gmp_mul_kara_threshold) {
+        mpn_mul_basecase (rp, up, un, vp, vn);
+        return rp[un + vn - 1];
+    }
+
+    /* unbalanced: vn x vn blocks of up, the rest goes through mpn_mul again */
+    ws = gmp_xalloc_limbs (mpn_kara_itch (vn, gmp_mul_kara_threshold) + (un > vn ? 2 * vn : 0));
+    pp = ws + mpn_kara_itch (vn, gmp_mul_kara_threshold);
+
+    mpn_kara_mul_n (rp, up, vp, vn, ws);
+    for (done = vn; un - done >= vn; done += vn) {
+        mpn_kara_mul_n (pp, up + done, vp, vn, ws);
+        cy = mpn_add_n (rp + done, rp + done, pp, vn);
+        mpn_add_1 (rp + done + vn, pp + vn, vn, cy);
+    }
+    tail = un - done;
+    if (tail > 0) {
+        mpn_mul (pp, vp, vn, up + done, tail);
+        cy = mpn_add_n (rp + done, rp + done, pp, vn);
+        mpn_add_1 (rp + done + vn, pp + vn, tail, cy);
+    }
+    gmp_free (ws);
+    return rp[un + vn - 1];
 }
 
 void mpn_mul_n (mp_ptr rp, mp_srcptr ap, mp_srcptr bp, mp_size_t n) {
@@ -579,7 +828,18 @@ void mpn_mul_n (mp_ptr rp, mp_srcptr ap, mp_srcptr bp, mp_size_t n) {
 }
 
 void mpn_sqr (mp_ptr rp, mp_srcptr ap, mp_size_t n) {
-    mpn_mul (rp, ap, n, ap, n);
+    mp_ptr ws;
+
+    assert (n >= 1);
+    assert (!GMP_MPN_OVERLAP_P(rp, 2 * n, ap, n));
+
+    if (n < gmp_sqr_kara_threshold) {
+        mpn_sqr_basecase (rp, ap, n);
+        return;
+    }
+    ws = gmp_xalloc_limbs (mpn_kara_itch (n, gmp_sqr_kara_threshold));
+    mpn_kara_sqr (rp, ap, n, ws);
+    gmp_free (ws);
 }
 
 mp_limb_t mpn_lshift (mp_ptr rp, mp_srcptr up, mp_size_t n, unsigned int cnt) {
@@ -2645,6 +2905,7 @@ mpz_powm (mpz_t r, const mpz_t b, const mpz_t e, const mpz_t m) {
     struct gmp_div_inverse minv;
     unsigned shift;
     mp_ptr tp = NULL;
+    size_t work = 0;
 
     en = GMP_ABS (e->_mp_size);
     mn = GMP_ABS (m->_mp_size);
@@ -2710,6 +2971,13 @@ mpz_powm (mpz_t r, const mpz_t b, const mpz_t e, const mpz_t m) {
                 mpn_div_qr_preinv (NULL, tr->_mp_d, tr->_mp_size, mp, mn, &minv);
                 tr->_mp_size = mpn_normalized_size (tr->_mp_d, mn);
             }
+            if (gmp_yield_func) {
+                work += (size_t) mn * mn;
+                if (work >= gmp_yield_interval) {
+                    work = 0;
+                    gmp_yield_func ();
+                }
+            }
             bit >>= 1;
         } while (bit > 0);
     }
@@ -2737,6 +3005,187 @@ mpz_powm_ui (mpz_t r, const mpz_t b, unsigned long elimb, const mpz_t m) {
     mpz_clear (e);
 }
 
+/* Montgomery exponentiation, constant time in the exponent bits.
+   The modulus must be odd, everything is kept in mn limbs, R = B^mn. */
+
+/* -1/m0 mod B (Newton, every step doubles the correct bits) */
+static mp_limb_t mpn_mont_minv (mp_limb_t m0) {
+    mp_limb_t inv = m0;     /* m0 * m0 = 1 mod 8 */
+    int i;
+
+    for (i = 0; i < 5; i++)
+        inv *= 2 - m0 * inv;
+    return -inv;
+}
+
+/* rp = rp - m if rp (with the carry limb c) >= m, without a branch */
+static void mpn_mont_csub (mp_ptr rp, mp_limb_t c, mp_srcptr mp, mp_size_t mn, mp_ptr tp) {
+    mp_limb_t b, mask;
+    mp_size_t i;
+
+    b = mpn_sub_n (tp, rp, mp, mn);
+    mask = -(mp_limb_t) (c < b);    /* all ones: rp < m, keep it */
+    for (i = 0; i < mn; i++)
+        rp[i] = (rp[i] & mask) | (tp[i] & ~mask);
+}
+
+/* CIOS: rp = ap * bp / R mod m, tp has mn + 2 limbs, rp may overlap ap or bp */
+static void mpn_mont_mul (mp_ptr rp, mp_srcptr ap, mp_srcptr bp, mp_srcptr mp, mp_size_t mn, mp_limb_t minv, mp_ptr tp) {
+    mp_limb_t q, c, lo;
+    mp_size_t i, j;
+
+    mpn_zero (tp, mn + 2);
+    for (i = 0; i < mn; i++) {
+        c = mpn_addmul_1 (tp, ap, mn, bp[i]);
+        tp[mn] += c;
+        tp[mn + 1] = (tp[mn] < c);
+
+        /* tp = (tp + q * m) / B, the low limb becomes zero */
+        q = tp[0] * minv;
+        gmp_umul_ppmm_add2 (c, lo, q, mp[0], tp[0], 0);
+        for (j = 1; j < mn; j++) {
+            gmp_umul_ppmm_add2 (c, lo, q, mp[j], c, tp[j]);
+            tp[j - 1] = lo;
+        }
+        tp[mn - 1] = tp[mn] + c;
+        tp[mn] = tp[mn + 1] + (tp[mn - 1] < c);
+    }
+    mpn_copyi (rp, tp, mn);
+    mpn_mont_csub (rp, tp[mn], mp, mn, tp);
+}
+
+/* REDC: rp = tp / R mod m, tp has 2 * mn limbs and is destroyed */
+static void mpn_mont_redc (mp_ptr rp, mp_ptr tp, mp_srcptr mp, mp_size_t mn, mp_limb_t minv) {
+    mp_ptr up = tp;
+    mp_limb_t c;
+    mp_size_t i;
+
+    for (i = 0; i < mn; i++) {
+        /* the low limb is zero after it, keep the carry there */
+        up[0] = mpn_addmul_1 (up, mp, mn, up[0] * minv);
+        up++;
+    }
+    c = mpn_add_n (rp, up, tp, mn);
+    mpn_mont_csub (rp, c, mp, mn, tp);
+}
+
+/* squaring has its own multiplication, then REDC; tp has 2 * mn limbs,
+   ws the Karatsuba scratch */
+static void mpn_mont_sqr (mp_ptr rp, mp_srcptr ap, mp_srcptr mp, mp_size_t mn, mp_limb_t minv, mp_ptr tp, mp_ptr ws) {
+    mpn_kara_sqr (tp, ap, mn, ws);
+    mpn_mont_redc (rp, tp, mp, mn, minv);
+}
+
+/* rp = tab[which], every entry is read */
+static void mpn_mont_tabselect (mp_ptr rp, mp_srcptr tab, mp_size_t n, mp_size_t nents, mp_size_t which) {
+    mp_limb_t d, mask;
+    mp_size_t k, i;
+
+    mpn_zero (rp, n);
+    for (k = 0; k < nents; k++, tab += n) {
+        d = (mp_limb_t) (k ^ which);
+        mask = ((d | -d) >> (GMP_LIMB_BITS - 1)) - 1;   /* all ones if k == which */
+        for (i = 0; i < n; i++)
+            rp[i] |= tab[i] & mask;
+    }
+}
+
+/* w bits of the exponent starting at bit */
+static unsigned mpn_mont_getbits (mp_srcptr ep, mp_size_t en, mp_bitcnt_t bit, unsigned w) {
+    mp_size_t i = bit / GMP_LIMB_BITS;
+    unsigned s = bit % GMP_LIMB_BITS;
+    mp_limb_t r;
+
+    r = (i < en ? ep[i] >> s : 0);
+    if (s + w > GMP_LIMB_BITS && i + 1 < en)
+        r |= ep[i + 1] << (GMP_LIMB_BITS - s);
+    return (unsigned) (r & (((mp_limb_t) 1 << w) - 1));
+}
+
+/* r = b^e mod m: fixed window, the table is read in full for every window,
+   so the sequence of operations depends only on the exponent size.
+   Falls back to mpz_powm for an even modulus or a non-positive exponent. */
+void
+mpz_powm_sec (mpz_t r, const mpz_t b, const mpz_t e, const mpz_t m) {
+    mp_size_t mn, en, nents, i;
+    mp_srcptr mp, ep;
+    mp_ptr tab, ap, sp, tp, ws;
+    mp_size_t tabn;
+    mp_limb_t minv;
+    mp_bitcnt_t ebits, bit;
+    unsigned w;
+    size_t work = 0;
+    mpz_t t;
+
+    mn = GMP_ABS (m->_mp_size);
+    en = e->_mp_size;
+    if (mn == 0 || en <= 0 || (m->_mp_d[0] & 1) == 0) {
+        mpz_powm (r, b, e, m);
+        return;
+    }
+    mp = m->_mp_d;
+    ep = e->_mp_d;
+    minv = mpn_mont_minv (mp[0]);
+
+    ebits = (mp_bitcnt_t) en * GMP_LIMB_BITS;
+    w = (ebits > 640 ? 5 : 4);
+    nents = (mp_size_t) 1 << w;
+
+    tabn = (nents + 4) * mn + 2 + mpn_kara_itch (mn, gmp_sqr_kara_threshold);
+    tab = gmp_xalloc_limbs (tabn);
+    ap = tab + nents * mn;
+    sp = ap + mn;
+    tp = sp + mn;
+    ws = tp + 2 * mn + 2;
+
+    /* tab[0] = R mod m, tab[1] = b R mod m */
+    mpz_init (t);
+    mpz_set_ui (t, 1);
+    mpz_mul_2exp (t, t, (mp_bitcnt_t) mn * GMP_LIMB_BITS);
+    mpz_mod (t, t, m);
+    mpn_zero (tab, mn);
+    mpn_copyi (tab, t->_mp_d, t->_mp_size);
+    mpz_mul_2exp (t, b, (mp_bitcnt_t) mn * GMP_LIMB_BITS);
+    mpz_mod (t, t, m);
+    mpn_zero (tab + mn, mn);
+    mpn_copyi (tab + mn, t->_mp_d, t->_mp_size);
+    mpz_clear (t);
+
+    for (i = 2; i < nents; i++)
+        mpn_mont_mul (tab + i * mn, tab + (i - 1) * mn, tab + mn, mp, mn, minv, tp);
+
+    /* the exponent is padded to a multiple of w */
+    bit = ebits - (ebits % w ? ebits % w : w);
+    mpn_mont_tabselect (ap, tab, mn, nents, mpn_mont_getbits (ep, en, bit, w));
+    while (bit > 0) {
+        bit -= w;
+        for (i = 0; i < w; i++)
+            mpn_mont_sqr (ap, ap, mp, mn, minv, tp, ws);
+        mpn_mont_tabselect (sp, tab, mn, nents, mpn_mont_getbits (ep, en, bit, w));
+        mpn_mont_mul (ap, ap, sp, mp, mn, minv, tp);
+
+        if (gmp_yield_func) {
+            work += (size_t) (w + 1) * mn * mn;
+            if (work >= gmp_yield_interval) {
+                work = 0;
+                gmp_yield_func ();
+            }
+        }
+    }
+
+    /* out of the Montgomery form */
+    mpn_copyi (tp, ap, mn);
+    mpn_zero (tp + mn, mn);
+    mpn_mont_redc (ap, tp, mp, mn, minv);
+
+    tp = MPZ_REALLOC (r, mn);
+    mpn_copyi (tp, ap, mn);
+    r->_mp_size = mpn_normalized_size (tp, mn);
+
+    mpn_zero (tab, tabn);
+    gmp_free (tab);
+}
+
 /* x=trunc(y^(1/z)), r=y-x^z */
 void
 mpz_rootrem (mpz_t x, mpz_t r, const mpz_t y, unsigned long z) {
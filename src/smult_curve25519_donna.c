@@ -0,0 +1,854 @@
+/*
+ * curve25519 scalar multiplication, donna-style field arithmetic:
+ *  - 10 limbs of alternating 26/25 bits (radix 2^25.5) with 64-bit products on 32-bit targets,
+ *  - 5 limbs of 51 bits with 128-bit products where the compiler provides them.
+ * The radix is chosen at build time, the ladder is shared.
+ *
+ * Public domain.
+ * Derived from public domain curve25519-donna (Adam Langley) and
+ * ref10 (D. J. Bernstein, N. Duif, T. Lange, P. Schwabe, B.-Y. Yang).
+ */
+#include "vxssh.h"
+
+#if defined(__SIZEOF_INT128__) && !defined(CURVE25519_FORCE_32BIT)
+#define CURVE25519_RADIX51 1
+#endif
+
+#ifdef CURVE25519_RADIX51
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* 5 x 51 bits */
+typedef unsigned __int128 uint128_t;
+typedef uint64_t fe_limb_t;
+typedef fe_limb_t fe[5];
+#define FE_LIMBS 5
+
+#define MASK51  (((uint64_t) 1 << 51) - 1)
+
+static uint64_t load64_le(const unsigned char *s) {
+    return (uint64_t) s[0] | ((uint64_t) s[1] << 8) | ((uint64_t) s[2] << 16) | ((uint64_t) s[3] << 24) |
+           ((uint64_t) s[4] << 32) | ((uint64_t) s[5] << 40) | ((uint64_t) s[6] << 48) | ((uint64_t) s[7] << 56);
+}
+
+static void fe_0(fe h) {
+    h[0] = h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+static void fe_1(fe h) {
+    h[0] = 1;
+    h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+static void fe_copy(fe h, const fe f) {
+    h[0] = f[0]; h[1] = f[1]; h[2] = f[2]; h[3] = f[3]; h[4] = f[4];
+}
+
+/* limbs < 2^52 */
+static void fe_add(fe h, const fe f, const fe g) {
+    h[0] = f[0] + g[0]; h[1] = f[1] + g[1]; h[2] = f[2] + g[2]; h[3] = f[3] + g[3]; h[4] = f[4] + g[4];
+}
+
+
+static void fe_cswap(fe f, fe g, unsigned int b) {
+    uint64_t mask = (uint64_t) 0 - b;
+    uint64_t x;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        x = mask & (f[i] ^ g[i]);
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+#define FE_CARRY(h) do {                                                            \
+    uint64_t c;                                                                     \
+    c = (uint64_t) (r0 >> 51); r1 += c; h[0] = (uint64_t) r0 & MASK51;              \
+    c = (uint64_t) (r1 >> 51); r2 += c; h[1] = (uint64_t) r1 & MASK51;              \
+    c = (uint64_t) (r2 >> 51); r3 += c; h[2] = (uint64_t) r2 & MASK51;              \
+    c = (uint64_t) (r3 >> 51); r4 += c; h[3] = (uint64_t) r3 & MASK51;              \
+    c = (uint64_t) (r4 >> 51); h[0] += c * 19; h[4] = (uint64_t) r4 & MASK51;       \
+    c = h[0] >> 51; h[0] &= MASK51; h[1] += c;                                      \
+} while (0)
+
+/* inputs limbs < 2^54 */
+static void fe_mul(fe h, const fe f, const fe g) {
+    uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+    uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+    uint128_t r0, r1, r2, r3, r4;
+
+    r0 = (uint128_t) f0 * g0 + (uint128_t) f1 * g4_19 + (uint128_t) f2 * g3_19 + (uint128_t) f3 * g2_19 + (uint128_t) f4 * g1_19;
+    r1 = (uint128_t) f0 * g1 + (uint128_t) f1 * g0 + (uint128_t) f2 * g4_19 + (uint128_t) f3 * g3_19 + (uint128_t) f4 * g2_19;
+    r2 = (uint128_t) f0 * g2 + (uint128_t) f1 * g1 + (uint128_t) f2 * g0 + (uint128_t) f3 * g4_19 + (uint128_t) f4 * g3_19;
+    r3 = (uint128_t) f0 * g3 + (uint128_t) f1 * g2 + (uint128_t) f2 * g1 + (uint128_t) f3 * g0 + (uint128_t) f4 * g4_19;
+    r4 = (uint128_t) f0 * g4 + (uint128_t) f1 * g3 + (uint128_t) f2 * g2 + (uint128_t) f3 * g1 + (uint128_t) f4 * g0;
+
+    FE_CARRY(h);
+}
+
+static void fe_sq(fe h, const fe f) {
+    uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+    uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+    uint128_t r0, r1, r2, r3, r4;
+
+    r0 = (uint128_t) f0 * f0 + (uint128_t) f1_2 * f4_19 + (uint128_t) (2 * f2) * f3_19;
+    r1 = (uint128_t) f0_2 * f1 + (uint128_t) (2 * f2) * f4_19 + (uint128_t) f3 * f3_19;
+    r2 = (uint128_t) f0_2 * f2 + (uint128_t) f1 * f1 + (uint128_t) (2 * f3) * f4_19;
+    r3 = (uint128_t) f0_2 * f3 + (uint128_t) f1_2 * f2 + (uint128_t) f4 * f4_19;
+    r4 = (uint128_t) f0_2 * f4 + (uint128_t) f1_2 * f3 + (uint128_t) f2 * f2;
+
+    FE_CARRY(h);
+}
+
+static void fe_mul121666(fe h, const fe f) {
+    uint128_t r0, r1, r2, r3, r4;
+
+    r0 = (uint128_t) f[0] * 121666;
+    r1 = (uint128_t) f[1] * 121666;
+    r2 = (uint128_t) f[2] * 121666;
+    r3 = (uint128_t) f[3] * 121666;
+    r4 = (uint128_t) f[4] * 121666;
+
+    FE_CARRY(h);
+}
+
+static void fe_frombytes(fe h, const unsigned char *s) {
+    h[0] = load64_le(s) & MASK51;
+    h[1] = (load64_le(s + 6) >> 3) & MASK51;
+    h[2] = (load64_le(s + 12) >> 6) & MASK51;
+    h[3] = (load64_le(s + 19) >> 1) & MASK51;
+    h[4] = (load64_le(s + 24) >> 12) & MASK51;
+}
+
+static void fe_carry_full(uint64_t t[5]) {
+    t[1] += t[0] >> 51; t[0] &= MASK51;
+    t[2] += t[1] >> 51; t[1] &= MASK51;
+    t[3] += t[2] >> 51; t[2] &= MASK51;
+    t[4] += t[3] >> 51; t[3] &= MASK51;
+    t[0] += 19 * (t[4] >> 51); t[4] &= MASK51;
+}
+
+/* f + 4p - g (g limbs < 2^53), weakly reduced */
+static void fe_sub(fe h, const fe f, const fe g) {
+    h[0] = (f[0] + 0x1fffffffffffb4ULL) - g[0];
+    h[1] = (f[1] + 0x1ffffffffffffcULL) - g[1];
+    h[2] = (f[2] + 0x1ffffffffffffcULL) - g[2];
+    h[3] = (f[3] + 0x1ffffffffffffcULL) - g[3];
+    h[4] = (f[4] + 0x1ffffffffffffcULL) - g[4];
+    fe_carry_full(h);
+}
+
+static void fe_carry(fe h) {
+    fe_carry_full(h);
+}
+
+static void fe_tobytes(unsigned char *s, const fe f) {
+    uint64_t t[5];
+    int i, j;
+
+    fe_copy(t, f);
+    fe_carry_full(t);
+    fe_carry_full(t);
+
+    /* t is in [0, 2^255), make it [19, 2^255 + 19) then offset by 2^255 - 19 */
+    t[0] += 19;
+    fe_carry_full(t);
+    t[0] += 0x8000000000000ULL - 19;
+    t[1] += 0x8000000000000ULL - 1;
+    t[2] += 0x8000000000000ULL - 1;
+    t[3] += 0x8000000000000ULL - 1;
+    t[4] += 0x8000000000000ULL - 1;
+    t[1] += t[0] >> 51; t[0] &= MASK51;
+    t[2] += t[1] >> 51; t[1] &= MASK51;
+    t[3] += t[2] >> 51; t[2] &= MASK51;
+    t[4] += t[3] >> 51; t[3] &= MASK51;
+    t[4] &= MASK51;
+
+    t[0] = t[0] | (t[1] << 51);
+    t[1] = (t[1] >> 13) | (t[2] << 38);
+    t[2] = (t[2] >> 26) | (t[3] << 25);
+    t[3] = (t[3] >> 39) | (t[4] << 12);
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 8; j++) {
+            s[i * 8 + j] = (unsigned char) (t[i] >> (j * 8));
+        }
+    }
+}
+
+#else /* CURVE25519_RADIX51 */
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* 10 x 25.5 bits, signed limbs, |even| < 2^26, |odd| < 2^25 after a carry */
+typedef int32_t fe_limb_t;
+typedef fe_limb_t fe[10];
+#define FE_LIMBS 10
+
+static const unsigned char limb_bits[10] = { 26, 25, 26, 25, 26, 25, 26, 25, 26, 25 };
+
+static int64_t load3(const unsigned char *s) {
+    return (int64_t) s[0] | ((int64_t) s[1] << 8) | ((int64_t) s[2] << 16);
+}
+
+static int64_t load4(const unsigned char *s) {
+    return (int64_t) s[0] | ((int64_t) s[1] << 8) | ((int64_t) s[2] << 16) | ((int64_t) s[3] << 24);
+}
+
+static void fe_0(fe h) {
+    memset(h, 0, sizeof(fe));
+}
+
+static void fe_1(fe h) {
+    memset(h, 0, sizeof(fe));
+    h[0] = 1;
+}
+
+static void fe_copy(fe h, const fe f) {
+    memcpy(h, f, sizeof(fe));
+}
+
+static void fe_add(fe h, const fe f, const fe g) {
+    int i;
+    for (i = 0; i < 10; i++) {
+        h[i] = f[i] + g[i];
+    }
+}
+
+static void fe_sub(fe h, const fe f, const fe g) {
+    int i;
+    for (i = 0; i < 10; i++) {
+        h[i] = f[i] - g[i];
+    }
+}
+
+static void fe_cswap(fe f, fe g, unsigned int b) {
+    int32_t mask = (int32_t) (0 - b);
+    int32_t x;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        x = mask & (f[i] ^ g[i]);
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+#define CARRY26(a, b) do { int64_t c = (a + ((int64_t) 1 << 25)) >> 26; b += c; a -= c * ((int64_t) 1 << 26); } while (0)
+#define CARRY25(a, b) do { int64_t c = (a + ((int64_t) 1 << 24)) >> 25; b += c; a -= c * ((int64_t) 1 << 25); } while (0)
+
+#define FE_CARRY(h) do {                                                            \
+    int64_t c9;                                                                     \
+    CARRY26(h0, h1); CARRY26(h4, h5);                                               \
+    CARRY25(h1, h2); CARRY25(h5, h6);                                               \
+    CARRY26(h2, h3); CARRY26(h6, h7);                                               \
+    CARRY25(h3, h4); CARRY25(h7, h8);                                               \
+    CARRY26(h4, h5); CARRY26(h8, h9);                                               \
+    c9 = (h9 + ((int64_t) 1 << 24)) >> 25; h0 += c9 * 19; h9 -= c9 * ((int64_t) 1 << 25); \
+    CARRY26(h0, h1);                                                                \
+    h[0] = (int32_t) h0; h[1] = (int32_t) h1; h[2] = (int32_t) h2; h[3] = (int32_t) h3; h[4] = (int32_t) h4; \
+    h[5] = (int32_t) h5; h[6] = (int32_t) h6; h[7] = (int32_t) h7; h[8] = (int32_t) h8; h[9] = (int32_t) h9; \
+} while (0)
+
+static void fe_mul(fe h, const fe f, const fe g) {
+    int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+    int32_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4], g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+    int32_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4, g5_19 = 19 * g5;
+    int32_t g6_19 = 19 * g6, g7_19 = 19 * g7, g8_19 = 19 * g8, g9_19 = 19 * g9;
+    int32_t f1_2 = 2 * f1, f3_2 = 2 * f3, f5_2 = 2 * f5, f7_2 = 2 * f7, f9_2 = 2 * f9;
+    int64_t h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+    h0 = f0 * (int64_t) g0 + f1_2 * (int64_t) g9_19 + f2 * (int64_t) g8_19 + f3_2 * (int64_t) g7_19 + f4 * (int64_t) g6_19
+       + f5_2 * (int64_t) g5_19 + f6 * (int64_t) g4_19 + f7_2 * (int64_t) g3_19 + f8 * (int64_t) g2_19 + f9_2 * (int64_t) g1_19;
+    h1 = f0 * (int64_t) g1 + f1 * (int64_t) g0 + f2 * (int64_t) g9_19 + f3 * (int64_t) g8_19 + f4 * (int64_t) g7_19
+       + f5 * (int64_t) g6_19 + f6 * (int64_t) g5_19 + f7 * (int64_t) g4_19 + f8 * (int64_t) g3_19 + f9 * (int64_t) g2_19;
+    h2 = f0 * (int64_t) g2 + f1_2 * (int64_t) g1 + f2 * (int64_t) g0 + f3_2 * (int64_t) g9_19 + f4 * (int64_t) g8_19
+       + f5_2 * (int64_t) g7_19 + f6 * (int64_t) g6_19 + f7_2 * (int64_t) g5_19 + f8 * (int64_t) g4_19 + f9_2 * (int64_t) g3_19;
+    h3 = f0 * (int64_t) g3 + f1 * (int64_t) g2 + f2 * (int64_t) g1 + f3 * (int64_t) g0 + f4 * (int64_t) g9_19
+       + f5 * (int64_t) g8_19 + f6 * (int64_t) g7_19 + f7 * (int64_t) g6_19 + f8 * (int64_t) g5_19 + f9 * (int64_t) g4_19;
+    h4 = f0 * (int64_t) g4 + f1_2 * (int64_t) g3 + f2 * (int64_t) g2 + f3_2 * (int64_t) g1 + f4 * (int64_t) g0
+       + f5_2 * (int64_t) g9_19 + f6 * (int64_t) g8_19 + f7_2 * (int64_t) g7_19 + f8 * (int64_t) g6_19 + f9_2 * (int64_t) g5_19;
+    h5 = f0 * (int64_t) g5 + f1 * (int64_t) g4 + f2 * (int64_t) g3 + f3 * (int64_t) g2 + f4 * (int64_t) g1
+       + f5 * (int64_t) g0 + f6 * (int64_t) g9_19 + f7 * (int64_t) g8_19 + f8 * (int64_t) g7_19 + f9 * (int64_t) g6_19;
+    h6 = f0 * (int64_t) g6 + f1_2 * (int64_t) g5 + f2 * (int64_t) g4 + f3_2 * (int64_t) g3 + f4 * (int64_t) g2
+       + f5_2 * (int64_t) g1 + f6 * (int64_t) g0 + f7_2 * (int64_t) g9_19 + f8 * (int64_t) g8_19 + f9_2 * (int64_t) g7_19;
+    h7 = f0 * (int64_t) g7 + f1 * (int64_t) g6 + f2 * (int64_t) g5 + f3 * (int64_t) g4 + f4 * (int64_t) g3
+       + f5 * (int64_t) g2 + f6 * (int64_t) g1 + f7 * (int64_t) g0 + f8 * (int64_t) g9_19 + f9 * (int64_t) g8_19;
+    h8 = f0 * (int64_t) g8 + f1_2 * (int64_t) g7 + f2 * (int64_t) g6 + f3_2 * (int64_t) g5 + f4 * (int64_t) g4
+       + f5_2 * (int64_t) g3 + f6 * (int64_t) g2 + f7_2 * (int64_t) g1 + f8 * (int64_t) g0 + f9_2 * (int64_t) g9_19;
+    h9 = f0 * (int64_t) g9 + f1 * (int64_t) g8 + f2 * (int64_t) g7 + f3 * (int64_t) g6 + f4 * (int64_t) g5
+       + f5 * (int64_t) g4 + f6 * (int64_t) g3 + f7 * (int64_t) g2 + f8 * (int64_t) g1 + f9 * (int64_t) g0;
+
+    FE_CARRY(h);
+}
+
+static void fe_sq(fe h, const fe f) {
+    int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+    int32_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3, f4_2 = 2 * f4, f5_2 = 2 * f5, f6_2 = 2 * f6, f7_2 = 2 * f7, f8_2 = 2 * f8;
+    int32_t f6_19 = 19 * f6, f7_19 = 19 * f7, f8_19 = 19 * f8, f9_19 = 19 * f9;
+    int32_t f5_38 = 38 * f5, f7_38 = 38 * f7, f9_38 = 38 * f9;
+    int64_t h0, h1, h2, h3, h4, h5, h6, h7, h8, h9;
+
+    h0 = f0 * (int64_t) f0 + f1_2 * (int64_t) f9_38 + f2_2 * (int64_t) f8_19
+       + f3_2 * (int64_t) f7_38 + f4_2 * (int64_t) f6_19 + f5 * (int64_t) f5_38;
+    h1 = f0_2 * (int64_t) f1 + f2_2 * (int64_t) f9_19 + f3_2 * (int64_t) f8_19
+       + f4_2 * (int64_t) f7_19 + f5_2 * (int64_t) f6_19;
+    h2 = f0_2 * (int64_t) f2 + f1 * (int64_t) f1_2 + f3_2 * (int64_t) f9_38
+       + f4_2 * (int64_t) f8_19 + f5_2 * (int64_t) f7_38 + f6 * (int64_t) f6_19;
+    h3 = f0_2 * (int64_t) f3 + f1_2 * (int64_t) f2 + f4_2 * (int64_t) f9_19
+       + f5_2 * (int64_t) f8_19 + f6_2 * (int64_t) f7_19;
+    h4 = f0_2 * (int64_t) f4 + f1_2 * (int64_t) f3_2 + f2 * (int64_t) f2
+       + f5_2 * (int64_t) f9_38 + f6_2 * (int64_t) f8_19 + f7 * (int64_t) f7_38;
+    h5 = f0_2 * (int64_t) f5 + f1_2 * (int64_t) f4 + f2_2 * (int64_t) f3
+       + f6_2 * (int64_t) f9_19 + f7_2 * (int64_t) f8_19;
+    h6 = f0_2 * (int64_t) f6 + f1_2 * (int64_t) f5_2 + f2_2 * (int64_t) f4
+       + f3 * (int64_t) f3_2 + f7_2 * (int64_t) f9_38 + f8 * (int64_t) f8_19;
+    h7 = f0_2 * (int64_t) f7 + f1_2 * (int64_t) f6 + f2_2 * (int64_t) f5
+       + f3_2 * (int64_t) f4 + f8_2 * (int64_t) f9_19;
+    h8 = f0_2 * (int64_t) f8 + f1_2 * (int64_t) f7_2 + f2_2 * (int64_t) f6
+       + f3_2 * (int64_t) f5_2 + f4 * (int64_t) f4 + f9 * (int64_t) f9_38;
+    h9 = f0_2 * (int64_t) f9 + f1_2 * (int64_t) f8 + f2_2 * (int64_t) f7
+       + f3_2 * (int64_t) f6 + f4_2 * (int64_t) f5;
+
+    FE_CARRY(h);
+}
+
+
+static void fe_mul121666(fe h, const fe f) {
+    int64_t h0 = f[0] * (int64_t) 121666, h1 = f[1] * (int64_t) 121666, h2 = f[2] * (int64_t) 121666;
+    int64_t h3 = f[3] * (int64_t) 121666, h4 = f[4] * (int64_t) 121666, h5 = f[5] * (int64_t) 121666;
+    int64_t h6 = f[6] * (int64_t) 121666, h7 = f[7] * (int64_t) 121666, h8 = f[8] * (int64_t) 121666;
+    int64_t h9 = f[9] * (int64_t) 121666;
+
+    FE_CARRY(h);
+}
+
+static void fe_carry(fe h) {
+    int64_t h0 = h[0], h1 = h[1], h2 = h[2], h3 = h[3], h4 = h[4];
+    int64_t h5 = h[5], h6 = h[6], h7 = h[7], h8 = h[8], h9 = h[9];
+
+    FE_CARRY(h);
+}
+
+static void fe_frombytes(fe h, const unsigned char *s) {
+    int64_t h0 = load4(s);
+    int64_t h1 = load3(s + 4) << 6;
+    int64_t h2 = load3(s + 7) << 5;
+    int64_t h3 = load3(s + 10) << 3;
+    int64_t h4 = load3(s + 13) << 2;
+    int64_t h5 = load4(s + 16);
+    int64_t h6 = load3(s + 20) << 7;
+    int64_t h7 = load3(s + 23) << 5;
+    int64_t h8 = load3(s + 26) << 4;
+    int64_t h9 = (load3(s + 29) & 0x7fffff) << 2;
+
+    FE_CARRY(h);
+}
+
+static void fe_tobytes(unsigned char *s, const fe f) {
+    int32_t h[10];
+    int32_t q;
+    uint64_t acc;
+    int i, bits, n;
+
+    fe_copy(h, f);
+
+    /* q = floor(h / p), 0 or 1 */
+    q = (19 * h[9] + ((int32_t) 1 << 24)) >> 25;
+    for (i = 0; i < 10; i++) {
+        q = (h[i] + q) >> limb_bits[i];
+    }
+
+    /* h - p * q, which is in [0, p) */
+    h[0] += 19 * q;
+    for (i = 0; i < 9; i++) {
+        int32_t c = h[i] >> limb_bits[i];
+        h[i + 1] += c;
+        h[i] -= c * ((int32_t) 1 << limb_bits[i]);
+    }
+    h[9] &= ((int32_t) 1 << 25) - 1;
+
+    acc = 0; bits = 0; n = 0;
+    for (i = 0; i < 10; i++) {
+        acc |= (uint64_t) (uint32_t) h[i] << bits;
+        bits += limb_bits[i];
+        while (bits >= 8) {
+            s[n++] = (unsigned char) acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    if (n < 32) {
+        s[n] = (unsigned char) acc;
+    }
+}
+
+#endif /* CURVE25519_RADIX51 */
+
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* z^(p - 2) */
+static void fe_invert(fe out, const fe z) {
+    fe t0, t1, t2, t3;
+    int i;
+
+    /* 2 */ fe_sq(t0, z);
+    /* 8 */ fe_sq(t1, t0); fe_sq(t1, t1);
+    /* 9 */ fe_mul(t1, z, t1);
+    /* 11 */ fe_mul(t0, t0, t1);
+    /* 22 */ fe_sq(t2, t0);
+    /* 2^5 - 2^0 */ fe_mul(t1, t1, t2);
+    /* 2^10 - 2^5 */ fe_sq(t2, t1); for (i = 1; i < 5; i++) fe_sq(t2, t2);
+    /* 2^10 - 2^0 */ fe_mul(t1, t2, t1);
+    /* 2^20 - 2^10 */ fe_sq(t2, t1); for (i = 1; i < 10; i++) fe_sq(t2, t2);
+    /* 2^20 - 2^0 */ fe_mul(t2, t2, t1);
+    /* 2^40 - 2^20 */ fe_sq(t3, t2); for (i = 1; i < 20; i++) fe_sq(t3, t3);
+    /* 2^40 - 2^0 */ fe_mul(t2, t3, t2);
+    /* 2^50 - 2^10 */ fe_sq(t2, t2); for (i = 1; i < 10; i++) fe_sq(t2, t2);
+    /* 2^50 - 2^0 */ fe_mul(t1, t2, t1);
+    /* 2^100 - 2^50 */ fe_sq(t2, t1); for (i = 1; i < 50; i++) fe_sq(t2, t2);
+    /* 2^100 - 2^0 */ fe_mul(t2, t2, t1);
+    /* 2^200 - 2^100 */ fe_sq(t3, t2); for (i = 1; i < 100; i++) fe_sq(t3, t3);
+    /* 2^200 - 2^0 */ fe_mul(t2, t3, t2);
+    /* 2^250 - 2^50 */ fe_sq(t2, t2); for (i = 1; i < 50; i++) fe_sq(t2, t2);
+    /* 2^250 - 2^0 */ fe_mul(t1, t2, t1);
+    /* 2^255 - 2^5 */ fe_sq(t1, t1); for (i = 1; i < 5; i++) fe_sq(t1, t1);
+    /* 2^255 - 21 */ fe_mul(out, t1, t0);
+}
+
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/*
+ * Fixed-base multiplication for key generation.
+ * n * B is computed on the birationally equivalent twisted Edwards curve (ed25519) with a signed radix-16 comb
+ * over a table of (j + 1) * 256^i * B (i = 0..31, j = 0..7), then mapped back to the Montgomery u = (Z + Y) / (Z - Y).
+ * The table is built once by vxssh_curve25519_base_init().
+ */
+typedef struct { fe X, Y, Z; } ge_p2;
+typedef struct { fe X, Y, Z, T; } ge_p3;
+typedef struct { fe X, Y, Z, T; } ge_p1p1;
+typedef struct { fe yplusx, yminusx, xy2d; } ge_precomp;
+
+#define GE_TABLE_ROWS   32
+#define GE_TABLE_COLS   8
+
+static const unsigned char ed25519_bx[32] = {
+    0x1a, 0xd5, 0x25, 0x8f, 0x60, 0x2d, 0x56, 0xc9, 0xb2, 0xa7, 0x25, 0x95, 0x60, 0xc7, 0x2c, 0x69,
+    0x5c, 0xdc, 0xd6, 0xfd, 0x31, 0xe2, 0xa4, 0xc0, 0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21
+};
+static const unsigned char ed25519_by[32] = {
+    0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+    0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66
+};
+/* 2 * d, d = -121665 / 121666 */
+static const unsigned char ed25519_d2[32] = {
+    0x59, 0xf1, 0xb2, 0x26, 0x94, 0x9b, 0xd6, 0xeb, 0x56, 0xb1, 0x83, 0x82, 0x9a, 0x14, 0xe0, 0x00,
+    0x30, 0xd1, 0xf3, 0xee, 0xf2, 0x80, 0x8e, 0x19, 0xe7, 0xfc, 0xdf, 0x56, 0xdc, 0xd9, 0x06, 0x24
+};
+
+static ge_precomp (*base_table)[GE_TABLE_COLS] = NULL;
+
+static void fe_cmov(fe h, const fe f, unsigned int b) {
+    fe_limb_t mask = (fe_limb_t) 0 - (fe_limb_t) b;
+    int i;
+
+    for (i = 0; i < FE_LIMBS; i++) {
+        h[i] ^= mask & (h[i] ^ f[i]);
+    }
+}
+
+static void fe_neg(fe h, const fe f) {
+    fe zero;
+
+    fe_0(zero);
+    fe_sub(h, zero, f);
+}
+
+/* 2 * f^2 */
+static void fe_sq2(fe h, const fe f) {
+    fe_sq(h, f);
+    fe_add(h, h, h);
+    fe_carry(h);
+}
+
+/* canonical form, keeps the table entries small */
+static void fe_normalize(fe h) {
+    unsigned char s[32];
+
+    fe_tobytes(s, h);
+    fe_frombytes(h, s);
+}
+
+static void ge_p3_0(ge_p3 *h) {
+    fe_0(h->X);
+    fe_1(h->Y);
+    fe_1(h->Z);
+    fe_0(h->T);
+}
+
+static void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p) {
+    fe_mul(r->X, p->X, p->T);
+    fe_mul(r->Y, p->Y, p->Z);
+    fe_mul(r->Z, p->Z, p->T);
+}
+
+static void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p) {
+    fe_mul(r->X, p->X, p->T);
+    fe_mul(r->Y, p->Y, p->Z);
+    fe_mul(r->Z, p->Z, p->T);
+    fe_mul(r->T, p->X, p->Y);
+}
+
+static void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p) {
+    fe t0;
+
+    fe_sq(r->X, p->X);
+    fe_sq(r->Z, p->Y);
+    fe_sq2(r->T, p->Z);
+    fe_add(r->Y, p->X, p->Y);
+    fe_sq(t0, r->Y);
+    fe_add(r->Y, r->Z, r->X);
+    fe_sub(r->Z, r->Z, r->X);
+    fe_sub(r->X, t0, r->Y);
+    fe_sub(r->T, r->T, r->Z);
+}
+
+static void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
+    ge_p2 q;
+
+    fe_copy(q.X, p->X);
+    fe_copy(q.Y, p->Y);
+    fe_copy(q.Z, p->Z);
+    ge_p2_dbl(r, &q);
+}
+
+/* r = p + q */
+static void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+    fe t0;
+
+    fe_add(r->X, p->Y, p->X);
+    fe_sub(r->Y, p->Y, p->X);
+    fe_mul(r->Z, r->X, q->yplusx);
+    fe_mul(r->Y, r->Y, q->yminusx);
+    fe_mul(r->T, q->xy2d, p->T);
+    fe_add(t0, p->Z, p->Z);
+    fe_sub(r->X, r->Z, r->Y);
+    fe_add(r->Y, r->Z, r->Y);
+    fe_add(r->Z, t0, r->T);
+    fe_sub(r->T, t0, r->T);
+}
+
+static unsigned int ge_equal(signed char b, signed char c) {
+    uint32_t x = (unsigned char) b ^ (unsigned char) c;
+
+    return (x - 1) >> 31;
+}
+
+/* t = b * 256^pos * B, b in [-8, 8], constant time */
+static void ge_select(ge_precomp *t, int pos, signed char b) {
+    unsigned int bnegative = ((unsigned char) b) >> 7;
+    signed char babs = b - (((-bnegative) & b) << 1);
+    ge_precomp minust;
+    int j;
+
+    fe_1(t->yplusx);
+    fe_1(t->yminusx);
+    fe_0(t->xy2d);
+    for (j = 0; j < GE_TABLE_COLS; j++) {
+        fe_cmov(t->yplusx, base_table[pos][j].yplusx, ge_equal(babs, j + 1));
+        fe_cmov(t->yminusx, base_table[pos][j].yminusx, ge_equal(babs, j + 1));
+        fe_cmov(t->xy2d, base_table[pos][j].xy2d, ge_equal(babs, j + 1));
+    }
+    fe_copy(minust.yplusx, t->yminusx);
+    fe_copy(minust.yminusx, t->yplusx);
+    fe_neg(minust.xy2d, t->xy2d);
+    fe_cmov(t->yplusx, minust.yplusx, bnegative);
+    fe_cmov(t->yminusx, minust.yminusx, bnegative);
+    fe_cmov(t->xy2d, minust.xy2d, bnegative);
+}
+
+/* r = p + q, both extended (only used to build the table) */
+static void ge_add_p3(ge_p3 *r, const ge_p3 *p, const ge_p3 *q, const fe d2) {
+    ge_p1p1 t;
+    fe a, b, c, d;
+
+    fe_sub(a, p->Y, p->X);
+    fe_sub(b, q->Y, q->X);
+    fe_mul(a, a, b);
+    fe_add(b, p->Y, p->X);
+    fe_add(c, q->Y, q->X);
+    fe_mul(b, b, c);
+    fe_mul(c, p->T, q->T);
+    fe_mul(c, c, d2);
+    fe_mul(d, p->Z, q->Z);
+    fe_add(d, d, d);
+    fe_sub(t.X, b, a);
+    fe_sub(t.T, d, c);
+    fe_add(t.Z, d, c);
+    fe_add(t.Y, b, a);
+    ge_p1p1_to_p3(r, &t);
+}
+
+static void ge_to_precomp(ge_precomp *r, const ge_p3 *p, const fe d2) {
+    fe x, y, zi;
+
+    fe_invert(zi, p->Z);
+    fe_mul(x, p->X, zi);
+    fe_mul(y, p->Y, zi);
+    fe_add(r->yplusx, y, x);
+    fe_sub(r->yminusx, y, x);
+    fe_mul(r->xy2d, x, y);
+    fe_mul(r->xy2d, r->xy2d, d2);
+    fe_normalize(r->yplusx);
+    fe_normalize(r->yminusx);
+    fe_normalize(r->xy2d);
+}
+
+/**
+ * Build the fixed-base table (~30 KB), called once from vxssh_server_init()
+ **/
+int vxssh_curve25519_base_init() {
+    ge_precomp (*table)[GE_TABLE_COLS] = NULL;
+    ge_p3 row, acc;
+    ge_p1p1 t;
+    fe d2;
+    int i, j;
+
+    if (base_table != NULL) {
+        return OK;
+    }
+    if ((table = vxssh_mem_alloc(sizeof(ge_precomp) * GE_TABLE_ROWS * GE_TABLE_COLS, NULL)) == NULL) {
+        return ENOMEM;
+    }
+
+    fe_frombytes(d2, ed25519_d2);
+    fe_frombytes(row.X, ed25519_bx);
+    fe_frombytes(row.Y, ed25519_by);
+    fe_1(row.Z);
+    fe_mul(row.T, row.X, row.Y);
+
+    for (i = 0; i < GE_TABLE_ROWS; i++) {
+        /* (j + 1) * row */
+        acc = row;
+        ge_to_precomp(&table[i][0], &acc, d2);
+        for (j = 1; j < GE_TABLE_COLS; j++) {
+            ge_add_p3(&acc, &acc, &row, d2);
+            ge_to_precomp(&table[i][j], &acc, d2);
+        }
+        /* row *= 256 */
+        for (j = 0; j < 8; j++) {
+            ge_p3_dbl(&t, &row);
+            ge_p1p1_to_p3(&row, &t);
+        }
+    }
+
+    base_table = table;
+    return OK;
+}
+
+/* h = a * B with the table, a[31] <= 127 */
+static void ge_scalarmult_base(ge_p3 *h, const unsigned char *a) {
+    signed char e[64], carry;
+    ge_p1p1 r;
+    ge_p2 s;
+    ge_precomp t;
+    int i;
+
+    /* signed radix-16 digits in [-8, 8) */
+    for (i = 0; i < 32; i++) {
+        e[2 * i + 0] = (a[i] >> 0) & 15;
+        e[2 * i + 1] = (a[i] >> 4) & 15;
+    }
+    carry = 0;
+    for (i = 0; i < 63; i++) {
+        e[i] += carry;
+        carry = e[i] + 8;
+        carry >>= 4;
+        e[i] -= carry << 4;
+    }
+    e[63] += carry;
+
+    ge_p3_0(h);
+    for (i = 1; i < 64; i += 2) {
+        ge_select(&t, i / 2, e[i]);
+        ge_madd(&r, h, &t);
+        ge_p1p1_to_p3(h, &r);
+    }
+
+    ge_p3_dbl(&r, h);
+    ge_p1p1_to_p2(&s, &r);
+    ge_p2_dbl(&r, &s);
+    ge_p1p1_to_p2(&s, &r);
+    ge_p2_dbl(&r, &s);
+    ge_p1p1_to_p2(&s, &r);
+    ge_p2_dbl(&r, &s);
+    ge_p1p1_to_p3(h, &r);
+
+    for (i = 0; i < 64; i += 2) {
+        ge_select(&t, i / 2, e[i]);
+        ge_madd(&r, h, &t);
+        ge_p1p1_to_p3(h, &r);
+    }
+
+    explicit_bzero(e, sizeof(e));
+    explicit_bzero(&r, sizeof(r));
+    explicit_bzero(&s, sizeof(s));
+    explicit_bzero(&t, sizeof(t));
+}
+
+/**
+ * q = n * 9 (the curve25519 base point), the same result as vxssh_scalarmult_curve25519(q, n, {9})
+ **/
+int vxssh_scalarmult_curve25519_base(unsigned char *q, const unsigned char *n) {
+    static const unsigned char basepoint[32] = {9};
+    unsigned char a[32];
+    ge_p3 h;
+    fe u, v;
+
+    if (base_table == NULL) {
+        return vxssh_scalarmult_curve25519(q, n, basepoint);
+    }
+
+    memcpy(a, n, 32);
+    a[0] &= 248;
+    a[31] &= 127;
+    a[31] |= 64;
+
+    ge_scalarmult_base(&h, a);
+
+    /* Edwards y to Montgomery u */
+    fe_add(u, h.Z, h.Y);
+    fe_sub(v, h.Z, h.Y);
+    fe_invert(v, v);
+    fe_mul(u, u, v);
+    fe_tobytes(q, u);
+
+    explicit_bzero(a, sizeof(a));
+    explicit_bzero(&h, sizeof(h));
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------------------------------------------------------------------------- */
+/* ed25519 */
+static void ge_p3_cmov(ge_p3 *h, const ge_p3 *f, unsigned int b) {
+    fe_cmov(h->X, f->X, b);
+    fe_cmov(h->Y, f->Y, b);
+    fe_cmov(h->Z, f->Z, b);
+    fe_cmov(h->T, f->T, b);
+}
+
+/* h = a * B without the table: double and always add */
+static void ge_scalarmult_base_ladder(ge_p3 *h, const unsigned char *a) {
+    ge_p3 b, t;
+    ge_p1p1 r;
+    fe d2;
+    int i;
+
+    fe_frombytes(d2, ed25519_d2);
+    fe_frombytes(b.X, ed25519_bx);
+    fe_frombytes(b.Y, ed25519_by);
+    fe_1(b.Z);
+    fe_mul(b.T, b.X, b.Y);
+
+    ge_p3_0(h);
+    for (i = 255; i >= 0; i--) {
+        ge_p3_dbl(&r, h);
+        ge_p1p1_to_p3(h, &r);
+        ge_add_p3(&t, h, &b, d2);
+        ge_p3_cmov(h, &t, (a[i >> 3] >> (i & 7)) & 1);
+    }
+
+    explicit_bzero(&t, sizeof(t));
+    explicit_bzero(&r, sizeof(r));
+}
+
+/**
+ * p = a * B on ed25519, encoded (RFC 8032, 5.1.2); a < 2^255, little-endian
+ **/
+int vxssh_ed25519_scalarmult_base(unsigned char *p, const unsigned char *a) {
+    unsigned char xs[32];
+    ge_p3 h;
+    fe zi, x, y;
+
+    if (base_table != NULL && a[31] <= 127) {
+        ge_scalarmult_base(&h, a);
+    } else {
+        ge_scalarmult_base_ladder(&h, a);
+    }
+
+    fe_invert(zi, h.Z);
+    fe_mul(x, h.X, zi);
+    fe_mul(y, h.Y, zi);
+    fe_tobytes(p, y);
+    fe_tobytes(xs, x);
+    p[31] ^= (xs[0] & 1) << 7;
+
+    explicit_bzero(&h, sizeof(h));
+    return 0;
+}
+
+/**
+ * q = n * p (x-coordinates, RFC 7748)
+ **/
+int vxssh_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const unsigned char *p) {
+    fe x1, x2, z2, x3, z3, tmp0, tmp1;
+    unsigned char e[32];
+    unsigned int swap, b;
+    int pos;
+
+    memcpy(e, n, 32);
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    fe_frombytes(x1, p);
+    fe_1(x2);
+    fe_0(z2);
+    fe_copy(x3, x1);
+    fe_1(z3);
+
+    swap = 0;
+    for (pos = 254; pos >= 0; --pos) {
+        b = (e[pos / 8] >> (pos & 7)) & 1;
+        swap ^= b;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = b;
+
+        fe_sub(tmp0, x3, z3);
+        fe_sub(tmp1, x2, z2);
+        fe_add(x2, x2, z2);
+        fe_add(z2, x3, z3);
+        fe_mul(z3, tmp0, x2);
+        fe_mul(z2, z2, tmp1);
+        fe_sq(tmp0, tmp1);
+        fe_sq(tmp1, x2);
+        fe_add(x3, z3, z2);
+        fe_sub(z2, z3, z2);
+        fe_mul(x2, tmp1, tmp0);
+        fe_sub(tmp1, tmp1, tmp0);
+        fe_sq(z2, z2);
+        fe_mul121666(z3, tmp1);
+        fe_sq(x3, x3);
+        fe_add(tmp0, tmp0, z3);
+        fe_mul(z3, x1, z2);
+        fe_mul(z2, tmp1, tmp0);
+
+        if ((pos & 31) == 0) {
+            vxssh_crypto_yield();
+        }
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+
+    fe_invert(z2, z2);
+    fe_mul(x2, x2, z2);
+    fe_tobytes(q, x2);
+
+    explicit_bzero(e, sizeof(e));
+    explicit_bzero(x2, sizeof(fe));
+    explicit_bzero(z2, sizeof(fe));
+    explicit_bzero(x3, sizeof(fe));
+    explicit_bzero(z3, sizeof(fe));
+    explicit_bzero(tmp0, sizeof(fe));
+    explicit_bzero(tmp1, sizeof(fe));
+
+    return 0;
+}
@@ -7,6 +7,7 @@ Derived from public domain code by D. J. Bernstein.
 */
 
 int crypto_scalarmult_curve25519(unsigned char *, const unsigned char *, const unsigned char *);
+void vxssh_crypto_yield();
 
 static void add(unsigned int out[32],const unsigned int a[32],const unsigned int b[32])
 {
@@ -172,6 +173,7 @@ static void mainloop(unsigned int work[64],const unsigned char e[32])
     square(xzn1b,c1);
     mult(xzn1b + 32,r,work);
     select(xzm,xzm1,xznb,xzn1b,b);
+    if ((pos & 31) == 0) vxssh_crypto_yield();
   }
 
   for (j = 0;j < 64;++j) work[j] = xzm[j];
@@ -263,3 +265,22 @@ int vxssh_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const
   for (i = 0;i < 32;++i) q[i] = work[64 + i];
   return 0;
 }
+
+/**
+ * no fixed-base table in this implementation
+ **/
+int vxssh_curve25519_base_init() {
+  return 0;
+}
+
+int vxssh_scalarmult_curve25519_base(unsigned char *q, const unsigned char *n) {
+  static const unsigned char basepoint[32] = {9};
+  return vxssh_scalarmult_curve25519(q, n, basepoint);
+}
+
+/**
+ * no Edwards arithmetic in this implementation (ssh-ed25519 needs the donna one)
+ **/
+int vxssh_ed25519_scalarmult_base(unsigned char *p, const unsigned char *a) {
+  return -1;
+}
@@ -8,7 +8,7 @@
 static void mem_destructor_vxssh_cipher_ctx_t(void *data) {
     vxssh_cipher_ctx_t *cip = data;
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
     if(cip->iv) {
         explicit_bzero(cip->iv, cip->iv_len);
     }
@@ -44,6 +44,12 @@ int vxssh_cipher_alloc(vxssh_cipher_ctx_t **ctx, vxssh_cipher_alg_props_t *ciphe
     tctx->iv_len = tctx->block_len;
     tctx->decrypt = decrypt;
 
+    /* filled in by the key exchange */
+    if((tctx->key = vxssh_mem_zalloc(tctx->key_len, NULL)) == NULL || (tctx->iv = vxssh_mem_zalloc(tctx->iv_len, NULL)) == NULL) {
+        err = ENOMEM;
+        goto out;
+    }
+
     switch(tctx->type) {
     case VXSSH_CIPHER_AES: {
         if((err = vxssh_aes_alloc((void *)&tctx->cipher)) != OK) {
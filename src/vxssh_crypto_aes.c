@@ -1125,7 +1125,7 @@ static void rijndaelDecrypt(const u32 rk[/*4*(Nr + 1)*/], int Nr, const u8 ct[AE
 static void mem_destructor_vxssh_aes_ctx_t(void *data) {
     vxssh_aes_ctx_t *ctx = data;
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
     explicit_bzero(ctx->rk, sizeof(ctx->rk));
 #endif
 }
@@ -0,0 +1,219 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "vxssh.h"
+
+/*
+ * every block starts with a header, the blocks form a stack:
+ * freeing the top block pops it and all the freed blocks under it,
+ * a block freed out of order is only marked and goes away with the ones above it.
+ * mini-gmp assigns most results with mpz_swap(), so the space of an operation is
+ * its measured high-water mark rather than the sum of its live values
+ */
+typedef struct {
+    size_t  size;       /* payload size, ARENA_FREED bit */
+    size_t  prev;       /* offset of the previous header */
+} arena_block_t;
+
+#define ARENA_ALIGN         sizeof(arena_block_t)
+#define ARENA_FREED         0x1
+#define ARENA_ROUND(x)      (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_NONE          ((size_t) -1)
+
+/*
+ * the mini-gmp allocator is global: one arena at a time in the whole system,
+ * the lock is held by the owner task from begin() to end()
+ */
+static SEM_ID arena_sem = NULL;
+static vxssh_crypto_arena_t *active = NULL;
+static int active_owner = 0;
+static void *(*saved_alloc) (size_t);
+static void *(*saved_realloc) (void *, size_t, size_t);
+static void (*saved_free) (void *, size_t);
+
+static void mem_destructor_vxssh_crypto_arena_t(void *data) {
+    vxssh_crypto_arena_t *arena = data;
+
+    if(active == arena) {
+        vxssh_crypto_arena_end(arena);
+    }
+    if(arena->buf) {
+        explicit_bzero(arena->buf, arena->size);
+    }
+    vxssh_mem_deref(arena->buf);
+}
+
+static bool arena_owns(vxssh_crypto_arena_t *arena, void *ptr) {
+    return (arena && (uint8_t *)ptr >= arena->buf && (uint8_t *)ptr < arena->buf + arena->size);
+}
+
+static arena_block_t *arena_header(vxssh_crypto_arena_t *arena, void *ptr) {
+    return (arena_block_t *)((uint8_t *)ptr - sizeof(arena_block_t));
+}
+
+static void *arena_alloc(vxssh_crypto_arena_t *arena, size_t size) {
+    arena_block_t *blk;
+    size_t need = sizeof(arena_block_t) + ARENA_ROUND(size);
+
+    if(arena->used + need > arena->size) {
+        return NULL;
+    }
+    blk = (arena_block_t *)(arena->buf + arena->used);
+    blk->size = ARENA_ROUND(size);
+    blk->prev = arena->top;
+    arena->top = arena->used;
+    arena->used += need;
+    if(arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return (blk + 1);
+}
+
+static void arena_free(vxssh_crypto_arena_t *arena, void *ptr) {
+    arena_block_t *blk = arena_header(arena, ptr);
+
+    blk->size |= ARENA_FREED;
+    while(arena->top != ARENA_NONE) {
+        blk = (arena_block_t *)(arena->buf + arena->top);
+        if(!(blk->size & ARENA_FREED)) {
+            break;
+        }
+        arena->used = arena->top;
+        arena->top = blk->prev;
+    }
+}
+
+/* mini-gmp hooks, other tasks and foreign pointers go to the heap */
+static void *hook_alloc(size_t size) {
+    void *p;
+
+    if(active && active_owner == taskIdSelf()) {
+        if((p = arena_alloc(active, size)) != NULL) {
+            return p;
+        }
+        active->heap_ops++;
+    }
+    return saved_alloc(size);
+}
+
+static void *hook_realloc(void *ptr, size_t old_size, size_t new_size) {
+    arena_block_t *blk;
+    size_t need;
+    void *p;
+
+    if(!arena_owns(active, ptr)) {
+        if(active && active_owner == taskIdSelf()) {
+            active->heap_ops++;
+        }
+        return saved_realloc(ptr, old_size, new_size);
+    }
+    blk = arena_header(active, ptr);
+
+    /* the top block grows in place */
+    if((uint8_t *)blk == active->buf + active->top) {
+        need = active->top + sizeof(arena_block_t) + ARENA_ROUND(new_size);
+        if(need <= active->size) {
+            blk->size = ARENA_ROUND(new_size);
+            active->used = need;
+            if(active->used > active->peak) {
+                active->peak = active->used;
+            }
+            return ptr;
+        }
+    }
+    if((p = hook_alloc(new_size)) == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, (blk->size < new_size ? blk->size : new_size));
+    arena_free(active, ptr);
+    return p;
+}
+
+static void hook_free(void *ptr, size_t size) {
+    if(arena_owns(active, ptr)) {
+        arena_free(active, ptr);
+        return;
+    }
+    saved_free(ptr, size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------
+// public
+// -----------------------------------------------------------------------------------------------------------------------------------------
+/**
+ * bounded scratch memory for the bignum operations,
+ * all the mini-gmp allocations of the owner task between begin() and end() come from it
+ **/
+int vxssh_crypto_arena_alloc(vxssh_crypto_arena_t **arena, size_t size) {
+    vxssh_crypto_arena_t *larena = NULL;
+    int err = OK;
+
+    if(!arena || !size) {
+        return EINVAL;
+    }
+    /* the keys are prepared at the server init and by the keygen task */
+    if(!arena_sem && (arena_sem = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE)) == NULL) {
+        return ENOMEM;
+    }
+    if((larena = vxssh_mem_zalloc(sizeof(vxssh_crypto_arena_t), mem_destructor_vxssh_crypto_arena_t)) == NULL) {
+        return ENOMEM;
+    }
+    larena->size = ARENA_ROUND(size);
+    larena->top = ARENA_NONE;
+    if((larena->buf = vxssh_mem_alloc(larena->size, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+out:
+    if(err != OK) {
+        vxssh_mem_deref(larena);
+    } else {
+        *arena = larena;
+    }
+    return err;
+}
+
+/**
+ * only one arena can be active at a time, system wide:
+ * EBUSY - another task (or this one) has one, the caller goes on with the heap.
+ * end() has to be called by the same task
+ **/
+int vxssh_crypto_arena_begin(vxssh_crypto_arena_t *arena) {
+    if(!arena) {
+        return EINVAL;
+    }
+    if(!arena_sem || semTake(arena_sem, NO_WAIT) != OK) {
+        return EBUSY;
+    }
+    /* the mutex is recursive, a nested begin() of the owner */
+    if(active != NULL) {
+        semGive(arena_sem);
+        return EBUSY;
+    }
+    mp_get_memory_functions(&saved_alloc, &saved_realloc, &saved_free);
+    arena->used = 0;
+    arena->top = ARENA_NONE;
+    arena->heap_ops = 0;
+    active = arena;
+    active_owner = taskIdSelf();
+    mp_set_memory_functions(hook_alloc, hook_realloc, hook_free);
+    return OK;
+}
+
+/**
+ * nothing allocated inside the scope may outlive it,
+ * the scratch is wiped (it held the intermediate values of the private key operation)
+ **/
+void vxssh_crypto_arena_end(vxssh_crypto_arena_t *arena) {
+    if(!arena || active != arena || active_owner != taskIdSelf()) {
+        return;
+    }
+    mp_set_memory_functions(saved_alloc, saved_realloc, saved_free);
+    active = NULL;
+    active_owner = 0;
+    explicit_bzero(arena->buf, arena->peak);
+    arena->used = 0;
+    arena->top = ARENA_NONE;
+    semGive(arena_sem);
+}
@@ -0,0 +1,182 @@
+/**
+ * ssh-ed25519 host keys (RFC 8032, RFC 8709)
+ * the point arithmetic is in smult_curve25519_donna.c
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "vxssh.h"
+#define ED25519_TYPE_NAME "ssh-ed25519"
+
+/* L = 2^252 + 27742317777372353535851937790883648493, little-endian */
+static const int64_t ED25519_L[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+/* r = x mod L, x is 64 radix-2^8 digits (TweetNaCl), no branches on the data */
+static void sc_mod_l(uint8_t *r, int64_t x[64]) {
+    int64_t carry;
+    int i, j;
+
+    for(i = 63; i >= 32; i--) {
+        carry = 0;
+        for(j = i - 32; j < i - 12; j++) {
+            x[j] += carry - 16 * x[i] * ED25519_L[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+    carry = 0;
+    for(j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * ED25519_L[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for(j = 0; j < 32; j++) {
+        x[j] -= carry * ED25519_L[j];
+    }
+    for(i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = x[i] & 255;
+    }
+}
+
+/* 64 bytes -> 32 bytes mod L */
+static void sc_reduce(uint8_t *r, const uint8_t *s) {
+    int64_t x[64];
+    int i;
+
+    for(i = 0; i < 64; i++) {
+        x[i] = s[i];
+    }
+    sc_mod_l(r, x);
+    explicit_bzero(x, sizeof(x));
+}
+
+/* s = (r + k * a) mod L */
+static void sc_muladd(uint8_t *s, const uint8_t *k, const uint8_t *a, const uint8_t *r) {
+    int64_t x[64];
+    int i, j;
+
+    for(i = 0; i < 64; i++) {
+        x[i] = (i < 32 ? r[i] : 0);
+    }
+    for(i = 0; i < 32; i++) {
+        for(j = 0; j < 32; j++) {
+            x[i + j] += (int64_t) k[i] * a[j];
+        }
+    }
+    sc_mod_l(s, x);
+    explicit_bzero(x, sizeof(x));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------
+// public
+// -----------------------------------------------------------------------------------------------------------------------------------------
+/**
+ * expand the 32 byte seed: scalar, prefix and the public key
+ **/
+int vxssh_ed25519_key_init(vxssh_crypto_ed25519_private_key_t *key, const uint8_t *seed) {
+    uint8_t h[VXSSH_DIGEST_SHA512_LENGTH];
+    int err = OK;
+
+    if(!key || !seed) {
+        return EINVAL;
+    }
+    if((err = vxssh_digest_memory(VXSSH_DIGEST_SHA512, seed, CRYPTO_ED25519_KEY_SIZE, h, sizeof(h))) != OK) {
+        goto out;
+    }
+    h[0] &= 248;
+    h[31] &= 127;
+    h[31] |= 64;
+
+    memcpy(key->seed, seed, CRYPTO_ED25519_KEY_SIZE);
+    memcpy(key->scalar, h, CRYPTO_ED25519_KEY_SIZE);
+    memcpy(key->prefix, h + CRYPTO_ED25519_KEY_SIZE, CRYPTO_ED25519_KEY_SIZE);
+
+    if(vxssh_ed25519_scalarmult_base(key->pub, key->scalar) != OK) {
+        vxssh_log_error("ed25519: not supported by this curve25519 implementation");
+        err = ENOSYS; goto out;
+    }
+out:
+    explicit_bzero(h, sizeof(h));
+    return err;
+}
+
+/**
+ *
+ **/
+int vxssh_ed25519_encode_public_key(vxssh_mbuf_t *mb, vxssh_crypto_ed25519_private_key_t *key) {
+    int err = OK;
+
+    if(!mb || !key) {
+        return EINVAL;
+    }
+    if((err = vxssh_mbuf_write_str_sz(mb, ED25519_TYPE_NAME)) != OK) {
+        return err;
+    }
+    return vxssh_mbuf_write_mem_sz(mb, key->pub, CRYPTO_ED25519_KEY_SIZE);
+}
+
+/**
+ *
+ **/
+int vxssh_ed25519_encode_signature(vxssh_mbuf_t *mb, const uint8_t *sig) {
+    int err = OK;
+
+    if(!mb || !sig) {
+        return EINVAL;
+    }
+    if((err = vxssh_mbuf_write_str_sz(mb, ED25519_TYPE_NAME)) != OK) {
+        return err;
+    }
+    return vxssh_mbuf_write_mem_sz(mb, sig, CRYPTO_ED25519_SIGNATURE_SIZE);
+}
+
+/**
+ * sig = R || S
+ *  r = H(prefix || M) mod L, R = r * B
+ *  k = H(R || A || M) mod L, S = (r + k * a) mod L
+ **/
+int vxssh_ed25519_sign(vxssh_crypto_ed25519_private_key_t *key, const uint8_t *data, size_t data_len, uint8_t *sig) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(VXSSH_DIGEST_SHA512);
+    uint64_t ctx[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
+    uint8_t h[VXSSH_DIGEST_SHA512_LENGTH];
+    uint8_t r[CRYPTO_ED25519_KEY_SIZE];
+    uint8_t k[CRYPTO_ED25519_KEY_SIZE];
+    int err = OK;
+
+    if(!key || !data || !sig) {
+        return EINVAL;
+    }
+    if(ops == NULL || ops->ctx_size > sizeof(ctx)) {
+        return ERROR;
+    }
+
+    ops->init(ctx);
+    ops->update(ctx, key->prefix, CRYPTO_ED25519_KEY_SIZE);
+    ops->update(ctx, data, data_len);
+    ops->final(ctx, h);
+    sc_reduce(r, h);
+
+    if(vxssh_ed25519_scalarmult_base(sig, r) != OK) {
+        err = ENOSYS; goto out;
+    }
+
+    ops->init(ctx);
+    ops->update(ctx, sig, CRYPTO_ED25519_KEY_SIZE);
+    ops->update(ctx, key->pub, CRYPTO_ED25519_KEY_SIZE);
+    ops->update(ctx, data, data_len);
+    ops->final(ctx, h);
+    sc_reduce(k, h);
+
+    sc_muladd(sig + CRYPTO_ED25519_KEY_SIZE, k, key->scalar, r);
+out:
+    explicit_bzero(ctx, sizeof(ctx));
+    explicit_bzero(h, sizeof(h));
+    explicit_bzero(r, sizeof(r));
+    return err;
+}
@@ -453,3 +453,20 @@ int vxssh_md5_digest(const void *input, size_t input_len, uint8_t *digest, size_
     return OK;
 }
 
+
+static void md5_ops_init(void *ctx) {
+    md5_init((MD5_CTX *)ctx);
+}
+
+static void md5_ops_update(void *ctx, const void *data, size_t data_len) {
+    md5_append((MD5_CTX *)ctx, data, (int) data_len);
+}
+
+static void md5_ops_final(void *ctx, uint8_t *digest) {
+    md5_finish((MD5_CTX *)ctx, digest);
+}
+
+const vxssh_digest_ops_t vxssh_md5_ops = {
+    VXSSH_DIGEST_MD5, MD5_DIGEST_LENGTH, MD5_BLOCK_LENGTH, sizeof(MD5_CTX),
+    md5_ops_init, md5_ops_update, md5_ops_final
+};
@@ -19,6 +19,17 @@ static void mem_destructor_vxssh_crypto_object_t(void *data) {
                 mpz_clear(key->e);
                 mpz_clear(key->n);
                 mpz_clear(key->d);
+                mpz_clear(key->p);
+                mpz_clear(key->q);
+                mpz_clear(key->dp);
+                mpz_clear(key->dq);
+                mpz_clear(key->qinv);
+                mpz_clear(key->bf);
+                mpz_clear(key->bfi);
+                if(key->bf_sem) {
+                    semDelete(key->bf_sem);
+                }
+                vxssh_mem_deref(key->arena);
             }
             vxssh_mem_deref(key);
             break;
@@ -40,6 +51,14 @@ static void mem_destructor_vxssh_crypto_object_t(void *data) {
             vxssh_mem_deref(sig);
             break;
         }
+        case CRYPTO_OBJECT_ED25519_PRIVATE_KEY: {
+            vxssh_crypto_ed25519_private_key_t *key = p->obj;
+            if(key) {
+                explicit_bzero(key, sizeof(vxssh_crypto_ed25519_private_key_t));
+            }
+            vxssh_mem_deref(key);
+            break;
+        }
     }
 }
 
@@ -76,6 +95,13 @@ int vxssh_crypto_object_alloc(vxssh_crypto_object_t **object, int type) {
             mpz_init(ref->e);
             mpz_init(ref->n);
             mpz_init(ref->d);
+            mpz_init(ref->p);
+            mpz_init(ref->q);
+            mpz_init(ref->dp);
+            mpz_init(ref->dq);
+            mpz_init(ref->qinv);
+            mpz_init(ref->bf);
+            mpz_init(ref->bfi);
             break;
         }
         case CRYPTO_OBJECT_RSA_PUBLIC_KEY: {
@@ -99,6 +125,14 @@ int vxssh_crypto_object_alloc(vxssh_crypto_object_t **object, int type) {
             mpz_init(ref->s);
             break;
         }
+        case CRYPTO_OBJECT_ED25519_PRIVATE_KEY: {
+            lobj->obj = vxssh_mem_zalloc(sizeof(vxssh_crypto_ed25519_private_key_t), NULL);
+            if(!lobj->obj) {
+                err = ENOMEM;
+                goto out;
+            }
+            break;
+        }
         default:
             err = ENOSYS;
     }
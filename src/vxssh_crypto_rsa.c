@@ -112,39 +112,18 @@ out:
  *
  **/
 int vxssh_rsa_encode_signature(vxssh_mbuf_t *mb, vxssh_crypto_rsa_signature_t *sign) {
-    int err = OK, bits = 0;
-    uint8_t *tbuf = NULL;
-    size_t sz =0;
+    int err = OK;
 
     if(!mb || !sign) {
         return EINVAL;
     }
-
-    bits = mpz_sizeinbase (sign->s, 2);
-    sz = (bits / 8 + (bits % 8 ? 1 : 0));
-    if(sz == 0) {
-        err = ERROR; goto out;
-    }
-    if((tbuf = vxssh_mem_zalloc(sz, NULL)) == NULL) {
-        err = ENOMEM; goto out;
-    }
     /* type */
     err = vxssh_mbuf_write_str_sz(mb, RSA_TYPE_NAME);
     if(err != OK) {
-        goto out;
+        return err;
     }
     /* rsa s */
-    mpz_export(tbuf, &sz, 1, 1, 0, 0, sign->s);
-    if (tbuf[0] == 0x0) {
-        vxssh_mbuf_write_u32(mb, sz - 1);
-        vxssh_mbuf_write_mem(mb, tbuf + 1, sz - 1);
-    } else {
-        vxssh_mbuf_write_u32(mb, sz);
-        vxssh_mbuf_write_mem(mb, tbuf, sz);
-    }
-out:
-    vxssh_mem_deref(tbuf);
-    return err;
+    return vxssh_mbuf_write_bn_sz(mb, sign->s);
 }
 
 /**
@@ -188,6 +167,126 @@ out:
     return err;
 }
 
+/**
+ * s = m^d mod n by the CRT (Garner):
+ *  s1 = m^dp mod p, s2 = m^dq mod q
+ *  s  = s2 + q * (qinv * (s1 - s2) mod p)
+ * the result is checked with the public exponent (a fault in one half would leak a factor),
+ * on a mismatch or without CRT parameters it's the full size exponentiation.
+ * The private exponents go through the Montgomery fixed-window mpz_powm_sec()
+ **/
+static void rsa_private(vxssh_crypto_rsa_private_key_t *key, mpz_t s, const mpz_t m) {
+    mpz_t s1, s2, t;
+
+    if(mpz_sgn(key->p) == 0) {
+        mpz_powm_sec(s, m, key->d, key->n);
+        return;
+    }
+    mpz_init(s1);
+    mpz_init(s2);
+    mpz_init(t);
+
+    mpz_mod(t, m, key->p);
+    mpz_powm_sec(s1, t, key->dp, key->p);
+    mpz_mod(t, m, key->q);
+    mpz_powm_sec(s2, t, key->dq, key->q);
+
+    mpz_sub(t, s1, s2);
+    mpz_mul(t, t, key->qinv);
+    mpz_mod(t, t, key->p);
+    mpz_mul(t, t, key->q);
+    mpz_add(s, s2, t);
+
+    mpz_powm(t, s, key->e, key->n);
+    if(mpz_cmp(t, m) != 0) {
+        vxssh_log_warn("RSA: CRT result mismatch");
+        mpz_powm_sec(s, m, key->d, key->n);
+    }
+
+    mpz_clear(s1);
+    mpz_clear(s2);
+    mpz_clear(t);
+}
+
+/**
+ * the arena for rsa_private(), in limbs of n:
+ * the powm_sec tables of the halves, the CRT temporaries and the public exponent check
+ * the blinding pair and the Karatsuba scratch peak at about 108 * nl (1024..4096 bit keys), the rest is headroom.
+ * The full size fallback doesn't fit and goes partly to the heap
+ **/
+#define RSA_ARENA_LIMBS(nl)     (128 * (nl) + 64)
+#define RSA_ARENA_BLOCKS        64
+
+int vxssh_rsa_private_key_prepare(vxssh_crypto_rsa_private_key_t *key) {
+    int err = OK;
+    size_t nl;
+
+    if(!key || mpz_sgn(key->n) == 0) {
+        return EINVAL;
+    }
+    if(!key->bf_sem && (key->bf_sem = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE)) == NULL) {
+        return ENOMEM;
+    }
+    if((err = vxssh_rsa_blinding_update(key, false)) != OK) {
+        return err;
+    }
+    if(key->arena) {
+        return OK;
+    }
+    nl = mpz_size(key->n);
+    return vxssh_crypto_arena_alloc(&key->arena, RSA_ARENA_LIMBS(nl) * sizeof(mp_limb_t) + RSA_ARENA_BLOCKS * 2 * sizeof(size_t));
+}
+
+/**
+ * generates a new blinding pair (r^e, r^-1) for a random r,
+ * it's the inversion the signing doesn't do, so it's called from the idle time.
+ * Without force only a pair that has been used is replaced
+ **/
+int vxssh_rsa_blinding_update(vxssh_crypto_rsa_private_key_t *key, bool force) {
+    const size_t nl = (key ? mpz_size(key->n) : 0);
+    const mp_bitcnt_t bits = (key ? mpz_sizeinbase(key->n, 2) : 0);
+    int i, err = OK;
+    mpz_t r, ri;
+
+    if(!key || nl == 0 || !key->bf_sem) {
+        return EINVAL;
+    }
+    if(!force && key->bf_uses == 0 && mpz_sgn(key->bf) != 0) {
+        return OK;
+    }
+    mpz_init(r);
+    mpz_init(ri);
+    for(i = 0; ; i++) {
+        if(i == 16) {
+            err = ERROR; goto out;
+        }
+        if(vxssh_rnd_bin((char *) mpz_limbs_write(r, nl), nl * sizeof(mp_limb_t)) != OK) {
+            err = ERROR; goto out;
+        }
+        mpz_limbs_finish(r, nl);
+        mpz_mod(r, r, key->n);
+        if(mpz_cmp_ui(r, 1) > 0 && mpz_invert(ri, r, key->n)) {
+            break;
+        }
+    }
+    mpz_powm(r, r, key->e, key->n);
+
+    semTake(key->bf_sem, WAIT_FOREVER);
+    mpz_swap(key->bf, r);
+    mpz_swap(key->bfi, ri);
+    /* room for the squares, so the signing can store them from inside its arena */
+    mpz_realloc2(key->bf, bits);
+    mpz_realloc2(key->bfi, bits);
+    key->bf_uses = 0;
+    semGive(key->bf_sem);
+out:
+    explicit_bzero((void *) mpz_limbs_read(r), mpz_size(r) * sizeof(mp_limb_t));
+    explicit_bzero((void *) mpz_limbs_read(ri), mpz_size(ri) * sizeof(mp_limb_t));
+    mpz_clear(r);
+    mpz_clear(ri);
+    return err;
+}
+
 /**
 * sing the data
 **/
@@ -200,7 +299,8 @@ int vxssh_rsa_sign(vxssh_crypto_rsa_private_key_t *key, const uint8_t *data, siz
     vxssh_crypto_object_t *sigobj=NULL;
     vxssh_crypto_rsa_signature_t *sigref=NULL;
     vxssh_mbuf_t *sigmb = NULL;
-    mpz_t m;
+    bool arena = false;
+    mpz_t m, s, bf, bfi;
 
     if(!key || !data || !signature) {
         return EINVAL;
@@ -239,16 +339,57 @@ int vxssh_rsa_sign(vxssh_crypto_rsa_private_key_t *key, const uint8_t *data, siz
     if((err = vxssh_mbuf_write_mem(sigmb, digest, digest_len)) != OK) {
         goto out;
     }
+    /* no pair yet (the key wasn't prepared), it's generated inline */
+    if(!key->bf_sem || mpz_sgn(key->bf) == 0) {
+        if((err = vxssh_rsa_private_key_prepare(key)) != OK) {
+            goto out;
+        }
+    }
+    /* the result is the only value that leaves the arena, it gets its room before */
+    mpz_realloc2(sigref->s, mpz_sizeinbase(key->n, 2));
+    if(key->arena && vxssh_crypto_arena_begin(key->arena) == OK) {
+        arena = true;
+    }
     mpz_init(m);
+    mpz_init(s);
+    mpz_init(bf);
+    mpz_init(bfi);
+    /* take the pair and square it for the next signature (set, the key's limbs have the room) */
+    semTake(key->bf_sem, WAIT_FOREVER);
+    mpz_set(bf, key->bf);
+    mpz_set(bfi, key->bfi);
+    mpz_mul(s, bf, bf);
+    mpz_mod(s, s, key->n);
+    mpz_set(key->bf, s);
+    mpz_mul(s, bfi, bfi);
+    mpz_mod(s, s, key->n);
+    mpz_set(key->bfi, s);
+    key->bf_uses++;
+    semGive(key->bf_sem);
+    /* s = (m * r^e)^d * r^-1 = m^d (mod n) */
     mpz_import(m, sigmb->pos, 1, 1, 0, 0, sigmb->buf);
-    mpz_powm(sigref->s, m, key->d, key->n);
+    mpz_mul(m, m, bf);
+    mpz_mod(m, m, key->n);
+    rsa_private(key, s, m);
+    mpz_mul(s, s, bfi);
+    mpz_mod(s, s, key->n);
+    mpz_set(sigref->s, s);
+    mpz_clear(bfi);
+    mpz_clear(bf);
+    mpz_clear(s);
+    mpz_clear(m);
+    if(arena) {
+#ifdef VXSSH_DEBUG_RSA_ARENA
+        vxssh_log_debug("RSA: arena peak %u of %u bytes, heap ops %u", key->arena->peak, key->arena->size, key->arena->heap_ops);
+#endif
+        vxssh_crypto_arena_end(key->arena);
+    }
 out:
     if(err != OK) {
         vxssh_mem_deref(sigobj);
     } else {
         *signature = sigobj;
     }
-    mpz_clear(m);
     explicit_bzero(digest, VXSSH_DIGEST_SHA1_LENGTH);
     vxssh_mem_deref(sigmb);
     return err;
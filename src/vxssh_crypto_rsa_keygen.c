@@ -0,0 +1,290 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "vxssh.h"
+#include "vxssh_utils.h"
+
+#define KEYGEN_E                65537
+#define KEYGEN_SIEVE_LIMIT      8192        /* the odd primes below it */
+#define KEYGEN_SIEVE_PRIMES     1027
+#define KEYGEN_SIEVE_WINDOW     4096        /* odd candidates per window */
+#define KEYGEN_MR_ROUNDS        4           /* on top of the BPSW test */
+#define KEYGEN_PQ_DISTANCE      100         /* |p - q| > 2^(bits/2 - 100) */
+
+#define KEY_FILE_MAGIC          0x7678726b  /* "vxrk" */
+#define KEY_FILE_VERSION        1
+#define KEY_FILE_CHECK_SIZE     8           /* sha256 of the fields, truncated */
+
+static uint16_t small_primes[KEYGEN_SIEVE_PRIMES];
+static int small_primes_count = 0;
+
+/* odd primes for the sieve, computed once */
+static int small_primes_init() {
+    uint8_t *comp = NULL;
+    int i, j, n = 0;
+
+    if(small_primes_count) {
+        return OK;
+    }
+    if((comp = vxssh_mem_zalloc(KEYGEN_SIEVE_LIMIT, NULL)) == NULL) {
+        return ENOMEM;
+    }
+    for(i = 3; i < KEYGEN_SIEVE_LIMIT && n < KEYGEN_SIEVE_PRIMES; i += 2) {
+        if(comp[i]) {
+            continue;
+        }
+        small_primes[n++] = i;
+        for(j = i * i; j < KEYGEN_SIEVE_LIMIT; j += 2 * i) {
+            comp[j] = 1;
+        }
+    }
+    small_primes_count = n;
+    vxssh_mem_deref(comp);
+    return OK;
+}
+
+/* marks the window offsets i where x + 2i = r (mod q) */
+static void sieve_mark(uint8_t *sieve, const mpz_t x, unsigned long q, unsigned long r) {
+    unsigned long i = mpz_fdiv_ui(x, q);
+
+    i = ((r + q - i) % q) * ((q + 1) / 2) % q;
+    for(; i < KEYGEN_SIEVE_WINDOW; i += q) {
+        sieve[i >> 3] |= (1 << (i & 7));
+    }
+}
+
+/**
+ * a random odd 'bits' size prime with the two top bits set and p - 1 coprime to e:
+ * a window of candidates after a random start is sieved by the small primes,
+ * only the survivors go to BPSW + Miller-Rabin
+ **/
+static int prime_search(mpz_t p, mp_bitcnt_t bits, uint8_t *sieve, uint32_t *candidates, vxssh_rsa_keygen_cb_t cb, void *udata) {
+    const mp_size_t nl = (bits + mp_bits_per_limb - 1) / mp_bits_per_limb;
+    uint32_t windows = 0;
+    int i, err = OK;
+    mpz_t x;
+
+    mpz_init(x);
+    while(true) {
+        if(vxssh_rnd_bin((char *) mpz_limbs_write(x, nl), nl * sizeof(mp_limb_t)) != OK) {
+            err = ERROR; goto out;
+        }
+        mpz_limbs_finish(x, nl);
+        mpz_tdiv_r_2exp(x, x, bits);
+        mpz_setbit(x, bits - 1);
+        mpz_setbit(x, bits - 2);
+        mpz_setbit(x, 0);
+
+        memset(sieve, 0, KEYGEN_SIEVE_WINDOW / 8);
+        for(i = 0; i < small_primes_count; i++) {
+            sieve_mark(sieve, x, small_primes[i], 0);
+        }
+        sieve_mark(sieve, x, KEYGEN_E, 1);
+        if(cb && (err = cb(VXSSH_RSA_KEYGEN_STAGE_SIEVE, ++windows, udata)) != OK) {
+            goto out;
+        }
+
+        for(i = 0; i < KEYGEN_SIEVE_WINDOW; i++) {
+            if(sieve[i >> 3] & (1 << (i & 7))) {
+                continue;
+            }
+            mpz_add_ui(p, x, 2 * i);
+            if(mpz_sizeinbase(p, 2) != bits) {
+                break;
+            }
+            if(cb && (err = cb(VXSSH_RSA_KEYGEN_STAGE_CANDIDATE, ++(*candidates), udata)) != OK) {
+                goto out;
+            }
+            if(mpz_probab_prime_p(p, 24 + KEYGEN_MR_ROUNDS)) {
+                goto out;
+            }
+        }
+    }
+out:
+    mpz_clear(x);
+    return err;
+}
+
+/**
+ * n, d and the CRT parameters from e, p, q (p > q)
+ **/
+static int rsa_key_complete(vxssh_crypto_rsa_private_key_t *key) {
+    int err = OK;
+    mpz_t p1, q1, l;
+
+    if(mpz_cmp_ui(key->q, 2) <= 0 || mpz_cmp(key->p, key->q) <= 0 || mpz_even_p(key->e) || mpz_cmp_ui(key->e, 3) < 0) {
+        return EINVAL;
+    }
+    mpz_init(p1);
+    mpz_init(q1);
+    mpz_init(l);
+
+    mpz_mul(key->n, key->p, key->q);
+    mpz_sub_ui(p1, key->p, 1);
+    mpz_sub_ui(q1, key->q, 1);
+    mpz_lcm(l, p1, q1);
+    if(!mpz_invert(key->d, key->e, l) || !mpz_invert(key->qinv, key->q, key->p)) {
+        err = ERROR; goto out;
+    }
+    mpz_mod(key->dp, key->d, p1);
+    mpz_mod(key->dq, key->d, q1);
+out:
+    mpz_clear(p1);
+    mpz_clear(q1);
+    mpz_clear(l);
+    return err;
+}
+
+/**
+ * new RSA private key (e = 65537) with the CRT parameters,
+ * it takes seconds to minutes on the target, so it's for a low priority task.
+ * The callback reports the progress, anything but OK from it stops the search
+ **/
+int vxssh_rsa_generate_key(vxssh_crypto_object_t **key, uint32_t bits, vxssh_rsa_keygen_cb_t cb, void *udata) {
+    vxssh_crypto_object_t *kobj = NULL;
+    vxssh_crypto_rsa_private_key_t *pkey = NULL;
+    uint8_t *sieve = NULL;
+    uint32_t candidates = 0;
+    int err = OK;
+    mpz_t t;
+
+    if(!key || bits < 1024 || bits > 8192 || (bits & 1)) {
+        return EINVAL;
+    }
+    if((err = small_primes_init()) != OK) {
+        return err;
+    }
+    mpz_init(t);
+    if((sieve = vxssh_mem_zalloc(KEYGEN_SIEVE_WINDOW / 8, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    if((err = vxssh_crypto_object_alloc(&kobj, CRYPTO_OBJECT_RSA_PRIVATE_KEY)) != OK) {
+        goto out;
+    }
+    pkey = kobj->obj;
+    mpz_set_ui(pkey->e, KEYGEN_E);
+
+    if((err = prime_search(pkey->p, bits / 2, sieve, &candidates, cb, udata)) != OK) {
+        goto out;
+    }
+    if(cb && (err = cb(VXSSH_RSA_KEYGEN_STAGE_PRIME, 1, udata)) != OK) {
+        goto out;
+    }
+    while(true) {
+        if((err = prime_search(pkey->q, bits / 2, sieve, &candidates, cb, udata)) != OK) {
+            goto out;
+        }
+        mpz_sub(t, pkey->p, pkey->q);
+        if(mpz_sizeinbase(t, 2) > bits / 2 - KEYGEN_PQ_DISTANCE) {
+            break;
+        }
+    }
+    if(cb && (err = cb(VXSSH_RSA_KEYGEN_STAGE_PRIME, 2, udata)) != OK) {
+        goto out;
+    }
+    if(mpz_cmp(pkey->p, pkey->q) < 0) {
+        mpz_swap(pkey->p, pkey->q);
+    }
+    if((err = rsa_key_complete(pkey)) != OK) {
+        goto out;
+    }
+    if(mpz_sizeinbase(pkey->n, 2) != bits) {
+        err = ERROR; goto out;
+    }
+    if(vxssh_rsa_private_key_prepare(pkey) != OK) {
+        vxssh_log_warn("RSA: key prepare fail, signing will use the heap");
+    }
+out:
+    mpz_clear(t);
+    if(err != OK) {
+        vxssh_mem_deref(kobj);
+    } else {
+        *key = kobj;
+    }
+    vxssh_mem_deref(sieve);
+    return err;
+}
+
+/**
+ * compact persisted form: magic | version | mpint e | mpint p | mpint q | check,
+ * the rest of the key is derived on load
+ **/
+int vxssh_rsa_key_save(vxssh_mbuf_t *mb, vxssh_crypto_rsa_private_key_t *key) {
+    uint8_t digest[VXSSH_DIGEST_SHA256_LENGTH];
+    size_t start;
+    int err = OK;
+
+    if(!mb || !key || mpz_sgn(key->p) == 0) {
+        return EINVAL;
+    }
+    start = mb->pos;
+    vxssh_mbuf_write_u32(mb, KEY_FILE_MAGIC);
+    vxssh_mbuf_write_u8(mb, KEY_FILE_VERSION);
+    if((err = vxssh_mbuf_write_mpint(mb, key->e)) != OK) {
+        return err;
+    }
+    if((err = vxssh_mbuf_write_mpint(mb, key->p)) != OK) {
+        return err;
+    }
+    if((err = vxssh_mbuf_write_mpint(mb, key->q)) != OK) {
+        return err;
+    }
+    if((err = vxssh_digest_memory(VXSSH_DIGEST_SHA256, mb->buf + start, mb->pos - start, digest, sizeof(digest))) != OK) {
+        return err;
+    }
+    return vxssh_mbuf_write_mem(mb, digest, KEY_FILE_CHECK_SIZE);
+}
+
+/**
+ * parses the vxssh_rsa_key_save() form into a new private key
+ **/
+int vxssh_rsa_key_load(vxssh_mbuf_t *mb, vxssh_crypto_object_t **key) {
+    uint8_t digest[VXSSH_DIGEST_SHA256_LENGTH];
+    vxssh_crypto_object_t *kobj = NULL;
+    vxssh_crypto_rsa_private_key_t *pkey = NULL;
+    size_t start;
+    int err = OK;
+
+    if(!mb || !key) {
+        return EINVAL;
+    }
+    start = mb->pos;
+    if(vxssh_mbuf_get_left(mb) < 5 + KEY_FILE_CHECK_SIZE || vxssh_mbuf_read_u32(mb) != KEY_FILE_MAGIC || vxssh_mbuf_read_u8(mb) != KEY_FILE_VERSION) {
+        vxssh_log_error("RSA: not a key file");
+        return ERROR;
+    }
+    if((err = vxssh_crypto_object_alloc(&kobj, CRYPTO_OBJECT_RSA_PRIVATE_KEY)) != OK) {
+        return err;
+    }
+    pkey = kobj->obj;
+    if(vxssh_mbuf_read_mpint(mb, pkey->e) != OK || vxssh_mbuf_read_mpint(mb, pkey->p) != OK || vxssh_mbuf_read_mpint(mb, pkey->q) != OK) {
+        err = ERROR; goto out;
+    }
+    if(vxssh_mbuf_get_left(mb) < KEY_FILE_CHECK_SIZE) {
+        err = ERROR; goto out;
+    }
+    if((err = vxssh_digest_memory(VXSSH_DIGEST_SHA256, mb->buf + start, mb->pos - start, digest, sizeof(digest))) != OK) {
+        goto out;
+    }
+    if(timingsafe_bcmp(digest, mb->buf + mb->pos, KEY_FILE_CHECK_SIZE) != 0) {
+        vxssh_log_error("RSA: key file is corrupted");
+        err = ERROR; goto out;
+    }
+    mb->pos += KEY_FILE_CHECK_SIZE;
+    if((err = rsa_key_complete(pkey)) != OK) {
+        goto out;
+    }
+    if(vxssh_rsa_private_key_prepare(pkey) != OK) {
+        vxssh_log_warn("RSA: key prepare fail, signing will use the heap");
+    }
+out:
+    if(err != OK) {
+        vxssh_mem_deref(kobj);
+    } else {
+        *key = kobj;
+    }
+    explicit_bzero(digest, sizeof(digest));
+    return err;
+}
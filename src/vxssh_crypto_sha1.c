@@ -16,8 +16,7 @@ By Steve Reid <sreid@sea-to-sky.net>
 
 /* blk0() and blk() perform the initial expand. */
 /* I got the idea of expanding during the round function from SSLeay */
-/* FIXME: can we do this in an endian-proof way? */
-#ifdef BYTE_ORDER
+#if BYTE_ORDER == BIG_ENDIAN
  #define blk0(i) block->l[i]
 #else
  #define blk0(i) (block->l[i] = (rol(block->l[i],24)&0xff00ff00) |(rol(block->l[i],8)&0x00ff00ff))
@@ -30,6 +29,25 @@ By Steve Reid <sreid@sea-to-sky.net>
 #define R3(v,w,x,y,z,i) z+=(((w|x)&y)|(w&x))+blk(i)+0x8f1bbcdc+rol(v,5);w=rol(w,30);
 #define R4(v,w,x,y,z,i) z+=(w^x^y)+blk(i)+0xca62c1d6+rol(v,5);w=rol(w,30);
 
+/* the register friendly variant */
+#define SHA1_F0(b,c,d)  ((((c) ^ (d)) & (b)) ^ (d))
+#define SHA1_F1(b,c,d)  ((b) ^ (c) ^ (d))
+#define SHA1_F2(b,c,d)  (((b) & (c)) | ((d) & ((b) | (c))))
+#define SHA1_LOAD(w,p)  w = ((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3]
+#define SHA1_EXPAND(w0,w2,w8,w13) (w0 = rol((w13) ^ (w8) ^ (w2) ^ (w0), 1))
+#define SHA1_STEP(a,b,c,d,e,f,k,w) do { e += rol(a, 5) + f(b, c, d) + (k) + (w); b = rol(b, 30); } while(0)
+
+/*
+ * Hardware transforms, compiled where the toolchain knows the instructions
+ * and enabled only if cpuid reports them.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 5) && (defined(__x86_64__) || defined(__i386__)) && !defined(SHA1_NO_HWACCEL)
+#define SHA1_HAVE_SHANI 1
+#define SHA1_SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 typedef struct _SHA1_CTX {
     uint32_t    state[5];
     uint32_t    count[2];
@@ -39,7 +57,7 @@ typedef struct _SHA1_CTX {
 
 // ----------------------------------------------------------------------------------------------------------
 /* Hash a single 512-bit block. This is the core of the algorithm. */
-static void SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]) {
+static void SHA1_Transform_ref(uint32_t state[5], const uint8_t buffer[64]) {
     uint32_t a, b, c, d, e;
     typedef union {
         uint8_t  c[64];
@@ -155,8 +173,214 @@ static void SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]) {
     a = b = c = d = e = 0;
 }
 
+/*
+ * Same rounds with the 16-word schedule in locals instead of a memory
+ * workspace, so the compiler can keep most of it in registers and the
+ * block is read in place (big-endian loads, no copy).
+ */
+static void SHA1_Transform_c(uint32_t state[5], const uint8_t buffer[64]) {
+    uint32_t a, b, c, d, e;
+    uint32_t W0, W1, W2, W3, W4, W5, W6, W7, W8, W9, W10, W11, W12, W13, W14, W15;
+
+    SHA1_LOAD(W0, buffer +  0); SHA1_LOAD(W1, buffer +  4); SHA1_LOAD(W2, buffer +  8); SHA1_LOAD(W3, buffer + 12);
+    SHA1_LOAD(W4, buffer + 16); SHA1_LOAD(W5, buffer + 20); SHA1_LOAD(W6, buffer + 24); SHA1_LOAD(W7, buffer + 28);
+    SHA1_LOAD(W8, buffer + 32); SHA1_LOAD(W9, buffer + 36); SHA1_LOAD(W10, buffer + 40); SHA1_LOAD(W11, buffer + 44);
+    SHA1_LOAD(W12, buffer + 48); SHA1_LOAD(W13, buffer + 52); SHA1_LOAD(W14, buffer + 56); SHA1_LOAD(W15, buffer + 60);
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    SHA1_STEP(a,b,c,d,e, SHA1_F0, 0x5a827999, W0);
+    SHA1_STEP(e,a,b,c,d, SHA1_F0, 0x5a827999, W1);
+    SHA1_STEP(d,e,a,b,c, SHA1_F0, 0x5a827999, W2);
+    SHA1_STEP(c,d,e,a,b, SHA1_F0, 0x5a827999, W3);
+    SHA1_STEP(b,c,d,e,a, SHA1_F0, 0x5a827999, W4);
+    SHA1_STEP(a,b,c,d,e, SHA1_F0, 0x5a827999, W5);
+    SHA1_STEP(e,a,b,c,d, SHA1_F0, 0x5a827999, W6);
+    SHA1_STEP(d,e,a,b,c, SHA1_F0, 0x5a827999, W7);
+    SHA1_STEP(c,d,e,a,b, SHA1_F0, 0x5a827999, W8);
+    SHA1_STEP(b,c,d,e,a, SHA1_F0, 0x5a827999, W9);
+    SHA1_STEP(a,b,c,d,e, SHA1_F0, 0x5a827999, W10);
+    SHA1_STEP(e,a,b,c,d, SHA1_F0, 0x5a827999, W11);
+    SHA1_STEP(d,e,a,b,c, SHA1_F0, 0x5a827999, W12);
+    SHA1_STEP(c,d,e,a,b, SHA1_F0, 0x5a827999, W13);
+    SHA1_STEP(b,c,d,e,a, SHA1_F0, 0x5a827999, W14);
+    SHA1_STEP(a,b,c,d,e, SHA1_F0, 0x5a827999, W15);
+    SHA1_STEP(e,a,b,c,d, SHA1_F0, 0x5a827999, SHA1_EXPAND(W0, W2, W8, W13));
+    SHA1_STEP(d,e,a,b,c, SHA1_F0, 0x5a827999, SHA1_EXPAND(W1, W3, W9, W14));
+    SHA1_STEP(c,d,e,a,b, SHA1_F0, 0x5a827999, SHA1_EXPAND(W2, W4, W10, W15));
+    SHA1_STEP(b,c,d,e,a, SHA1_F0, 0x5a827999, SHA1_EXPAND(W3, W5, W11, W0));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W4, W6, W12, W1));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W5, W7, W13, W2));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W6, W8, W14, W3));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W7, W9, W15, W4));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W8, W10, W0, W5));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W9, W11, W1, W6));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W10, W12, W2, W7));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W11, W13, W3, W8));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W12, W14, W4, W9));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W13, W15, W5, W10));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W14, W0, W6, W11));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W15, W1, W7, W12));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W0, W2, W8, W13));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W1, W3, W9, W14));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W2, W4, W10, W15));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W3, W5, W11, W0));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W4, W6, W12, W1));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W5, W7, W13, W2));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W6, W8, W14, W3));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0x6ed9eba1, SHA1_EXPAND(W7, W9, W15, W4));
+    SHA1_STEP(a,b,c,d,e, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W8, W10, W0, W5));
+    SHA1_STEP(e,a,b,c,d, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W9, W11, W1, W6));
+    SHA1_STEP(d,e,a,b,c, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W10, W12, W2, W7));
+    SHA1_STEP(c,d,e,a,b, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W11, W13, W3, W8));
+    SHA1_STEP(b,c,d,e,a, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W12, W14, W4, W9));
+    SHA1_STEP(a,b,c,d,e, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W13, W15, W5, W10));
+    SHA1_STEP(e,a,b,c,d, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W14, W0, W6, W11));
+    SHA1_STEP(d,e,a,b,c, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W15, W1, W7, W12));
+    SHA1_STEP(c,d,e,a,b, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W0, W2, W8, W13));
+    SHA1_STEP(b,c,d,e,a, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W1, W3, W9, W14));
+    SHA1_STEP(a,b,c,d,e, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W2, W4, W10, W15));
+    SHA1_STEP(e,a,b,c,d, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W3, W5, W11, W0));
+    SHA1_STEP(d,e,a,b,c, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W4, W6, W12, W1));
+    SHA1_STEP(c,d,e,a,b, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W5, W7, W13, W2));
+    SHA1_STEP(b,c,d,e,a, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W6, W8, W14, W3));
+    SHA1_STEP(a,b,c,d,e, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W7, W9, W15, W4));
+    SHA1_STEP(e,a,b,c,d, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W8, W10, W0, W5));
+    SHA1_STEP(d,e,a,b,c, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W9, W11, W1, W6));
+    SHA1_STEP(c,d,e,a,b, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W10, W12, W2, W7));
+    SHA1_STEP(b,c,d,e,a, SHA1_F2, 0x8f1bbcdc, SHA1_EXPAND(W11, W13, W3, W8));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W12, W14, W4, W9));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W13, W15, W5, W10));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W14, W0, W6, W11));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W15, W1, W7, W12));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W0, W2, W8, W13));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W1, W3, W9, W14));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W2, W4, W10, W15));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W3, W5, W11, W0));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W4, W6, W12, W1));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W5, W7, W13, W2));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W6, W8, W14, W3));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W7, W9, W15, W4));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W8, W10, W0, W5));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W9, W11, W1, W6));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W10, W12, W2, W7));
+    SHA1_STEP(a,b,c,d,e, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W11, W13, W3, W8));
+    SHA1_STEP(e,a,b,c,d, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W12, W14, W4, W9));
+    SHA1_STEP(d,e,a,b,c, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W13, W15, W5, W10));
+    SHA1_STEP(c,d,e,a,b, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W14, W0, W6, W11));
+    SHA1_STEP(b,c,d,e,a, SHA1_F1, 0xca62c1d6, SHA1_EXPAND(W15, W1, W7, W12));
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+#ifdef SHA1_HAVE_SHANI
+#define SHA1_NI_GROUP(g, f) do {                                            \
+        if ((g) > 0)                                                        \
+            e0 = _mm_sha1nexte_epu32(e1, m[(g) & 3]);                       \
+        e1 = abcd;                                                          \
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, f);                            \
+        if ((g) >= 1 && (g) <= 16)                                          \
+            m[((g) - 1) & 3] = _mm_sha1msg1_epu32(m[((g) - 1) & 3], m[(g) & 3]); \
+        if ((g) >= 2 && (g) <= 17)                                          \
+            m[((g) - 2) & 3] = _mm_xor_si128(m[((g) - 2) & 3], m[(g) & 3]); \
+        if ((g) >= 3 && (g) <= 18)                                          \
+            m[((g) + 1) & 3] = _mm_sha1msg2_epu32(m[((g) + 1) & 3], m[(g) & 3]); \
+} while(0)
+
+/*
+ * x86 SHA extensions, 4 rounds per instruction
+ */
+SHA1_SHANI_TARGET
+static void SHA1_Transform_shani(uint32_t state[5], const uint8_t buffer[64]) {
+    const __m128i bswap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e0, e1, e_save, m[4];
+    int i;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    e_save = _mm_set_epi32(state[4], 0, 0, 0);
+    abcd_save = abcd;
+
+    for (i = 0; i < 4; i++) {
+        m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buffer + i * 16)), bswap);
+    }
+    e0 = _mm_add_epi32(e_save, m[0]);
+
+    SHA1_NI_GROUP( 0, 0); SHA1_NI_GROUP( 1, 0); SHA1_NI_GROUP( 2, 0); SHA1_NI_GROUP( 3, 0); SHA1_NI_GROUP( 4, 0);
+    SHA1_NI_GROUP( 5, 1); SHA1_NI_GROUP( 6, 1); SHA1_NI_GROUP( 7, 1); SHA1_NI_GROUP( 8, 1); SHA1_NI_GROUP( 9, 1);
+    SHA1_NI_GROUP(10, 2); SHA1_NI_GROUP(11, 2); SHA1_NI_GROUP(12, 2); SHA1_NI_GROUP(13, 2); SHA1_NI_GROUP(14, 2);
+    SHA1_NI_GROUP(15, 3); SHA1_NI_GROUP(16, 3); SHA1_NI_GROUP(17, 3); SHA1_NI_GROUP(18, 3); SHA1_NI_GROUP(19, 3);
+
+    e0 = _mm_sha1nexte_epu32(e1, e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+SHA1_SHANI_TARGET
+static int sha1_shani_supported() {
+    unsigned int a, b, c, d;
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+    __cpuid_count(1, 0, a, b, c, d);
+    if (!(c & bit_SSE4_1) || !(c & bit_SSSE3)) {
+        return 0;
+    }
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & (1 << 29)) != 0;    /* CPUID.7.0:EBX.SHA */
+}
+#endif /* SHA1_HAVE_SHANI */
+
+static void (*SHA1_Transform)(uint32_t state[5], const uint8_t buffer[64]) = NULL;
+static int sha1_impl = VXSSH_SHA1_IMPL_AUTO;
+
+static int sha1_transform_select(int impl) {
+    if (impl == VXSSH_SHA1_IMPL_AUTO) {
+        impl = VXSSH_SHA1_IMPL_C;
+#ifdef SHA1_HAVE_SHANI
+        if (sha1_shani_supported()) {
+            impl = VXSSH_SHA1_IMPL_SHANI;
+        }
+#endif
+    }
+    switch (impl) {
+        case VXSSH_SHA1_IMPL_REF:
+            SHA1_Transform = SHA1_Transform_ref;
+            break;
+        case VXSSH_SHA1_IMPL_C:
+            SHA1_Transform = SHA1_Transform_c;
+            break;
+#ifdef SHA1_HAVE_SHANI
+        case VXSSH_SHA1_IMPL_SHANI:
+            if (!sha1_shani_supported()) {
+                return ENOTSUP;
+            }
+            SHA1_Transform = SHA1_Transform_shani;
+            break;
+#endif
+        default:
+            return ENOTSUP;
+    }
+    sha1_impl = impl;
+    return OK;
+}
+
 static void SHA1_Reset(SHA1_CTX* context) {
 
+    if (SHA1_Transform == NULL) {
+        sha1_transform_select(VXSSH_SHA1_IMPL_AUTO);
+    }
+
     context->state[0] = 0x67452301;
     context->state[1] = 0xefcdab89;
     context->state[2] = 0x98badcfe;
@@ -301,3 +525,31 @@ int vxssh_sha1_digest(const void *input, size_t input_len, uint8_t *digest, size
 
     return OK;
 }
+
+int vxssh_sha1_set_impl(int impl) {
+    return sha1_transform_select(impl);
+}
+
+int vxssh_sha1_get_impl() {
+    if (SHA1_Transform == NULL) {
+        sha1_transform_select(VXSSH_SHA1_IMPL_AUTO);
+    }
+    return sha1_impl;
+}
+
+static void sha1_ops_init(void *ctx) {
+    SHA1_Init((SHA1_CTX *)ctx);
+}
+
+static void sha1_ops_update(void *ctx, const void *data, size_t data_len) {
+    SHA1_Update((SHA1_CTX *)ctx, data, data_len);
+}
+
+static void sha1_ops_final(void *ctx, uint8_t *digest) {
+    SHA1_Final(digest, (SHA1_CTX *)ctx);
+}
+
+const vxssh_digest_ops_t vxssh_sha1_ops = {
+    VXSSH_DIGEST_SHA1, SHA1_DIGEST_LENGTH, SHA1_BLOCK_LENGTH, sizeof(SHA1_CTX),
+    sha1_ops_init, sha1_ops_update, sha1_ops_final
+};
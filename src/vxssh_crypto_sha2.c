@@ -44,6 +44,8 @@
  *
  *   #define SHA2_UNROLL_TRANSFORM
  *
+ * Both C transforms are always built (see vxssh_sha256_set_impl()), the
+ * define only picks the default one when no hardware transform is usable.
  */
 #include "vxssh.h"
 
@@ -51,10 +53,28 @@
 #error Define BYTE_ORDER to be equal to either LITTLE_ENDIAN or BIG_ENDIAN
 #endif
 
-//#define SHA2_UNROLL_TRANSFORM 1
+#define SHA2_UNROLL_TRANSFORM 1
+
+/*
+ * Hardware transforms, compiled where the toolchain knows the instructions
+ * and (on x86) enabled only if cpuid reports them.
+ */
+#if defined(__GNUC__) && (__GNUC__ >= 5) && (defined(__x86_64__) || defined(__i386__)) && !defined(SHA2_NO_HWACCEL)
+#define SHA2_HAVE_SHANI 1
+#define SHA2_SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__ARM_NEON) && !defined(SHA2_NO_HWACCEL)
+#define SHA2_HAVE_ARMV8 1
+#include <arm_neon.h>
+#endif
 #define SHA256_DIGEST_LENGTH            32
 #define SHA256_BLOCK_LENGTH             64
 #define SHA256_DIGEST_STRING_LENGTH     (SHA256_DIGEST_LENGTH * 2 + 1)
+#define SHA512_DIGEST_LENGTH            64
+#define SHA512_BLOCK_LENGTH             128
+#define SHA512_DIGEST_STRING_LENGTH     (SHA512_DIGEST_LENGTH * 2 + 1)
 
 typedef struct _SHA256_CTX{
         uint32_t       state[8];
@@ -62,9 +82,16 @@ typedef struct _SHA256_CTX{
         uint8_t        buffer[SHA256_BLOCK_LENGTH];
 } SHA256_CTX;
 
+typedef struct _SHA512_CTX{
+        uint64_t       state[8];
+        uint64_t       bitcount[2];
+        uint8_t        buffer[SHA512_BLOCK_LENGTH];
+} SHA512_CTX;
+
 /*** SHA-256/384/512 Various Length Definitions ***********************/
 /* NOTE: Most of these are in sha2.h */
 #define SHA256_SHORT_BLOCK_LENGTH       (SHA256_BLOCK_LENGTH - 8)
+#define SHA512_SHORT_BLOCK_LENGTH       (SHA512_BLOCK_LENGTH - 16)
 
 /*** ENDIAN SPECIFIC COPY MACROS **************************************/
 #define BE_8_TO_32(dst, cp) do {                                        \
@@ -73,10 +100,10 @@ typedef struct _SHA256_CTX{
 } while(0)
 
 #define BE_8_TO_64(dst, cp) do {                                        \
-        (dst) = (u_int64_t)(cp)[7] | ((u_int64_t)(cp)[6] << 8) |        \
-            ((u_int64_t)(cp)[5] << 16) | ((u_int64_t)(cp)[4] << 24) |   \
-            ((u_int64_t)(cp)[3] << 32) | ((u_int64_t)(cp)[2] << 40) |   \
-            ((u_int64_t)(cp)[1] << 48) | ((u_int64_t)(cp)[0] << 56);    \
+        (dst) = (uint64_t)(cp)[7] | ((uint64_t)(cp)[6] << 8) |        \
+            ((uint64_t)(cp)[5] << 16) | ((uint64_t)(cp)[4] << 24) |   \
+            ((uint64_t)(cp)[3] << 32) | ((uint64_t)(cp)[2] << 40) |   \
+            ((uint64_t)(cp)[1] << 48) | ((uint64_t)(cp)[0] << 56);    \
 } while (0)
 
 #define BE_64_TO_8(cp, src) do {                                        \
@@ -103,7 +130,7 @@ typedef struct _SHA256_CTX{
  * 64-bit words):
  */
 #define ADDINC128(w,n) do {                                             \
-        (w)[0] += (u_int64_t)(n);                                       \
+        (w)[0] += (uint64_t)(n);                                       \
         if ((w)[0] < (n)) {                                             \
                 (w)[1]++;                                               \
         }                                                               \
@@ -135,9 +162,15 @@ typedef struct _SHA256_CTX{
 #define sigma0_256(x)   (S32(7,  (x)) ^ S32(18, (x)) ^ R(3 ,   (x)))
 #define sigma1_256(x)   (S32(17, (x)) ^ S32(19, (x)) ^ R(10,   (x)))
 
+/* Four of six logical functions used in SHA-384 and SHA-512: */
+#define Sigma0_512(x)   (S64(28, (x)) ^ S64(34, (x)) ^ S64(39, (x)))
+#define Sigma1_512(x)   (S64(14, (x)) ^ S64(18, (x)) ^ S64(41, (x)))
+#define sigma0_512(x)   (S64( 1, (x)) ^ S64( 8, (x)) ^ R( 7,   (x)))
+#define sigma1_512(x)   (S64(19, (x)) ^ S64(61, (x)) ^ R( 6,   (x)))
+
 /*** SHA-XYZ INITIAL HASH VALUES AND CONSTANTS ************************/
 /* Hash constant words K for SHA-256: */
-const static uint32_t K256[64] = {
+static const uint32_t K256[64] = {
         0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL,
         0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
         0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL,
@@ -157,7 +190,7 @@ const static uint32_t K256[64] = {
 };
 
 /* Initial hash value H for SHA-256: */
-const static uint32_t sha256_initial_hash_value[8] = {
+static const uint32_t sha256_initial_hash_value[8] = {
         0x6a09e667UL,
         0xbb67ae85UL,
         0x3c6ef372UL,
@@ -168,19 +201,65 @@ const static uint32_t sha256_initial_hash_value[8] = {
         0x5be0cd19UL
 };
 
+/* Hash constant words K for SHA-384 and SHA-512: */
+static const uint64_t K512[80] = {
+        0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+        0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+        0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+        0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+        0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+        0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+        0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+        0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+        0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+        0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+        0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+        0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+        0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+        0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+        0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+        0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+        0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+        0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+        0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+        0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+        0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+        0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+        0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+        0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+        0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+        0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+        0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+        0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+        0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+        0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+        0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+        0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+        0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+        0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+        0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+        0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+        0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+        0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+        0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+        0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* Initial hash value H for SHA-512 */
+static const uint64_t sha512_initial_hash_value[8] = {
+        0x6a09e667f3bcc908ULL,
+        0xbb67ae8584caa73bULL,
+        0x3c6ef372fe94f82bULL,
+        0xa54ff53a5f1d36f1ULL,
+        0x510e527fade682d1ULL,
+        0x9b05688c2b3e6c1fULL,
+        0x1f83d9abfb41bd6bULL,
+        0x5be0cd19137e2179ULL
+};
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // SHA-256 private
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
-static void SHA256_Init(SHA256_CTX *context) {
-	if (context == NULL)
-		return;
-	memcpy(context->state, sha256_initial_hash_value, sizeof(sha256_initial_hash_value));
-	memset(context->buffer, 0, sizeof(context->buffer));
-	context->bitcount = 0;
-}
-
-#ifdef SHA2_UNROLL_TRANSFORM
-
 /* Unrolled SHA-256 round macros: */
 
 #define ROUND256_0_TO_15(a,b,c,d,e,f,g,h) do {				    \
@@ -204,7 +283,7 @@ static void SHA256_Init(SHA256_CTX *context) {
 	j++;								    \
 } while(0)
 
-static void SHA256_Transform(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
+static void SHA256_Transform_unrolled(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
 	uint32_t	a, b, c, d, e, f, g, h, s0, s1;
 	uint32_t	T1, W256[16];
 	int		j;
@@ -258,9 +337,7 @@ static void SHA256_Transform(uint32_t state[8], const uint8_t data[SHA256_BLOCK_
 	a = b = c = d = e = f = g = h = T1 = 0;
 }
 
-#else /* SHA2_UNROLL_TRANSFORM */
-
-static void SHA256_Transform(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
+static void SHA256_Transform_ref(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
 	uint32_t	a, b, c, d, e, f, g, h, s0, s1;
 	uint32_t	T1, T2, W256[16];
 	int		j;
@@ -331,7 +408,147 @@ static void SHA256_Transform(uint32_t state[8], const uint8_t data[SHA256_BLOCK_
 	a = b = c = d = e = f = g = h = T1 = T2 = 0;
 }
 
-#endif /* SHA2_UNROLL_TRANSFORM */
+#ifdef SHA2_HAVE_SHANI
+/*
+ * x86 SHA extensions, the state is kept as ABEF/CDGH in two registers
+ */
+SHA2_SHANI_TARGET
+static void SHA256_Transform_shani(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
+	const __m128i	bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i		state0, state1, abef, cdgh, msg, tmp, m[4];
+	int		j;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);	/* CDAB */
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);	/* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);					/* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);					/* CDGH */
+	abef = state0;
+	cdgh = state1;
+
+	for (j = 0; j < 4; j++)
+		m[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + j * 16)), bswap);
+
+	/* 16 x 4 rounds, the schedule runs 3 groups ahead */
+	for (j = 0; j < 16; j++) {
+		msg = _mm_add_epi32(m[j & 3], _mm_loadu_si128((const __m128i *)&K256[j * 4]));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+		if (j < 12) {
+			tmp = _mm_sha256msg1_epu32(m[j & 3], m[(j + 1) & 3]);
+			tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(m[(j + 3) & 3], m[(j + 2) & 3], 4));
+			m[j & 3] = _mm_sha256msg2_epu32(tmp, m[(j + 3) & 3]);
+		}
+	}
+
+	state0 = _mm_add_epi32(state0, abef);
+	state1 = _mm_add_epi32(state1, cdgh);
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);				/* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);			/* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);			/* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);			/* HGFE */
+
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+SHA2_SHANI_TARGET
+static int sha2_shani_supported() {
+	unsigned int	a, b, c, d;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(1, 0, a, b, c, d);
+	if (!(c & bit_SSE4_1) || !(c & bit_SSSE3))
+		return 0;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b & (1 << 29)) != 0;	/* CPUID.7.0:EBX.SHA */
+}
+#endif /* SHA2_HAVE_SHANI */
+
+#ifdef SHA2_HAVE_ARMV8
+/*
+ * ARMv8 crypto extensions, the state is kept as ABCD/EFGH
+ */
+static void SHA256_Transform_armv8(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) {
+	uint32x4_t	abcd, efgh, abcd_save, efgh_save, wk, tmp, m[4];
+	int		j;
+
+	abcd = abcd_save = vld1q_u32(&state[0]);
+	efgh = efgh_save = vld1q_u32(&state[4]);
+
+	for (j = 0; j < 4; j++)
+		m[j] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + j * 16)));
+
+	for (j = 0; j < 16; j++) {
+		wk = vaddq_u32(m[j & 3], vld1q_u32(&K256[j * 4]));
+		if (j < 12)
+			m[j & 3] = vsha256su1q_u32(vsha256su0q_u32(m[j & 3], m[(j + 1) & 3]), m[(j + 2) & 3], m[(j + 3) & 3]);
+		tmp = abcd;
+		abcd = vsha256hq_u32(abcd, efgh, wk);
+		efgh = vsha256h2q_u32(efgh, tmp, wk);
+	}
+
+	vst1q_u32(&state[0], vaddq_u32(abcd, abcd_save));
+	vst1q_u32(&state[4], vaddq_u32(efgh, efgh_save));
+}
+#endif /* SHA2_HAVE_ARMV8 */
+
+static void (*SHA256_Transform)(uint32_t state[8], const uint8_t data[SHA256_BLOCK_LENGTH]) = NULL;
+static int sha256_impl = VXSSH_SHA2_IMPL_AUTO;
+
+static int sha256_transform_select(int impl) {
+	if (impl == VXSSH_SHA2_IMPL_AUTO) {
+#ifdef SHA2_HAVE_ARMV8
+		impl = VXSSH_SHA2_IMPL_ARMV8;
+#else
+#ifdef SHA2_HAVE_SHANI
+		if (sha2_shani_supported())
+			impl = VXSSH_SHA2_IMPL_SHANI;
+		else
+#endif
+#ifdef SHA2_UNROLL_TRANSFORM
+		impl = VXSSH_SHA2_IMPL_UNROLLED;
+#else
+		impl = VXSSH_SHA2_IMPL_REF;
+#endif
+#endif
+	}
+	switch (impl) {
+	case VXSSH_SHA2_IMPL_REF:
+		SHA256_Transform = SHA256_Transform_ref;
+		break;
+	case VXSSH_SHA2_IMPL_UNROLLED:
+		SHA256_Transform = SHA256_Transform_unrolled;
+		break;
+#ifdef SHA2_HAVE_SHANI
+	case VXSSH_SHA2_IMPL_SHANI:
+		if (!sha2_shani_supported())
+			return ENOTSUP;
+		SHA256_Transform = SHA256_Transform_shani;
+		break;
+#endif
+#ifdef SHA2_HAVE_ARMV8
+	case VXSSH_SHA2_IMPL_ARMV8:
+		SHA256_Transform = SHA256_Transform_armv8;
+		break;
+#endif
+	default:
+		return ENOTSUP;
+	}
+	sha256_impl = impl;
+	return OK;
+}
+
+static void SHA256_Init(SHA256_CTX *context) {
+	if (context == NULL)
+		return;
+	if (SHA256_Transform == NULL)
+		sha256_transform_select(VXSSH_SHA2_IMPL_AUTO);
+	memcpy(context->state, sha256_initial_hash_value, sizeof(sha256_initial_hash_value));
+	memset(context->buffer, 0, sizeof(context->buffer));
+	context->bitcount = 0;
+}
 
 static void SHA256_Update(SHA256_CTX *context, const uint8_t *data, size_t len) {
 	size_t	freespace, usedspace;
@@ -436,6 +653,275 @@ static void SHA256_Final(uint8_t digest[SHA256_DIGEST_LENGTH], SHA256_CTX *conte
 	}
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+// SHA-512 private
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+static void SHA512_Init(SHA512_CTX *context) {
+	if (context == NULL)
+		return;
+	memcpy(context->state, sha512_initial_hash_value, sizeof(sha512_initial_hash_value));
+	memset(context->buffer, 0, sizeof(context->buffer));
+	context->bitcount[0] = context->bitcount[1] =  0;
+}
+
+#ifdef SHA2_UNROLL_TRANSFORM
+
+/* Unrolled SHA-512 round macros: */
+
+#define ROUND512_0_TO_15(a,b,c,d,e,f,g,h) do {				    \
+	BE_8_TO_64(W512[j], data);					    \
+	data += 8;							    \
+	T1 = (h) + Sigma1_512((e)) + Ch((e), (f), (g)) + K512[j] + W512[j]; \
+	(d) += T1;							    \
+	(h) = T1 + Sigma0_512((a)) + Maj((a), (b), (c));		    \
+	j++;								    \
+} while(0)
+
+
+#define ROUND512(a,b,c,d,e,f,g,h) do {					    \
+	s0 = W512[(j+1)&0x0f];						    \
+	s0 = sigma0_512(s0);						    \
+	s1 = W512[(j+14)&0x0f];						    \
+	s1 = sigma1_512(s1);						    \
+	T1 = (h) + Sigma1_512((e)) + Ch((e), (f), (g)) + K512[j] +	    \
+             (W512[j&0x0f] += s1 + W512[(j+9)&0x0f] + s0);		    \
+	(d) += T1;							    \
+	(h) = T1 + Sigma0_512((a)) + Maj((a), (b), (c));		    \
+	j++;								    \
+} while(0)
+
+static void SHA512_Transform(uint64_t state[8], const uint8_t data[SHA512_BLOCK_LENGTH]) {
+	uint64_t	a, b, c, d, e, f, g, h, s0, s1;
+	uint64_t	T1, W512[16];
+	int		j;
+
+	/* Initialize registers with the prev. intermediate value */
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	j = 0;
+	do {
+		/* Rounds 0 to 15 (unrolled): */
+		ROUND512_0_TO_15(a,b,c,d,e,f,g,h);
+		ROUND512_0_TO_15(h,a,b,c,d,e,f,g);
+		ROUND512_0_TO_15(g,h,a,b,c,d,e,f);
+		ROUND512_0_TO_15(f,g,h,a,b,c,d,e);
+		ROUND512_0_TO_15(e,f,g,h,a,b,c,d);
+		ROUND512_0_TO_15(d,e,f,g,h,a,b,c);
+		ROUND512_0_TO_15(c,d,e,f,g,h,a,b);
+		ROUND512_0_TO_15(b,c,d,e,f,g,h,a);
+	} while (j < 16);
+
+	/* Now for the remaining rounds up to 79: */
+	do {
+		ROUND512(a,b,c,d,e,f,g,h);
+		ROUND512(h,a,b,c,d,e,f,g);
+		ROUND512(g,h,a,b,c,d,e,f);
+		ROUND512(f,g,h,a,b,c,d,e);
+		ROUND512(e,f,g,h,a,b,c,d);
+		ROUND512(d,e,f,g,h,a,b,c);
+		ROUND512(c,d,e,f,g,h,a,b);
+		ROUND512(b,c,d,e,f,g,h,a);
+	} while (j < 80);
+
+	/* Compute the current intermediate hash value */
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+
+	/* Clean up */
+	a = b = c = d = e = f = g = h = T1 = 0;
+}
+
+#else /* SHA2_UNROLL_TRANSFORM */
+
+static void SHA512_Transform(uint64_t state[8], const uint8_t data[SHA512_BLOCK_LENGTH]) {
+	uint64_t	a, b, c, d, e, f, g, h, s0, s1;
+	uint64_t	T1, T2, W512[16];
+	int		j;
+
+	/* Initialize registers with the prev. intermediate value */
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
+
+	j = 0;
+	do {
+		BE_8_TO_64(W512[j], data);
+		data += 8;
+		/* Apply the SHA-512 compression function to update a..h */
+		T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] + W512[j];
+		T2 = Sigma0_512(a) + Maj(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+
+		j++;
+	} while (j < 16);
+
+	do {
+		/* Part of the message block expansion: */
+		s0 = W512[(j+1)&0x0f];
+		s0 = sigma0_512(s0);
+		s1 = W512[(j+14)&0x0f];
+		s1 =  sigma1_512(s1);
+
+		/* Apply the SHA-512 compression function to update a..h */
+		T1 = h + Sigma1_512(e) + Ch(e, f, g) + K512[j] +
+		     (W512[j&0x0f] += s1 + W512[(j+9)&0x0f] + s0);
+		T2 = Sigma0_512(a) + Maj(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+
+		j++;
+	} while (j < 80);
+
+	/* Compute the current intermediate hash value */
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+
+	/* Clean up */
+	a = b = c = d = e = f = g = h = T1 = T2 = 0;
+}
+
+#endif /* SHA2_UNROLL_TRANSFORM */
+
+static void SHA512_Update(SHA512_CTX *context, const uint8_t *data, size_t len) {
+	size_t	freespace, usedspace;
+
+	/* Calling with no data is valid (we do nothing) */
+	if (len == 0)
+		return;
+
+	usedspace = (context->bitcount[0] >> 3) % SHA512_BLOCK_LENGTH;
+	if (usedspace > 0) {
+		/* Calculate how much free space is available in the buffer */
+		freespace = SHA512_BLOCK_LENGTH - usedspace;
+
+		if (len >= freespace) {
+			/* Fill the buffer completely and process it */
+			memcpy(&context->buffer[usedspace], data, freespace);
+			ADDINC128(context->bitcount, freespace << 3);
+			len -= freespace;
+			data += freespace;
+			SHA512_Transform(context->state, context->buffer);
+		} else {
+			/* The buffer is not yet full */
+			memcpy(&context->buffer[usedspace], data, len);
+			ADDINC128(context->bitcount, len << 3);
+			/* Clean up: */
+			usedspace = freespace = 0;
+			return;
+		}
+	}
+	while (len >= SHA512_BLOCK_LENGTH) {
+		/* Process as many complete blocks as we can */
+		SHA512_Transform(context->state, data);
+		ADDINC128(context->bitcount, SHA512_BLOCK_LENGTH << 3);
+		len -= SHA512_BLOCK_LENGTH;
+		data += SHA512_BLOCK_LENGTH;
+	}
+	if (len > 0) {
+		/* There's left-overs, so save 'em */
+		memcpy(context->buffer, data, len);
+		ADDINC128(context->bitcount, len << 3);
+	}
+	/* Clean up: */
+	usedspace = freespace = 0;
+}
+
+static void SHA512_Pad(SHA512_CTX *context) {
+	unsigned int	usedspace;
+
+	usedspace = (context->bitcount[0] >> 3) % SHA512_BLOCK_LENGTH;
+	if (usedspace > 0) {
+		/* Begin padding with a 1 bit: */
+		context->buffer[usedspace++] = 0x80;
+
+		if (usedspace <= SHA512_SHORT_BLOCK_LENGTH) {
+			/* Set-up for the last transform: */
+			memset(&context->buffer[usedspace], 0, SHA512_SHORT_BLOCK_LENGTH - usedspace);
+		} else {
+			if (usedspace < SHA512_BLOCK_LENGTH) {
+				memset(&context->buffer[usedspace], 0, SHA512_BLOCK_LENGTH - usedspace);
+			}
+			/* Do second-to-last transform: */
+			SHA512_Transform(context->state, context->buffer);
+
+			/* And set-up for the last transform: */
+			memset(context->buffer, 0, SHA512_BLOCK_LENGTH - 2);
+		}
+	} else {
+		/* Prepare for final transform: */
+		memset(context->buffer, 0, SHA512_SHORT_BLOCK_LENGTH);
+
+		/* Begin padding with a 1 bit: */
+		*context->buffer = 0x80;
+	}
+	/* Store the length of input data (in bits) in big endian format: */
+	BE_64_TO_8(&context->buffer[SHA512_SHORT_BLOCK_LENGTH],
+	    context->bitcount[1]);
+	BE_64_TO_8(&context->buffer[SHA512_SHORT_BLOCK_LENGTH + 8],
+	    context->bitcount[0]);
+
+	/* Final transform: */
+	SHA512_Transform(context->state, context->buffer);
+
+	/* Clean up: */
+	usedspace = 0;
+}
+
+static void SHA512_Final(uint8_t digest[SHA512_DIGEST_LENGTH], SHA512_CTX *context) {
+	SHA512_Pad(context);
+
+	/* If no digest buffer is passed, we don't bother doing this: */
+	if (digest != NULL) {
+#if BYTE_ORDER == LITTLE_ENDIAN
+		int	i;
+
+		/* Convert TO host byte order */
+		for (i = 0; i < 8; i++)
+			BE_64_TO_8(digest + i * 8, context->state[i]);
+#else
+		memcpy(digest, context->state, SHA512_DIGEST_LENGTH);
+#endif
+		memset(context, 0, sizeof(*context));
+	}
+}
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
 // PUBLIC
 // -----------------------------------------------------------------------------------------------------------------------------------------------------
@@ -499,3 +985,110 @@ int vxssh_sha256_digest(const void *input, size_t input_len, uint8_t *digest, si
 
     return OK;
 }
+
+int vxssh_sha256_set_impl(int impl) {
+    return sha256_transform_select(impl);
+}
+
+int vxssh_sha256_get_impl() {
+    if (SHA256_Transform == NULL) {
+        sha256_transform_select(VXSSH_SHA2_IMPL_AUTO);
+    }
+    return sha256_impl;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------------------------
+size_t vxssh_sha512_digest_len() {
+    return SHA512_DIGEST_LENGTH;
+}
+
+size_t vxssh_sha512_block_len() {
+    return SHA512_BLOCK_LENGTH;
+}
+
+size_t vxssh_sha512_ctx_size() {
+    return sizeof(SHA512_CTX);
+}
+
+int vxssh_sha512_init(vxssh_sha512_ctx_t **ctx) {
+    vxssh_sha512_ctx_t *md_ctx = NULL;
+
+    if (!ctx) {
+        return EINVAL;
+    }
+    md_ctx = vxssh_mem_zalloc(sizeof(vxssh_sha512_ctx_t), NULL);
+    if(md_ctx == NULL) {
+        return ENOMEM;
+    }
+    SHA512_Init(md_ctx);
+    *ctx = md_ctx;
+
+    return OK;
+}
+
+int vxssh_sha512_update(vxssh_sha512_ctx_t *ctx, const void *data, size_t data_size) {
+    if (!ctx || !data) {
+        return EINVAL;
+    }
+    SHA512_Update(ctx, data, data_size);
+    return OK;
+}
+
+int vxssh_sha512_final(vxssh_sha512_ctx_t *ctx, uint8_t *digest) {
+    if (!ctx || !digest) {
+        return EINVAL;
+    }
+    SHA512_Final(digest, ctx);
+    return OK;
+}
+
+int vxssh_sha512_digest(const void *input, size_t input_len, uint8_t *digest, size_t digest_len) {
+    SHA512_CTX ctx;
+
+    if (!input || !digest) {
+        return EINVAL;
+    }
+    if(digest_len < SHA512_DIGEST_LENGTH) {
+        return ERANGE;
+    }
+
+    SHA512_Init(&ctx);
+    SHA512_Update(&ctx, input, input_len);
+    SHA512_Final(digest, &ctx);
+
+    return OK;
+}
+
+static void sha256_ops_init(void *ctx) {
+    SHA256_Init((SHA256_CTX *)ctx);
+}
+
+static void sha256_ops_update(void *ctx, const void *data, size_t data_len) {
+    SHA256_Update((SHA256_CTX *)ctx, data, data_len);
+}
+
+static void sha256_ops_final(void *ctx, uint8_t *digest) {
+    SHA256_Final(digest, (SHA256_CTX *)ctx);
+}
+
+const vxssh_digest_ops_t vxssh_sha256_ops = {
+    VXSSH_DIGEST_SHA256, SHA256_DIGEST_LENGTH, SHA256_BLOCK_LENGTH, sizeof(SHA256_CTX),
+    sha256_ops_init, sha256_ops_update, sha256_ops_final
+};
+
+static void sha512_ops_init(void *ctx) {
+    SHA512_Init((SHA512_CTX *)ctx);
+}
+
+static void sha512_ops_update(void *ctx, const void *data, size_t data_len) {
+    SHA512_Update((SHA512_CTX *)ctx, data, data_len);
+}
+
+static void sha512_ops_final(void *ctx, uint8_t *digest) {
+    SHA512_Final(digest, (SHA512_CTX *)ctx);
+}
+
+const vxssh_digest_ops_t vxssh_sha512_ops = {
+    VXSSH_DIGEST_SHA512, SHA512_DIGEST_LENGTH, SHA512_BLOCK_LENGTH, sizeof(SHA512_CTX),
+    sha512_ops_init, sha512_ops_update, sha512_ops_final
+};
@@ -0,0 +1,62 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include <tickLib.h>
+#include "vxssh.h"
+
+typedef struct {
+    int     owner;
+    int     run_ticks;
+    int     slice_ticks;
+    ULONG   slice_start;
+} crypto_budget_t;
+
+static crypto_budget_t budget = { 0, VXSSH_CRYPTO_BUDGET_RUN_TICKS, VXSSH_CRYPTO_BUDGET_SLICE_TICKS, 0 };
+
+// ----------------------------------------------------------------------------------------------
+/**
+ * cpu budget of the long crypto operations (rsa, curve25519):
+ *  run_ticks out of every slice_ticks,
+ *  run_ticks >= slice_ticks - no limit, just give way to tasks of the same priority
+ **/
+int vxssh_crypto_budget_set(int run_ticks, int slice_ticks) {
+    if(run_ticks <= 0 || slice_ticks <= 0) {
+        return EINVAL;
+    }
+    budget.run_ticks = run_ticks;
+    budget.slice_ticks = slice_ticks;
+    return OK;
+}
+
+/**
+ * the calling task becomes the owner of the budget,
+ * yield points of other tasks are ignored
+ **/
+void vxssh_crypto_budget_begin() {
+    budget.owner = taskIdSelf();
+    budget.slice_start = tickGet();
+    mp_set_yield_function(vxssh_crypto_yield, VXSSH_CRYPTO_YIELD_LIMB_OPS);
+}
+
+void vxssh_crypto_budget_end() {
+    if(budget.owner == taskIdSelf()) {
+        budget.owner = 0;
+    }
+}
+
+/**
+ * called from the inner loops (mpz_powm, curve25519 ladder)
+ **/
+void vxssh_crypto_yield() {
+    if(budget.owner == 0 || budget.owner != taskIdSelf()) {
+        return;
+    }
+    if(budget.run_ticks < budget.slice_ticks && (tickGet() - budget.slice_start) >= budget.run_ticks) {
+        taskDelay(budget.slice_ticks - budget.run_ticks);
+        budget.slice_start = tickGet();
+        return;
+    }
+    taskDelay(0);
+}
@@ -6,29 +6,77 @@
 #include "vxssh.h"
 #include "vxssh_crypto.h"
 
+/* indexed by VXSSH_DIGEST_xxx */
+static const vxssh_digest_ops_t *DIGEST_OPS[] = {
+    &vxssh_md5_ops,
+    &vxssh_sha1_ops,
+    &vxssh_sha256_ops,
+    &vxssh_sha512_ops
+};
+#define DIGEST_OPS_COUNT (sizeof(DIGEST_OPS) / sizeof(DIGEST_OPS[0]))
+
 static void destructor_vxssh_digest_ctx_t(void *data) {
     vxssh_digest_ctx_t *md = data;
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
-    switch(md->alg) {
-        case VXSSH_DIGEST_MD5 : {
-            vxssh_md5_ctx_t *mdctx = (vxssh_md5_ctx_t *)md->ctx;
-            if(mdctx) explicit_bzero(mdctx, vxssh_md5_ctx_size());
-            break;
-        }
-        case VXSSH_DIGEST_SHA1 : {
-            vxssh_sha1_ctx_t *mdctx = (vxssh_sha1_ctx_t *)md->ctx;
-            if(mdctx) explicit_bzero(mdctx, vxssh_sha1_ctx_size());
-            break;
-        }
-        case VXSSH_DIGEST_SHA256 : {
-            vxssh_sha256_ctx_t *mdctx = (vxssh_sha256_ctx_t *)md->ctx;
-            if(mdctx) explicit_bzero(mdctx, vxssh_sha256_ctx_size());
-            break;
-        }
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
+    if(md->ops) {
+        explicit_bzero(md->state, md->ops->ctx_size);
     }
 #endif
-    vxssh_mem_deref(md->ctx);
+}
+
+/**
+ * Lookup the algorithm implementation
+ **/
+const vxssh_digest_ops_t *vxssh_digest_get_ops(int alg) {
+    if(alg < 0 || alg >= DIGEST_OPS_COUNT) {
+        return NULL;
+    }
+    return DIGEST_OPS[alg];
+}
+
+/**
+ * Bytes needed for a context with the inline state
+ **/
+size_t vxssh_digest_ctx_size(int alg) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(alg);
+
+    return (ops ? sizeof(vxssh_digest_ctx_t) + ops->ctx_size : 0);
+}
+
+/**
+ * Initialize a context in caller provided memory
+ * (at least vxssh_digest_ctx_size() bytes, 8-bytes aligned)
+ **/
+int vxssh_digest_setup(vxssh_digest_ctx_t *ctx, int alg) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(alg);
+
+    if(!ctx) {
+        return EINVAL;
+    }
+    if(!ops) {
+        vxssh_log_warn("unknown digest: %i", alg);
+        return EINVAL;
+    }
+
+    ctx->ops = ops;
+    ctx->alg = alg;
+    ctx->digest_len = ops->digest_len;
+    ctx->block_length = ops->block_len;
+    ops->init(ctx->state);
+
+    return OK;
+}
+
+/**
+ *
+ **/
+int vxssh_digest_reset(vxssh_digest_ctx_t *ctx) {
+    if(!ctx || !ctx->ops) {
+        return EINVAL;
+    }
+    ctx->ops->init(ctx->state);
+    return OK;
 }
 
 /**
@@ -37,46 +85,24 @@ static void destructor_vxssh_digest_ctx_t(void *data) {
 int vxssh_digest_alloc(vxssh_digest_ctx_t **ctx, int alg) {
     int err = OK;
     vxssh_digest_ctx_t *tctx = NULL;
+    size_t sz = vxssh_digest_ctx_size(alg);
 
     if(!ctx) {
         return EINVAL;
     }
+    if(!sz) {
+        vxssh_log_warn("unknown digest: %i", alg);
+        return EINVAL;
+    }
 
-    tctx = vxssh_mem_alloc(sizeof(vxssh_digest_ctx_t), destructor_vxssh_digest_ctx_t);
+    tctx = vxssh_mem_alloc(sz, destructor_vxssh_digest_ctx_t);
     if(tctx == NULL) {
         err = ENOMEM;
         goto out;
     }
-    tctx->alg = alg;
-    switch(tctx->alg) {
-        case VXSSH_DIGEST_MD5 : {
-            tctx->digest_len = vxssh_md5_digest_len();
-            tctx->block_length = vxssh_md5_block_len();
-            if((err = vxssh_md5_init((void *)&tctx->ctx)) != OK) {
-                goto out;
-            }
-            break;
-        }
-        case VXSSH_DIGEST_SHA1 : {
-            tctx->digest_len = vxssh_sha1_digest_len();
-            tctx->block_length = vxssh_sha1_block_len();
-            if((err = vxssh_sha1_init((void *)&tctx->ctx)) != OK) {
-                goto out;
-            }
-            break;
-        }
-        case VXSSH_DIGEST_SHA256 : {
-            tctx->digest_len = vxssh_sha256_digest_len();
-            tctx->block_length = vxssh_sha256_block_len();
-            if((err = vxssh_sha256_init((void *)&tctx->ctx)) != OK) {
-                goto out;
-            }
-            break;
-        }
-        default:
-            vxssh_log_warn("unknown digest: %i", alg);
-            err = EINVAL;
-            goto out;
+    if((err = vxssh_digest_setup(tctx, alg)) != OK) {
+        tctx->ops = NULL;
+        goto out;
     }
     *ctx = tctx;
 out:
@@ -90,167 +116,77 @@ out:
  *
  **/
 int vxssh_digest_update(vxssh_digest_ctx_t *ctx, void *data, size_t data_len) {
-    int err = OK;
-
     if(!ctx || !data) {
         return EINVAL;
     }
-    switch(ctx->alg) {
-        case VXSSH_DIGEST_MD5 : {
-            vxssh_md5_ctx_t *mdctx = (vxssh_md5_ctx_t *)ctx->ctx;
-            err = vxssh_md5_update(mdctx, data, data_len);
-            break;
-        }
-        case VXSSH_DIGEST_SHA1 : {
-            vxssh_sha1_ctx_t *mdctx = (vxssh_sha1_ctx_t *)ctx->ctx;
-            err = vxssh_sha1_update(mdctx, data, data_len);
-            break;
-        }
-        case VXSSH_DIGEST_SHA256 : {
-            vxssh_sha256_ctx_t *mdctx = (vxssh_sha256_ctx_t *)ctx->ctx;
-            err = vxssh_sha256_update(mdctx, data, data_len);
-            break;
-        }
-        default:
-            err = EINVAL;
-    }
-    return err;
+    ctx->ops->update(ctx->state, data, data_len);
+    return OK;
 }
 
 /**
  *
  **/
 int vxssh_digest_final(vxssh_digest_ctx_t *ctx, uint8_t *digest, size_t digest_len) {
-    int err = OK;
-
     if(!ctx || !digest) {
         return EINVAL;
     }
     if(digest_len < ctx->digest_len) {
         return ERANGE;
     }
-    switch(ctx->alg) {
-        case VXSSH_DIGEST_MD5 : {
-            vxssh_md5_ctx_t *mdctx = (vxssh_md5_ctx_t *)ctx->ctx;
-            err = vxssh_md5_final(mdctx, digest);
-            break;
-        }
-        case VXSSH_DIGEST_SHA1 : {
-            vxssh_sha1_ctx_t *mdctx = (vxssh_sha1_ctx_t *)ctx->ctx;
-            err = vxssh_sha1_final(mdctx, digest);
-            break;
-        }
-        case VXSSH_DIGEST_SHA256 : {
-            vxssh_sha256_ctx_t *mdctx = (vxssh_sha256_ctx_t *)ctx->ctx;
-            err = vxssh_sha256_final(mdctx, digest);
-            break;
-        }
-        default:
-            err = EINVAL;
-    }
-    return err;
+    ctx->ops->final(ctx->state, digest);
+    return OK;
 }
 
 /**
  *
  **/
 int vxssh_digest_copy_state(vxssh_digest_ctx_t *from, vxssh_digest_ctx_t *to) {
-    int err = OK;
-
-    if(!from || !to || from->alg != to->alg) {
+    if(!from || !to || from->ops != to->ops) {
         return EINVAL;
     }
-
-    switch(from->alg) {
-        case VXSSH_DIGEST_MD5 : {
-            vxssh_md5_ctx_t *sctx = (vxssh_md5_ctx_t *)from->ctx;
-            vxssh_md5_ctx_t *dctx = (vxssh_md5_ctx_t *)to->ctx;
-            size_t sz  = vxssh_md5_ctx_size();
-            explicit_bzero(dctx, sz);
-            memcpy(dctx, sctx, sz);
-            break;
-        }
-        case VXSSH_DIGEST_SHA1 : {
-            vxssh_sha1_ctx_t *sctx = (vxssh_sha1_ctx_t *)from->ctx;
-            vxssh_sha1_ctx_t *dctx = (vxssh_sha1_ctx_t *)to->ctx;
-            size_t sz  = vxssh_sha1_ctx_size();
-            explicit_bzero(dctx, sz);
-            memcpy(dctx, sctx, sz);
-            break;
-        }
-        case VXSSH_DIGEST_SHA256 : {
-            vxssh_sha256_ctx_t *sctx = (vxssh_sha256_ctx_t *)from->ctx;
-            vxssh_sha256_ctx_t *dctx = (vxssh_sha256_ctx_t *)to->ctx;
-            size_t sz  = vxssh_sha256_ctx_size();
-            explicit_bzero(dctx, sz);
-            memcpy(dctx, sctx, sz);
-            break;
-        }
-        default:
-            err = EINVAL;
-    }
-
-    return err;
+    memcpy(to->state, from->state, from->ops->ctx_size);
+    return OK;
 }
 
 /**
  *
  **/
 size_t vxssh_digest_bytes(int alg) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(alg);
 
-    switch(alg) {
-        case VXSSH_DIGEST_MD5 :
-            return vxssh_md5_digest_len();
-
-        case VXSSH_DIGEST_SHA1 :
-            return vxssh_sha1_digest_len();
-
-        case VXSSH_DIGEST_SHA256 :
-            return vxssh_sha256_digest_len();
-    }
-
-    return 0;
+    return (ops ? ops->digest_len : 0);
 }
 
 /**
  *
  **/
 size_t vxssh_digest_block_size(int alg) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(alg);
 
-    switch(alg) {
-        case VXSSH_DIGEST_MD5 :
-            return vxssh_md5_block_len();
-
-        case VXSSH_DIGEST_SHA1 :
-            return vxssh_sha1_block_len();
-
-        case VXSSH_DIGEST_SHA256 :
-            return vxssh_sha256_block_len();
-    }
-
-    return 0;
+    return (ops ? ops->block_len : 0);
 }
 
 /**
  *
  **/
-
 int vxssh_digest_memory(int alg, const void *m, size_t mlen, u_char *d, size_t dlen) {
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(alg);
+    uint64_t state[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
 
     if(!m || !d) {
         return EINVAL;
     }
-
-    switch(alg) {
-        case VXSSH_DIGEST_MD5 :
-            return vxssh_md5_digest(m, mlen, d, dlen);
-
-        case VXSSH_DIGEST_SHA1 :
-            return vxssh_sha1_digest(m, mlen, d, dlen);
-
-        case VXSSH_DIGEST_SHA256 :
-            return vxssh_sha256_digest(m, mlen, d, dlen);
+    if(!ops || ops->ctx_size > sizeof(state)) {
+        return ERROR;
     }
+    if(dlen < ops->digest_len) {
+        return ERANGE;
+    }
+
+    ops->init(state);
+    ops->update(state, m, mlen);
+    ops->final(state, d);
+    explicit_bzero(state, ops->ctx_size);
 
-    return ERROR;
+    return OK;
 }
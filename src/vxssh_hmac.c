@@ -5,18 +5,17 @@
  **/
 #include "vxssh.h"
 
+#define HMAC_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
 static void mem_destructor_vxssh_hmac_ctx_t(void *data) {
     vxssh_hmac_ctx_t *hmac = data;
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
+    /* digests and the buffer live in the same allocation */
     if(hmac->buf) {
-        explicit_bzero(hmac->buf, hmac->buf_len);
+        explicit_bzero(hmac->ictx, (hmac->buf + hmac->buf_len) - (uint8_t *)hmac->ictx);
     }
 #endif
-    vxssh_mem_deref(hmac->buf);
-    vxssh_mem_deref(hmac->ictx);
-    vxssh_mem_deref(hmac->octx);
-    vxssh_mem_deref(hmac->digest);
 }
 
 /**
@@ -25,33 +24,44 @@ static void mem_destructor_vxssh_hmac_ctx_t(void *data) {
 int vxssh_hmac_alloc(vxssh_hmac_ctx_t **ctx, int alg) {
     int err = OK;
     vxssh_hmac_ctx_t *hmac = NULL;
+    size_t hsz, dsz, bsz;
+    uint8_t *p;
 
     if(!ctx) {
         return EINVAL;
     }
 
-    if((hmac = vxssh_mem_zalloc(sizeof(vxssh_hmac_ctx_t), mem_destructor_vxssh_hmac_ctx_t)) == NULL) {
+    hsz = HMAC_ALIGN(sizeof(vxssh_hmac_ctx_t));
+    dsz = HMAC_ALIGN(vxssh_digest_ctx_size(alg));
+    bsz = vxssh_digest_block_size(alg);
+    if(!dsz || !bsz) {
+        return EINVAL;
+    }
+
+    /* one allocation: [hmac][ictx][octx][digest][buf] */
+    if((hmac = vxssh_mem_zalloc(hsz + (dsz * 3) + bsz, mem_destructor_vxssh_hmac_ctx_t)) == NULL) {
         err = ENOMEM;
         goto out;
     }
+    p = (uint8_t *)hmac + hsz;
+
+    hmac->ictx = (vxssh_digest_ctx_t *) p;
+    hmac->octx = (vxssh_digest_ctx_t *) (p + dsz);
+    hmac->digest = (vxssh_digest_ctx_t *) (p + (dsz * 2));
 
-    if((err = vxssh_digest_alloc(&hmac->ictx, alg)) != OK) {
+    if((err = vxssh_digest_setup(hmac->ictx, alg)) != OK) {
         goto out;
     }
-    if((err = vxssh_digest_alloc(&hmac->octx, alg)) != OK) {
+    if((err = vxssh_digest_setup(hmac->octx, alg)) != OK) {
         goto out;
     }
-    if((err = vxssh_digest_alloc(&hmac->digest, alg)) != OK) {
+    if((err = vxssh_digest_setup(hmac->digest, alg)) != OK) {
         goto out;
     }
 
     hmac->alg = alg;
-    hmac->buf_len = hmac->ictx->block_length;
-
-    if((hmac->buf = vxssh_mem_zalloc(hmac->buf_len, NULL)) == NULL) {
-        err = ENOMEM;
-        goto out;
-    }
+    hmac->buf = p + (dsz * 3);
+    hmac->buf_len = bsz;
 
     *ctx = hmac;
 
@@ -74,6 +84,10 @@ int vxssh_hmac_init(vxssh_hmac_ctx_t *ctx, void *key, size_t klen) {
     }
     /* reset ictx and octx if no is key given */
     if (key != NULL) {
+        vxssh_digest_reset(ctx->ictx);
+        vxssh_digest_reset(ctx->octx);
+        explicit_bzero(ctx->buf, ctx->buf_len);
+
         if (klen <= ctx->buf_len) {
             memcpy(ctx->buf, key, klen);
         } else {
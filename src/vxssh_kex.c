@@ -5,8 +5,6 @@
  **/
 #include "vxssh.h"
 
-#define ROUNDUP(x, y)   ((((x)+((y)-1))/(y))*(y))
-
 static void mem_destructor_vxssh_kex_t(void *data) {
     vxssh_kex_t *kex = data;
 
@@ -23,88 +21,58 @@ static void mem_destructor_vxssh_kex_t(void *data) {
     vxssh_mem_deref(kex->keys_in.mac);
     vxssh_mem_deref(kex->keys_out.enc);
     vxssh_mem_deref(kex->keys_out.mac);
+    vxssh_mem_deref(kex->next_in.enc);
+    vxssh_mem_deref(kex->next_in.mac);
+    vxssh_mem_deref(kex->next_out.enc);
+    vxssh_mem_deref(kex->next_out.mac);
 }
 
-static int derive_key(vxssh_kex_t *kex, int id, size_t need, uint8_t *hash, size_t hashlen, uint8_t *shared_secret, size_t shared_secret_len, uint8_t **keyp) {
-    vxssh_digest_ctx_t *hashctx = NULL;
-    uint8_t *digest = NULL;
-    int err = OK;
-    char c = id;
-    uint32_t have;
-    size_t mdsz;
-    int r;
-
-    if(!kex) {
-        return EINVAL;
-    }
-
-    if((mdsz = vxssh_digest_bytes(kex->hash_alg)) == 0) {
-        return EINVAL;
-    }
-
-    if((digest = vxssh_mem_alloc(ROUNDUP(need, mdsz), NULL)) == NULL) {
-        return ENOMEM;
-    }
-
-    /* K1 = HASH(K || H || "A" || session_id) */
-    if((err = vxssh_digest_alloc(&hashctx, kex->hash_alg)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_digest_update(hashctx, shared_secret, shared_secret_len)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_digest_update(hashctx, hash, hashlen)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_digest_update(hashctx, &c, 1)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_digest_update(hashctx, kex->session_id, kex->session_id_len)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_digest_final(hashctx, digest, mdsz)) != OK) {
-        goto out;
-    }
-    vxssh_mem_deref(hashctx);
-
-    /* expand key:
-     * Kn = HASH(K || H || K1 || K2 || ... || Kn-1)
-     * Key = K1 || K2 || ... || Kn
-     */
-    for (have = mdsz; need > have; have += mdsz) {
-        if((err = vxssh_digest_alloc(&hashctx, kex->hash_alg)) != OK) {
-            goto out;
-        }
-        if((err = vxssh_digest_update(hashctx, shared_secret, shared_secret_len)) != OK) {
-            goto out;
-        }
-        if((err = vxssh_digest_update(hashctx, hash, hashlen)) != OK) {
-            goto out;
-        }
-        if((err = vxssh_digest_update(hashctx, digest, have)) != OK) {
-            goto out;
-        }
-        if((err = vxssh_digest_final(hashctx, digest + have, mdsz)) != OK) {
-            goto out;
+/**
+ * K1 = HASH(K || H || X || session_id)
+ * Kn = HASH(K || H || K1 || K2 || ... || Kn-1)
+ * Key = K1 || K2 || ... || Kn, truncated to out_len
+ *
+ * midstate - the context after K || H, it's not modified
+ **/
+static int derive_key(vxssh_kex_t *kex, const vxssh_digest_ops_t *ops, const uint64_t *midstate, char id, uint8_t *out, size_t out_len) {
+    uint64_t run[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
+    uint64_t tmp[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
+    uint8_t digest[VXSSH_DIGEST_LENGTH_MAX];
+    size_t n;
+
+    /* K1 */
+    memcpy(run, midstate, ops->ctx_size);
+    memcpy(tmp, midstate, ops->ctx_size);
+    ops->update(tmp, &id, 1);
+    ops->update(tmp, kex->session_id, kex->session_id_len);
+    ops->final(tmp, digest);
+
+    while(true) {
+        n = (out_len < ops->digest_len ? out_len : ops->digest_len);
+        memcpy(out, digest, n);
+        out += n;
+        out_len -= n;
+        if(out_len == 0) {
+            break;
         }
-        vxssh_mem_deref(hashctx);
+        /* the running state keeps K || H || K1 || ... || Kn-1 */
+        ops->update(run, digest, ops->digest_len);
+        memcpy(tmp, run, ops->ctx_size);
+        ops->final(tmp, digest);
     }
 
-    *keyp = digest;
-
-out:
-    if(err != OK) {
-        vxssh_mem_deref(digest);
-    }
-    vxssh_mem_deref(hashctx);
-    return err;
+    explicit_bzero(run, ops->ctx_size);
+    explicit_bzero(tmp, ops->ctx_size);
+    explicit_bzero(digest, sizeof(digest));
+    return OK;
 }
 
 // ----------------------------------------------------------------------------------------------------------------------------------------
 // public api
 // ----------------------------------------------------------------------------------------------------------------------------------------
 /**
- * free old  data and allocate new
+ * allocate the contexts for the next keys,
+ * the active ones are kept until NEWKEYS
  **/
 int vxssh_kex_newkeys_realloc(vxssh_kex_t *kex) {
     int err = OK;
@@ -114,35 +82,35 @@ int vxssh_kex_newkeys_realloc(vxssh_kex_t *kex) {
     }
 
     /* IN ----------------------------------------------------- */
-    if(kex->keys_in.mac) {
-        vxssh_mem_deref(kex->keys_in.mac);
+    if(kex->next_in.mac) {
+        vxssh_mem_deref(kex->next_in.mac);
     }
-    if((err = vxssh_mac_alloc(&kex->keys_in.mac, kex->mac_algorithm)) != OK) {
+    if((err = vxssh_mac_alloc(&kex->next_in.mac, kex->mac_algorithm)) != OK) {
         vxssh_log_warn("newkeys: mac-in alloc fail (%i)", err);
         goto out;
     }
 
-    if(kex->keys_in.enc) {
-        vxssh_mem_deref(kex->keys_in.enc);
+    if(kex->next_in.enc) {
+        vxssh_mem_deref(kex->next_in.enc);
     }
-    if((err = vxssh_cipher_alloc(&kex->keys_in.enc, kex->cipher_algorithm, true)) != OK) {
+    if((err = vxssh_cipher_alloc(&kex->next_in.enc, kex->cipher_algorithm, true)) != OK) {
         vxssh_log_warn("newkeys: enc-in alloc (%i)", err);
         goto out;
     }
 
     /* OUT --------------------------------------------------- */
-    if(kex->keys_out.mac) {
-        vxssh_mem_deref(kex->keys_out.mac);
+    if(kex->next_out.mac) {
+        vxssh_mem_deref(kex->next_out.mac);
     }
-    if((err = vxssh_mac_alloc(&kex->keys_out.mac, kex->mac_algorithm)) != OK) {
+    if((err = vxssh_mac_alloc(&kex->next_out.mac, kex->mac_algorithm)) != OK) {
         vxssh_log_warn("newkeys: mac-out alloc fail (%i)", err);
         goto out;
     }
 
-    if(kex->keys_out.enc) {
-        vxssh_mem_deref(kex->keys_out.enc);
+    if(kex->next_out.enc) {
+        vxssh_mem_deref(kex->next_out.enc);
     }
-    if((err = vxssh_cipher_alloc(&kex->keys_out.enc, kex->cipher_algorithm, false)) != OK) {
+    if((err = vxssh_cipher_alloc(&kex->next_out.enc, kex->cipher_algorithm, false)) != OK) {
         vxssh_log_warn("newkeys: enc-out alloc fail (%i)", err);
         goto out;
     }
@@ -152,7 +120,7 @@ out:
 }
 
 /**
- * int mac/chipher context
+ * init the next mac/chipher contexts (after derivation)
  **/
 int vxssh_kex_newkeys_init(vxssh_kex_t *kex) {
     int err = OK;
@@ -161,60 +129,60 @@ int vxssh_kex_newkeys_init(vxssh_kex_t *kex) {
         return EINVAL;
     }
 
-    if(kex->keys_in.mac == NULL || kex->keys_in.enc == NULL || !kex->keys_in.enc->block_len) {
-        vxssh_log_warn("newkeys: keys_in not initialized");
+    if(kex->next_in.mac == NULL || kex->next_in.enc == NULL || !kex->next_in.enc->block_len) {
+        vxssh_log_warn("newkeys: next_in not initialized");
         err = EINVAL; goto out;
     }
-    if(kex->keys_out.mac == NULL || kex->keys_out.enc == NULL || !kex->keys_out.enc->block_len) {
-        vxssh_log_warn("newkeys: keys_out not initialized");
+    if(kex->next_out.mac == NULL || kex->next_out.enc == NULL || !kex->next_out.enc->block_len) {
+        vxssh_log_warn("newkeys: next_out not initialized");
         err = EINVAL; goto out;
     }
 
     /* IN ----------------------------------------------------- */
-    if((err = vxssh_mac_init(kex->keys_in.mac)) != OK) {
+    if((err = vxssh_mac_init(kex->next_in.mac)) != OK) {
         vxssh_log_warn("newkeys: mac_init(#1) fail (%i)", err);
         goto out;
     }
-    if((err = vxssh_cipher_init(kex->keys_in.enc)) != OK) {
+    if((err = vxssh_cipher_init(kex->next_in.enc)) != OK) {
         vxssh_log_warn("newkeys: cipher_init(#1) fail (%i)", err);
         goto out;
     }
 
     /* OUT --------------------------------------------------- */
-    if((err = vxssh_mac_init(kex->keys_out.mac)) != OK) {
+    if((err = vxssh_mac_init(kex->next_out.mac)) != OK) {
         vxssh_log_warn("newkeys: mac_init(#2) fail (%i)", err);
         goto out;
     }
-    if((err = vxssh_cipher_init(kex->keys_out.enc)) != OK) {
+    if((err = vxssh_cipher_init(kex->next_out.enc)) != OK) {
         vxssh_log_warn("newkeys: cipher_init(#2) fail (%i)", err);
         goto out;
     }
 
 #ifdef VXSSH_DEBUG_KEX_KEYS
-    if(kex->keys_in->mac) {
-       vxssh_log_debug("C2S mac.cfg...: mac_len=%i, key_len=%i, emt=%i", kex->keys_in.mac->mac_len, kex->keys_in.mac->key_len, kex->keys_in.mac->etm);
-        vxssh_hexdump2("C2S data......: ", kex->keys_in.mac->key, kex->keys_in.mac->key_len);
+    if(kex->next_in.mac) {
+       vxssh_log_debug("C2S mac.cfg...: mac_len=%i, key_len=%i, emt=%i", kex->next_in.mac->mac_len, kex->next_in.mac->key_len, kex->next_in.mac->etm);
+        vxssh_hexdump2("C2S data......: ", kex->next_in.mac->key, kex->next_in.mac->key_len);
     } else {
        vxssh_log_debug("C2S mac.......: not initialized!");
     }
-    if(kex->keys_in->enc) {
-       vxssh_log_debug("C2S enc.cfg...: iv_len=%i, key_len=%i, block_len=%i", kex->keys_in.enc->iv_len, kex->keys_in.enc->key_len, kex->keys_in.enc->block_len);
-        vxssh_hexdump2("C2S enc.iv....: ", kex->keys_in.enc->iv, kex->keys_in.enc->iv_len);
-        vxssh_hexdump2("C2S enc.key...: ", kex->keys_in.enc->key, kex->keys_in.enc->key_len);
+    if(kex->next_in.enc) {
+       vxssh_log_debug("C2S enc.cfg...: iv_len=%i, key_len=%i, block_len=%i", kex->next_in.enc->iv_len, kex->next_in.enc->key_len, kex->next_in.enc->block_len);
+        vxssh_hexdump2("C2S enc.iv....: ", kex->next_in.enc->iv, kex->next_in.enc->iv_len);
+        vxssh_hexdump2("C2S enc.key...: ", kex->next_in.enc->key, kex->next_in.enc->key_len);
     } else {
        vxssh_log_debug("C2S enc.......: not initialized!");
     }
     // ----------------------------------------------------------
-    if(kex->keys_out->mac) {
-       vxssh_log_debug("C2S mac.cfg...: mac_len=%i, key_len=%i, emt=%i", kex->keys_out.mac->mac_len, kex->keys_out.mac->key_len, kex->keys_out.mac->etm);
-        vxssh_hexdump2("C2S data......: ", kex->keys_out.mac->key, kex->keys_out.mac->key_len);
+    if(kex->next_out.mac) {
+       vxssh_log_debug("C2S mac.cfg...: mac_len=%i, key_len=%i, emt=%i", kex->next_out.mac->mac_len, kex->next_out.mac->key_len, kex->next_out.mac->etm);
+        vxssh_hexdump2("C2S data......: ", kex->next_out.mac->key, kex->next_out.mac->key_len);
     } else {
        vxssh_log_debug("C2S mac.......: not initialized!");
     }
-    if(kex->keys_out->enc) {
-       vxssh_log_debug("C2S enc.cfg...: iv_len=%i, key_len=%i, block_len=%i", kex->keys_out.enc->iv_len, kex->keys_out.enc->key_len, kex->keys_out.enc->block_len);
-        vxssh_hexdump2("C2S enc.iv....: ", kex->keys_out.enc->iv, kex->keys_out.enc->iv_len);
-        vxssh_hexdump2("C2S enc.key...: ", kex->keys_out.enc->key, kex->keys_out.enc->key_len);
+    if(kex->next_out.enc) {
+       vxssh_log_debug("C2S enc.cfg...: iv_len=%i, key_len=%i, block_len=%i", kex->next_out.enc->iv_len, kex->next_out.enc->key_len, kex->next_out.enc->block_len);
+        vxssh_hexdump2("C2S enc.iv....: ", kex->next_out.enc->iv, kex->next_out.enc->iv_len);
+        vxssh_hexdump2("C2S enc.key...: ", kex->next_out.enc->key, kex->next_out.enc->key_len);
     } else {
        vxssh_log_debug("C2S enc.......: not initialized!");
     }
@@ -224,6 +192,37 @@ out:
     return err;
 }
 
+/**
+ * NEWKEYS: the next keys of one direction become active,
+ * the old ones are released, the other direction isn't touched
+ **/
+int vxssh_kex_newkeys_activate(vxssh_kex_t *kex, bool out) {
+    vxssh_kex_newkeys_t *keys = NULL;
+    vxssh_kex_newkeys_t *next = NULL;
+
+    if(!kex) {
+        return EINVAL;
+    }
+
+    keys = (out ? &kex->keys_out : &kex->keys_in);
+    next = (out ? &kex->next_out : &kex->next_in);
+
+    if(next->enc == NULL || next->mac == NULL) {
+        vxssh_log_warn("newkeys: %s keys not ready", (out ? "s2c" : "c2s"));
+        return EINVAL;
+    }
+
+    vxssh_mem_deref(keys->enc);
+    vxssh_mem_deref(keys->mac);
+
+    keys->enc = next->enc;
+    keys->mac = next->mac;
+    next->enc = NULL;
+    next->mac = NULL;
+
+    return OK;
+}
+
 /**
  *
  **/
@@ -246,33 +245,37 @@ int vxssh_kex_alloc(vxssh_kex_t **kex) {
  *
  **/
 int vxssh_kex_derive_keys(vxssh_kex_t *kex, uint8_t *hash, size_t hashlen, uint8_t *shared_secret, size_t shared_secret_len) {
-    int i, err = OK;
+    const vxssh_digest_ops_t *ops = NULL;
+    uint64_t midstate[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
+    int err = OK;
 
-    if(kex->keys_in.enc == NULL || kex->keys_in.mac == NULL) {
-        vxssh_log_warn("derive_keys: keys_in not initialized");
+    if(kex->next_in.enc == NULL || kex->next_in.mac == NULL) {
+        vxssh_log_warn("derive_keys: next_in not initialized");
         return EINVAL;
     }
-    if(kex->keys_out.enc == NULL || kex->keys_out.mac == NULL) {
-        vxssh_log_warn("derive_keys: keys_out not");
+    if(kex->next_out.enc == NULL || kex->next_out.mac == NULL) {
+        vxssh_log_warn("derive_keys: next_out not initialized");
         return EINVAL;
     }
-
-    for (i = 0; i < 6; i++) {
-        uint8_t *key = NULL;
-        if((err = derive_key(kex, 'A' + i, kex->we_need, hash, hashlen, shared_secret, shared_secret_len, &key)) != OK) {
-            vxssh_mem_deref(key);
-            break;
-        }
-        /* C2S */
-        if(i == 0) kex->keys_in.enc->iv = key;
-        if(i == 2) kex->keys_in.enc->key = key;
-        if(i == 4) kex->keys_in.mac->key = key;
-        /* S2C */
-        if(i == 1) kex->keys_out.enc->iv = key;
-        if(i == 3) kex->keys_out.enc->key = key;
-        if(i == 5) kex->keys_out.mac->key = key;
+    if((ops = vxssh_digest_get_ops(kex->hash_alg)) == NULL || ops->ctx_size > sizeof(midstate)) {
+        return EINVAL;
     }
 
+    /* K || H is common for all the keys */
+    ops->init(midstate);
+    ops->update(midstate, shared_secret, shared_secret_len);
+    ops->update(midstate, hash, hashlen);
+
+    /* C2S */
+    derive_key(kex, ops, midstate, 'A', kex->next_in.enc->iv, kex->next_in.enc->iv_len);
+    derive_key(kex, ops, midstate, 'C', kex->next_in.enc->key, kex->next_in.enc->key_len);
+    derive_key(kex, ops, midstate, 'E', kex->next_in.mac->key, kex->next_in.mac->key_len);
+    /* S2C */
+    derive_key(kex, ops, midstate, 'B', kex->next_out.enc->iv, kex->next_out.enc->iv_len);
+    derive_key(kex, ops, midstate, 'D', kex->next_out.enc->key, kex->next_out.enc->key_len);
+    derive_key(kex, ops, midstate, 'F', kex->next_out.mac->key, kex->next_out.mac->key_len);
+
+    explicit_bzero(midstate, ops->ctx_size);
     return err;
 }
 
@@ -6,15 +6,149 @@
  **/
 #include "vxssh.h"
 
+typedef struct {
+    uint8_t     key[CRYPTO_CURVE25519_SIZE];
+    uint8_t     pub[CRYPTO_CURVE25519_SIZE];
+    bool        fl_ready;
+} kex_c25519_keypair_t;
+
+typedef struct {
+    SEM_ID                  sem;
+    SEM_ID                  wakeup;
+    int                     tid;
+    int                     ready;
+    bool                    fl_running;
+    bool                    fl_do_stop;
+    kex_c25519_keypair_t    pairs[VXSSH_KEX_C25519_POOL_SIZE];
+} kex_c25519_pool_t;
+
+static kex_c25519_pool_t pool;
+
+/**
+ * runs at a low priority and refills free slots
+ * each slot is handed out once and wiped after that.
+ * The stack is the session one: the same scalar multiplication runs there without the pool
+ **/
+static int kex_c25519_pool_task() {
+    uint8_t key[CRYPTO_CURVE25519_SIZE];
+    uint8_t pub[CRYPTO_CURVE25519_SIZE];
+    int i;
+
+    while(!pool.fl_do_stop) {
+        if(pool.ready >= VXSSH_KEX_C25519_POOL_SIZE) {
+            semTake(pool.wakeup, WAIT_FOREVER);
+            continue;
+        }
+        vxssh_rnd_bin((char *)key, sizeof(key));
+        vxssh_scalarmult_curve25519_base(pub, key);
+
+        semTake(pool.sem, WAIT_FOREVER);
+        for(i = 0; i < VXSSH_KEX_C25519_POOL_SIZE; i++) {
+            if(!pool.pairs[i].fl_ready) {
+                memcpy(pool.pairs[i].key, key, sizeof(key));
+                memcpy(pool.pairs[i].pub, pub, sizeof(pub));
+                pool.pairs[i].fl_ready = true;
+                pool.ready++;
+                break;
+            }
+        }
+        /* the slot is the only copy now (or there was no free one), don't leave it on the stack while waiting */
+        explicit_bzero(key, sizeof(key));
+        semGive(pool.sem);
+    }
+
+    explicit_bzero(key, sizeof(key));
+    pool.fl_running = false;
+    return OK;
+}
+
+/**
+ * start the background keypair generator
+ **/
+int vxssh_kex_c25519_pool_start() {
+    if(pool.fl_running) {
+        return OK;
+    }
+    explicit_bzero(&pool, sizeof(pool));
+
+    if((pool.sem = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE)) == NULL) {
+        goto err;
+    }
+    if((pool.wakeup = semBCreate(SEM_Q_FIFO, SEM_EMPTY)) == NULL) {
+        goto err;
+    }
+    pool.fl_running = true;
+    if((pool.tid = taskSpawn("sshd_kpool", VXSSH_KEX_C25519_POOL_PRIORITY, 0, VXSSH_SESSION_STACK_SIZE, (FUNCPTR) kex_c25519_pool_task, 0,0,0,0,0,0,0,0,0,0)) == ERROR) {
+        pool.fl_running = false;
+        goto err;
+    }
+    return OK;
+err:
+    if(pool.sem) {
+        semDelete(pool.sem);
+    }
+    if(pool.wakeup) {
+        semDelete(pool.wakeup);
+    }
+    pool.sem = pool.wakeup = NULL;
+    return ERROR;
+}
+
+/**
+ * stop the generator and wipe the unused keys
+ **/
+void vxssh_kex_c25519_pool_stop() {
+    if(!pool.sem) {
+        return;
+    }
+    pool.fl_do_stop = true;
+    semGive(pool.wakeup);
+    while(pool.fl_running && taskIdVerify(pool.tid) == OK) {
+        taskDelay(1);
+    }
+    semDelete(pool.sem);
+    semDelete(pool.wakeup);
+    explicit_bzero(&pool, sizeof(pool));
+}
+
+/**
+ * take a pre-generated keypair
+ * returns ENOENT if the pool is empty or not running
+ **/
+int vxssh_kex_c25519_pool_take(uint8_t key[CRYPTO_CURVE25519_SIZE], uint8_t pub[CRYPTO_CURVE25519_SIZE]) {
+    int i, err = ENOENT;
+
+    if(!pool.sem || pool.ready == 0) {
+        return ENOENT;
+    }
+
+    semTake(pool.sem, WAIT_FOREVER);
+    for(i = 0; i < VXSSH_KEX_C25519_POOL_SIZE; i++) {
+        if(pool.pairs[i].fl_ready) {
+            memcpy(key, pool.pairs[i].key, CRYPTO_CURVE25519_SIZE);
+            memcpy(pub, pool.pairs[i].pub, CRYPTO_CURVE25519_SIZE);
+            explicit_bzero(&pool.pairs[i], sizeof(kex_c25519_keypair_t));
+            pool.ready--;
+            err = OK;
+            break;
+        }
+    }
+    semGive(pool.sem);
+
+    semGive(pool.wakeup);
+    return err;
+}
+
 /**
  * key - private key
  * pub - public key
  **/
 int vxssh_kex_c25519_keygen(uint8_t key[CRYPTO_CURVE25519_SIZE], uint8_t pub[CRYPTO_CURVE25519_SIZE]) {
-    static const uint8_t basepoint[CRYPTO_CURVE25519_SIZE] = {9};
-
+    if(vxssh_kex_c25519_pool_take(key, pub) == OK) {
+        return OK;
+    }
     vxssh_rnd_bin((char *)key, CRYPTO_CURVE25519_SIZE);
-    vxssh_scalarmult_curve25519(pub, (const unsigned char *)key, basepoint);
+    vxssh_scalarmult_curve25519_base(pub, (const unsigned char *)key);
 
     return OK;
 }
@@ -65,8 +199,22 @@ int vxssh_kex_c25519_shared_key(const uint8_t key[CRYPTO_CURVE25519_SIZE], const
     return OK;
 }
 
+/* string: uint32 length + data */
+static void hash_update_sz(const vxssh_digest_ops_t *ops, void *state, const uint8_t *data, size_t data_len) {
+    uint8_t len[4];
+
+    len[0] = (data_len >> 24) & 0xff;
+    len[1] = (data_len >> 16) & 0xff;
+    len[2] = (data_len >> 8) & 0xff;
+    len[3] = data_len & 0xff;
+
+    ops->update(state, len, sizeof(len));
+    ops->update(state, data, data_len);
+}
+
 /**
- *
+ * H = HASH(V_C || V_S || I_C || I_S || K_S || Q_C || Q_S || K)
+ * the fields are fed straight into the digest
  **/
 int vxssh_kex_c25519_hash(
     int hash_alg,
@@ -80,30 +228,31 @@ int vxssh_kex_c25519_hash(
     const uint8_t *shared_secret, size_t shared_secret_len,
     uint8_t *hash, size_t hashlen) {
 
-    int err = OK;
-    vxssh_mbuf_t *mbuf = NULL;
+    const vxssh_digest_ops_t *ops = vxssh_digest_get_ops(hash_alg);
+    uint64_t state[VXSSH_DIGEST_STATE_SIZE_MAX / sizeof(uint64_t)];
 
-    if((err = vxssh_mbuf_alloc(&mbuf, (client_version_string_len + server_version_string_len + ckexinitlen + skexinitlen  + sbloblen + CRYPTO_CURVE25519_SIZE + CRYPTO_CURVE25519_SIZE + shared_secret_len))) != OK) {
-        goto out;
+    if(!ops || ops->ctx_size > sizeof(state)) {
+        return EINVAL;
+    }
+    if(hashlen < ops->digest_len) {
+        return ERANGE;
     }
 
-    vxssh_mbuf_write_mem_sz(mbuf, (const uint8_t *)client_version_string, client_version_string_len);
-    vxssh_mbuf_write_mem_sz(mbuf, (const uint8_t *)server_version_string, server_version_string_len);
+    ops->init(state);
+    hash_update_sz(ops, state, client_version_string, client_version_string_len);
+    hash_update_sz(ops, state, server_version_string, server_version_string_len);
     /* kexinit c/s*/
-    vxssh_mbuf_write_mem_sz(mbuf, ckexinit, ckexinitlen);
-    vxssh_mbuf_write_mem_sz(mbuf, skexinit, skexinitlen);
+    hash_update_sz(ops, state, ckexinit, ckexinitlen);
+    hash_update_sz(ops, state, skexinit, skexinitlen);
     /* hostkey */
-    vxssh_mbuf_write_mem_sz(mbuf, serverhostkeyblob, sbloblen);
+    hash_update_sz(ops, state, serverhostkeyblob, sbloblen);
     /* session key */
-    vxssh_mbuf_write_mem_sz(mbuf, client_dh_pub, CRYPTO_CURVE25519_SIZE);
-    vxssh_mbuf_write_mem_sz(mbuf, server_dh_pub, CRYPTO_CURVE25519_SIZE);
+    hash_update_sz(ops, state, client_dh_pub, CRYPTO_CURVE25519_SIZE);
+    hash_update_sz(ops, state, server_dh_pub, CRYPTO_CURVE25519_SIZE);
     /* wrapped */
-    vxssh_mbuf_write_mem(mbuf, shared_secret, shared_secret_len);
+    ops->update(state, shared_secret, shared_secret_len);
+    ops->final(state, hash);
 
-    /* make digest */
-    err = vxssh_mbuf_digest(mbuf, hash_alg, hash, hashlen);
-
-out:
-    vxssh_mem_deref(mbuf);
-    return err;
+    explicit_bzero(state, ops->ctx_size);
+    return OK;
 }
@@ -8,7 +8,7 @@
 static void mem_destructor_vxssh_mac_ctx_t(void *data) {
     vxssh_mac_ctx_t *mac = data;
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
     if(mac->key) {
         explicit_bzero(mac->key, mac->key_len);
     }
@@ -52,10 +52,16 @@ int vxssh_mac_alloc(vxssh_mac_ctx_t **ctx, vxssh_mac_alg_props_t *mac_props) {
             goto out;
     }
 
+    /* filled in by the key exchange */
+    if((mac->key = vxssh_mem_zalloc(mac->key_len, NULL)) == NULL) {
+        err = ENOMEM;
+        goto out;
+    }
+
     if (mac_props->truncatebits != 0) {
         mac->mac_len = mac_props->truncatebits / 8;
-        mac->etm = mac_props->etm;
     }
+    mac->etm = mac_props->etm;
 
     *ctx = mac;
 
@@ -14,6 +14,50 @@ static void mem_destructor_vxssh_mbuf_t(void *data) {
     vxssh_mem_deref(mb->buf);
 }
 
+/* makes room for size bytes at pos */
+static int mbuf_reserve(vxssh_mbuf_t *mb, size_t size) {
+    const size_t rsize = (mb->pos + size);
+
+    if (rsize > mb->size) {
+        const size_t dsize = (mb->size ? (mb->size * 2) : DEFAULT_SIZE);
+        return vxssh_mbuf_resize(mb, MAX(rsize, dsize));
+    }
+    return OK;
+}
+
+/* magnitude of bn as big-endian bytes, without leading zeros */
+static size_t mpint_size(const mpz_t bn, uint8_t *msb) {
+    const mp_size_t n = mpz_size(bn);
+    mp_limb_t top;
+    size_t sz;
+
+    if (n == 0) {
+        return 0;
+    }
+    top = mpz_getlimbn(bn, n - 1);
+    sz = (n - 1) * sizeof(mp_limb_t);
+    for (; top > 0xff; top >>= 8) {
+        sz++;
+    }
+    *msb = (uint8_t) top;
+    return sz + 1;
+}
+
+/* writes the low sz bytes of bn, big-endian, ending right before p */
+static void mpint_store(const mpz_t bn, uint8_t *p, size_t sz) {
+    const mp_limb_t *lp = mpz_limbs_read(bn);
+    mp_limb_t l = 0;
+    size_t i;
+
+    for (i = 0; i < sz; i++) {
+        if ((i % sizeof(mp_limb_t)) == 0) {
+            l = *lp++;
+        }
+        *--p = (uint8_t) l;
+        l >>= 8;
+    }
+}
+
 static inline uint32_t b64val(char c) {
 	if ('A' <= c && c <= 'Z') return c - 'A' + 0;
 	else if ('a' <= c && c <= 'z') return c - 'a' + 26;
@@ -129,19 +173,14 @@ int vxssh_mbuf_fill(vxssh_mbuf_t *mb, uint8_t ch, size_t size) {
  *
  **/
 int vxssh_mbuf_write_mem(vxssh_mbuf_t *mb, const uint8_t *buf, size_t size) {
-    size_t rsize;
+    int err;
 
     if (!mb || !buf) {
         return EINVAL;
     }
 
-    rsize = (mb->pos + size);
-    if (rsize > mb->size) {
-        const size_t dsize = (mb->size ? (mb->size * 2) : DEFAULT_SIZE);
-        int err;
-
-        err = vxssh_mbuf_resize(mb, MAX(rsize, dsize));
-        if (err != OK) return err;
+    if ((err = mbuf_reserve(mb, size)) != OK) {
+        return err;
     }
 
     memcpy(mb->buf + mb->pos, buf, size);
@@ -426,68 +465,99 @@ out:
 }
 
 /**
- *  MPInt
+ * MPInt (rfc4251), the limbs are stored straight into the buffer,
+ * a zero byte goes first when the msb is set
  **/
 int vxssh_mbuf_write_mpint(vxssh_mbuf_t *mb, const mpz_t bn) {
     int err = OK;
-    uint8_t *t = NULL;
-    int bits = 0, prepend = 0;
-    size_t sz =0;
+    uint8_t msb = 0;
+    size_t sz = 0, prepend = 0;
 
     if (!mb || !bn) {
         return EINVAL;
     }
-    bits = mpz_sizeinbase (bn, 2);
-    sz = (bits / 8 + (bits % 8 ? 1 : 0));
-    if(sz == 0) {
-        err = ERROR;
-        goto out;
+    if((sz = mpint_size(bn, &msb)) == 0) {
+        return ERROR;
     }
+    prepend = (msb & 0x80) ? 1 : 0;
 
-    t = vxssh_mem_zalloc(sz, NULL);
-    if(t == NULL) {
-        err = ENOMEM;
-        goto out;
+    if((err = mbuf_reserve(mb, sizeof(uint32_t) + prepend + sz)) != OK) {
+        return err;
     }
-    mpz_export(t, &sz, 1, 1, 0, 0, bn);
-    if (t[0] & 0x80) { prepend = 1; }
-    /* size */
     vxssh_mbuf_write_u32(mb, sz + prepend);
-    /* lead zero */
     if(prepend) {
-        vxssh_mbuf_write_u8(mb, 0);
+        mb->buf[mb->pos++] = 0x0;
     }
-    vxssh_mbuf_write_mem(mb, t, sz);
-out:
-    vxssh_mem_deref(t);
-    return err;
+    mpint_store(bn, mb->buf + mb->pos + sz, sz);
+    mb->pos += sz;
+    mb->end = MAX(mb->end, mb->pos);
+
+    return OK;
 }
 
 /**
- *  MPInt
+ * length prefix, unsigned big-endian magnitude (no sign byte)
  **/
-int vxssh_mbuf_read_mpint(vxssh_mbuf_t *mb, mpz_t bn) {
+int vxssh_mbuf_write_bn_sz(vxssh_mbuf_t *mb, const mpz_t bn) {
     int err = OK;
-    size_t sz = 0, npos = 0;
-    uint8_t *p = NULL;
-    //
+    uint8_t msb = 0;
+    size_t sz = 0;
+
+    if (!mb || !bn) {
+        return EINVAL;
+    }
+    if((sz = mpint_size(bn, &msb)) == 0) {
+        return ERROR;
+    }
+    if((err = mbuf_reserve(mb, sizeof(uint32_t) + sz)) != OK) {
+        return err;
+    }
+    vxssh_mbuf_write_u32(mb, sz);
+    mpint_store(bn, mb->buf + mb->pos + sz, sz);
+    mb->pos += sz;
+    mb->end = MAX(mb->end, mb->pos);
+
+    return OK;
+}
+
+/**
+ * MPInt (rfc4251), parsed straight into the limbs of bn (must be initialized)
+ **/
+int vxssh_mbuf_read_mpint(vxssh_mbuf_t *mb, mpz_t bn) {
+    mp_limb_t *lp, l;
+    mp_size_t nl;
+    size_t sz = 0, npos = 0, i;
+    const uint8_t *p;
+
     if (!mb || !bn) {
         return EINVAL;
     }
     sz = vxssh_mbuf_read_u32(mb);
-    if(sz == 0 || (mb->pos + sz) > mb->size || sz > 16384) {
-        err = ERROR;
-        goto out;
+    if(sz == 0 || (mb->pos + sz) > mb->end || sz > 16384) {
+        return ERROR;
     }
     npos = (mb->pos + sz);
     p = (mb->buf + mb->pos);
-    if(p[0] == 0) { p++; sz--; }
+    for(; sz > 0 && *p == 0; p++, sz--);
 
-    mpz_init(bn);
-    mpz_import(bn, sz, 1, 1, 0, 0, p);
+    nl = (sz + sizeof(mp_limb_t) - 1) / sizeof(mp_limb_t);
+    if(nl == 0) {
+        mpz_set_ui(bn, 0);
+        vxssh_mbuf_set_pos(mb, npos);
+        return OK;
+    }
+    lp = mpz_limbs_write(bn, nl);
+    for(p += sz, i = 0; i < sz; lp++) {
+        size_t k;
+        for(l = 0, k = 0; k < sizeof(mp_limb_t) && i < sz; k++, i++) {
+            l |= (mp_limb_t) *--p << (8 * k);
+        }
+        *lp = l;
+    }
+    mpz_limbs_finish(bn, nl);
     vxssh_mbuf_set_pos(mb, npos);
-out:
-    return err;
+
+    return OK;
 }
 
 /**
@@ -5,10 +5,369 @@
  **/
 #include "vxssh.h"
 
+/*
+ * objects up to VXSSH_MEM_POOL_MAX_SIZE come from per-class free lists,
+ * the blocks are carved from slabs that are taken from malloc once and never given back,
+ * so the system partition doesn't get fragmented by the small short-lived ones.
+ * Until vxssh_mem_pool_init() everything goes to malloc
+ */
+#define POOL_SLAB_SIZE          4096    /* of the small classes, the big ones get POOL_SLAB_BLOCKS */
+#define POOL_SLAB_BLOCKS        4
+#define POOL_DEFAULT_SIZE       (512 * 1024)
+#define POOL_CLS_LARGE          0xffff  /* malloc, after the pool init (counted) */
+#define POOL_CLS_ARENA          0xfffe  /* a part of an arena, it goes back with the arena or its scope */
+#define ARENA_ALIGN(x)          (((x) + 7) & ~((size_t) 7))
+
+typedef struct pool_block_s {
+    struct pool_block_s *next;
+} pool_block_t;
+
+typedef struct {
+    SEM_ID          sem;
+    pool_block_t    *free;
+    size_t          block_size;     /* header + class */
+    uint32_t        slab_blocks;
+    vxssh_mem_pool_stats_t st;
+} pool_class_t;
+
+/* in front of the header of an arena block */
+typedef union {
+    size_t      size;       /* the whole block */
+    uint64_t    align;
+} arena_block_t;
+
+static pool_class_t pool[VXSSH_MEM_POOL_CLASSES];
+static SEM_ID pool_sem = NULL;      /* the slabs budget and the large blocks counter */
+static size_t pool_size = 0;
+static size_t pool_max = 0;
+static uint32_t pool_large = 0;
+static bool pool_ready = false;
+
+static int pool_class(size_t size) {
+    int c = 0;
+
+    if (size > VXSSH_MEM_POOL_MAX_SIZE) {
+        return -1;
+    }
+    while (pool[c].st.size < size) {
+        c++;
+    }
+    return c;
+}
+
+/* a new slab into the free list, the class lock is held */
+static int pool_carve(pool_class_t *pc) {
+    const size_t sz = pc->block_size * pc->slab_blocks;
+    uint8_t *slab = NULL;
+    uint32_t i;
+
+    semTake(pool_sem, WAIT_FOREVER);
+    if (pool_size + sz > pool_max) {
+        semGive(pool_sem);
+        return ENOMEM;
+    }
+    pool_size += sz;
+    semGive(pool_sem);
+
+    if ((slab = malloc(sz)) == NULL) {
+        semTake(pool_sem, WAIT_FOREVER);
+        pool_size -= sz;
+        semGive(pool_sem);
+        return ENOMEM;
+    }
+    for (i = 0; i < pc->slab_blocks; i++) {
+        pool_block_t *b = (pool_block_t *) (slab + i * pc->block_size);
+        b->next = pc->free;
+        pc->free = b;
+    }
+    pc->st.slabs++;
+    pc->st.blocks += pc->slab_blocks;
+
+    return OK;
+}
+
+static vxssh_mem_t *pool_alloc(size_t size) {
+    vxssh_mem_t *m = NULL;
+    const int c = (pool_ready ? pool_class(size) : -1);
+
+    if (c >= 0) {
+        pool_class_t *pc = &pool[c];
+
+        semTake(pc->sem, WAIT_FOREVER);
+        if (pc->free || pool_carve(pc) == OK) {
+            m = (vxssh_mem_t *) pc->free;
+            pc->free = pc->free->next;
+            if (++pc->st.used > pc->st.peak) {
+                pc->st.peak = pc->st.used;
+            }
+            m->cls = c + 1;
+        } else {
+            pc->st.misses++;
+        }
+        semGive(pc->sem);
+        if (m) {
+            return m;
+        }
+    }
+
+    if ((m = malloc(sizeof(vxssh_mem_t) + size)) == NULL) {
+        return NULL;
+    }
+    m->cls = 0;
+    if (pool_ready) {
+        m->cls = POOL_CLS_LARGE;
+        semTake(pool_sem, WAIT_FOREVER);
+        pool_large++;
+        semGive(pool_sem);
+    }
+    return m;
+}
+
+static void pool_free(vxssh_mem_t *m) {
+    pool_class_t *pc = NULL;
+    pool_block_t *b = (pool_block_t *) m;
+
+    if (m->cls == POOL_CLS_ARENA) {
+        return;
+    }
+    if (m->cls == 0) {
+        free(m);
+        return;
+    }
+    if (m->cls == POOL_CLS_LARGE) {
+        free(m);
+        semTake(pool_sem, WAIT_FOREVER);
+        pool_large--;
+        semGive(pool_sem);
+        return;
+    }
+    pc = &pool[m->cls - 1];
+    semTake(pc->sem, WAIT_FOREVER);
+    b->next = pc->free;
+    pc->free = b;
+    pc->st.used--;
+    semGive(pc->sem);
+}
+
+// -----------------------------------------------------------------------------------------------------------------
+/**
+ * max_size - the slabs limit, 0 - default,
+ * one slab of each class is taken right away
+ **/
+int vxssh_mem_pool_init(size_t max_size) {
+    int c;
+
+    if (pool_ready) {
+        return OK;
+    }
+    if ((pool_sem = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE)) == NULL) {
+        return ENOMEM;
+    }
+    for (c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        pool_class_t *pc = &pool[c];
+
+        memset(pc, 0, sizeof(*pc));
+        pc->st.size = (16 << c);
+        pc->block_size = sizeof(vxssh_mem_t) + pc->st.size;
+        pc->slab_blocks = MAX(POOL_SLAB_BLOCKS, POOL_SLAB_SIZE / pc->block_size);
+        if ((pc->sem = semMCreate(SEM_Q_PRIORITY | SEM_DELETE_SAFE | SEM_INVERSION_SAFE)) == NULL) {
+            goto err;
+        }
+    }
+    pool_max = (max_size ? max_size : POOL_DEFAULT_SIZE);
+    for (c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        pool_carve(&pool[c]);
+    }
+    pool_ready = true;
+    return OK;
+err:
+    for (c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        if (pool[c].sem) {
+            semDelete(pool[c].sem);
+            pool[c].sem = NULL;
+        }
+    }
+    semDelete(pool_sem);
+    pool_sem = NULL;
+    return ENOMEM;
+}
+
+/**
+ * stats - VXSSH_MEM_POOL_CLASSES entries,
+ * large - live blocks that went to malloc
+ **/
+int vxssh_mem_pool_get_stats(vxssh_mem_pool_stats_t *stats, uint32_t *large) {
+    int c;
+
+    if (!stats) {
+        return EINVAL;
+    }
+    if (!pool_ready) {
+        return ENOENT;
+    }
+    for (c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        semTake(pool[c].sem, WAIT_FOREVER);
+        stats[c] = pool[c].st;
+        semGive(pool[c].sem);
+    }
+    if (large) {
+        *large = pool_large;
+    }
+    return OK;
+}
+
+/**
+ * per class usage to the log
+ **/
+void vxssh_mem_pool_show() {
+    vxssh_mem_pool_stats_t st[VXSSH_MEM_POOL_CLASSES];
+    uint32_t large = 0;
+    int c;
+
+    if (vxssh_mem_pool_get_stats(st, &large) != OK) {
+        vxssh_log_debug("mem pool: not initialized");
+        return;
+    }
+    vxssh_log_debug("mem pool: %u of %u bytes in slabs, %u large blocks", (uint32_t) pool_size, (uint32_t) pool_max, large);
+    for (c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        vxssh_log_debug("  %4u: slabs %u, blocks %u, used %u, peak %u, misses %u",
+            st[c].size, st[c].slabs, st[c].blocks, st[c].used, st[c].peak, st[c].misses);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------
+static void mem_destructor_vxssh_mem_arena_t(void *data) {
+    vxssh_mem_arena_t *arena = data;
+
+    explicit_bzero(arena->buf, arena->size);
+}
+
+/* the bottom or the scope, NULL - doesn't fit */
+static vxssh_mem_t *arena_block(vxssh_mem_arena_t *arena, size_t size, bool scope) {
+    const size_t sz = ARENA_ALIGN(sizeof(arena_block_t) + sizeof(vxssh_mem_t) + size);
+    arena_block_t *b = NULL;
+    vxssh_mem_t *m = NULL;
+
+    if (arena->hi - arena->lo < sz) {
+        arena->misses++;
+        return NULL;
+    }
+    if (scope) {
+        arena->hi -= sz;
+        b = (arena_block_t *) (arena->buf + arena->hi);
+    } else {
+        b = (arena_block_t *) (arena->buf + arena->lo);
+        arena->lo += sz;
+    }
+    if (arena->lo + (arena->size - arena->hi) > arena->peak) {
+        arena->peak = arena->lo + (arena->size - arena->hi);
+    }
+    b->size = sz;
+    m = (vxssh_mem_t *) (b + 1);
+    m->cls = POOL_CLS_ARENA;
+
+    return m;
+}
+
+/**
+ * size - the whole footprint, the arena itself is a pool object,
+ * the memory is zeroed once here and again at the scope end, so the blocks come zeroed
+ **/
+int vxssh_mem_arena_alloc(vxssh_mem_arena_t **arena, size_t size) {
+    const size_t hsz = ARENA_ALIGN(sizeof(vxssh_mem_arena_t));
+    vxssh_mem_arena_t *ta = NULL;
+
+    if (!arena || size < hsz + 256) {
+        return EINVAL;
+    }
+    if ((ta = vxssh_mem_alloc(size, mem_destructor_vxssh_mem_arena_t)) == NULL) {
+        return ENOMEM;
+    }
+    explicit_bzero(ta, size);
+    ta->buf = (uint8_t *) ta + hsz;
+    ta->size = (size - hsz) & ~((size_t) 7);
+    ta->hi = ta->size;
+
+    *arena = ta;
+    return OK;
+}
+
+/**
+ * an object that lives as long as the arena,
+ * it's dereferenced as usual but the memory comes back only with the arena
+ * (so the arena has to be the last one to go)
+ **/
+void *vxssh_mem_arena_zalloc(vxssh_mem_arena_t *arena, size_t size, vxssh_mem_destructor_h *dh) {
+    vxssh_mem_t *m = NULL;
+
+    if (!arena || (m = arena_block(arena, size, false)) == NULL) {
+        return vxssh_mem_zalloc(size, dh);
+    }
+    m->nrefs = 1;
+    m->dh = dh;
+
+    return (void *)(m + 1);
+}
+
+/**
+ * an object of the current scope, the pool one without the scope
+ **/
+void *vxssh_mem_arena_scope_zalloc(vxssh_mem_arena_t *arena, size_t size, vxssh_mem_destructor_h *dh) {
+    vxssh_mem_t *m = NULL;
+
+    if (!arena || !arena->fl_scope || (m = arena_block(arena, size, true)) == NULL) {
+        return vxssh_mem_zalloc(size, dh);
+    }
+    m->nrefs = 1;
+    m->dh = dh;
+
+    return (void *)(m + 1);
+}
+
+/**
+ * scopes don't nest, an open one is just continued
+ **/
+int vxssh_mem_arena_scope_begin(vxssh_mem_arena_t *arena) {
+    if (!arena) {
+        return EINVAL;
+    }
+    arena->fl_scope = true;
+    return OK;
+}
+
+/**
+ * the scope memory is wiped and goes back in one piece,
+ * EBUSY - some of its objects are still referenced, the scope stays open
+ **/
+int vxssh_mem_arena_scope_end(vxssh_mem_arena_t *arena) {
+    arena_block_t *b = NULL;
+    size_t pos;
+
+    if (!arena) {
+        return EINVAL;
+    }
+    if (!arena->fl_scope) {
+        return OK;
+    }
+    for (pos = arena->hi; pos < arena->size; pos += b->size) {
+        b = (arena_block_t *) (arena->buf + pos);
+        if (((vxssh_mem_t *) (b + 1))->nrefs > 0) {
+            return EBUSY;
+        }
+    }
+    explicit_bzero(arena->buf + arena->hi, arena->size - arena->hi);
+    arena->hi = arena->size;
+    arena->fl_scope = false;
+
+    return OK;
+}
+
+// -----------------------------------------------------------------------------------------------------------------
+
 void *vxssh_mem_alloc(size_t size, vxssh_mem_destructor_h *dh) {
     vxssh_mem_t *m = NULL;
 
-    m = malloc(sizeof(vxssh_mem_t) + size);
+    m = pool_alloc(size);
     if (!m) {
         return NULL;
     }
@@ -37,10 +396,42 @@ void *vxssh_mem_realloc(void *data, size_t size) {
         return NULL;
     }
     m = ((vxssh_mem_t *) data) - 1;
-    m2 = realloc(m, sizeof(vxssh_mem_t) + size);
+    if (m->cls == POOL_CLS_ARENA) {
+        /* arena block: it goes to the pool, the old one is left unused */
+        const size_t old = ((arena_block_t *) m - 1)->size - sizeof(arena_block_t) - sizeof(vxssh_mem_t);
+
+        if (size <= old) {
+            return data;
+        }
+        if ((m2 = pool_alloc(size)) == NULL) {
+            return NULL;
+        }
+        m2->nrefs = m->nrefs;
+        m2->dh = m->dh;
+        memcpy(m2 + 1, data, old);
+        m->nrefs = 0;
+        return (void *)(m2 + 1);
+    }
+    if (m->cls == 0 || m->cls == POOL_CLS_LARGE) {
+        m2 = realloc(m, sizeof(vxssh_mem_t) + size);
+        if (!m2) {
+            return NULL;
+        }
+        return (void *)(m2 + 1);
+    }
+    /* pool block: it stays while the new size fits the class */
+    if (size <= pool[m->cls - 1].st.size) {
+        return data;
+    }
+    m2 = pool_alloc(size);
     if (!m2) {
         return NULL;
     }
+    m2->nrefs = m->nrefs;
+    m2->dh = m->dh;
+    memcpy(m2 + 1, data, pool[m->cls - 1].st.size);
+    pool_free(m);
+
     return (void *)(m2 + 1);
 }
 
@@ -93,7 +484,7 @@ void *vxssh_mem_deref(void *data) {
         return NULL;
     }
 
-    free(m);
+    pool_free(m);
     m = NULL;
 
     return NULL;
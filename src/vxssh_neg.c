@@ -6,7 +6,9 @@
 #include "vxssh.h"
 
 static vxssh_skey_alg_props_t  VXSSH_SERVER_KEY_ALGORITHMS[] = {
-    {"ssh-rsa"}
+/*     name         | key object type                   | enabled */
+    {"ssh-ed25519"  , CRYPTO_OBJECT_ED25519_PRIVATE_KEY , false},
+    {"ssh-rsa"      , CRYPTO_OBJECT_RSA_PRIVATE_KEY     , false}
 };
 #define VXSSH_SERVER_KEY_ALGORITHMS_SIZE ARRAY_SIZE(VXSSH_SERVER_KEY_ALGORITHMS)
 
@@ -18,11 +20,15 @@ static vxssh_kex_alg_props_t  VXSSH_KEX_ALGORITHMS[] = {
 
 /* --------------------------------------------------------------------------------------------- */
 static vxssh_mac_alg_props_t  VXSSH_MAC_ALGORITHMS[] = {
-/*     name          | type            | digest alg       | digest len              | truncatebits */
-    {"hmac-sha1-96"  , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA1, VXSSH_DIGEST_SHA1_LENGTH, 96},
-    {"hmac-sha1"     , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA1, VXSSH_DIGEST_SHA1_LENGTH, 00},
-    {"hmac-md5-96"   , VXSSH_MAC_DIGEST, VXSSH_DIGEST_MD5,  VXSSH_DIGEST_MD5_LENGTH,  96},
-    {"hmac-md5"      , VXSSH_MAC_DIGEST, VXSSH_DIGEST_MD5,  VXSSH_DIGEST_MD5_LENGTH,  00}
+/*     name                           | type            | digest alg         | digest len                | truncatebits | etm */
+    {"hmac-sha2-256-etm@openssh.com"  , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA256, VXSSH_DIGEST_SHA256_LENGTH, 00, 1},
+    {"hmac-sha2-512-etm@openssh.com"  , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA512, VXSSH_DIGEST_SHA512_LENGTH, 00, 1},
+    {"hmac-sha2-256"                  , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA256, VXSSH_DIGEST_SHA256_LENGTH, 00, 0},
+    {"hmac-sha2-512"                  , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA512, VXSSH_DIGEST_SHA512_LENGTH, 00, 0},
+    {"hmac-sha1-96"                   , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA1,   VXSSH_DIGEST_SHA1_LENGTH,   96, 0},
+    {"hmac-sha1"                      , VXSSH_MAC_DIGEST, VXSSH_DIGEST_SHA1,   VXSSH_DIGEST_SHA1_LENGTH,   00, 0},
+    {"hmac-md5-96"                    , VXSSH_MAC_DIGEST, VXSSH_DIGEST_MD5,    VXSSH_DIGEST_MD5_LENGTH,    96, 0},
+    {"hmac-md5"                       , VXSSH_MAC_DIGEST, VXSSH_DIGEST_MD5,    VXSSH_DIGEST_MD5_LENGTH,    00, 0}
 };
 #define VXSSH_MAC_ALGORITHMS_SIZE ARRAY_SIZE(VXSSH_MAC_ALGORITHMS)
 
@@ -47,8 +53,24 @@ static vxssh_compression_alg_props_t  VXSSH_COMPRESSION_ALGORITHMS[] = {
 /**
  *
  **/
-int vxssh_neg_get_server_key_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf) {
+int vxssh_neg_enable_server_key_algorithm(int type, bool enable) {
     uint32_t i;
+    int err = ENOENT;
+
+    for(i = 0; i < VXSSH_SERVER_KEY_ALGORITHMS_SIZE; i++) {
+        if(VXSSH_SERVER_KEY_ALGORITHMS[i].type == type) {
+            VXSSH_SERVER_KEY_ALGORITHMS[i].enabled = enable;
+            err = OK;
+        }
+    }
+    return err;
+}
+
+/**
+ * only the algorithms we have a host key for
+ **/
+int vxssh_neg_get_server_key_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf) {
+    uint32_t i, n = 0;
 
     if(!mb) {
         return EINVAL;
@@ -58,7 +80,10 @@ int vxssh_neg_get_server_key_algorithms(vxssh_mbuf_t *mb, bool clean_mbuf) {
         vxssh_mbuf_clear(mb);
     }
     for(i = 0; i < VXSSH_SERVER_KEY_ALGORITHMS_SIZE; i++) {
-        if(i) {
+        if(!VXSSH_SERVER_KEY_ALGORITHMS[i].enabled) {
+            continue;
+        }
+        if(n++) {
             vxssh_mbuf_write_str(mb, ",");
         }
         vxssh_mbuf_write_str(mb, VXSSH_SERVER_KEY_ALGORITHMS[i].name);
@@ -85,6 +110,9 @@ vxssh_skey_alg_props_t* vxssh_neg_select_server_key_algorithm(vxssh_mbuf_t *mb,
         if(slen == 0) { break; }
         for(i = 0; i < VXSSH_SERVER_KEY_ALGORITHMS_SIZE; i++) {
             const char *op = VXSSH_SERVER_KEY_ALGORITHMS[i].name;
+            if(!VXSSH_SERVER_KEY_ALGORITHMS[i].enabled) {
+                continue;
+            }
             if(op != NULL && vxssh_str_equal(s, slen, op, strlen(op)))  {
                 result = &VXSSH_SERVER_KEY_ALGORITHMS[i];
                 break;
@@ -326,3 +354,45 @@ vxssh_compression_alg_props_t* vxssh_neg_select_compression_algorithm(vxssh_mbuf
     }
     return result;
 }
+
+/**
+ * KEXINIT fields after the cookie: name-lists, languages, first_kex_packet_follows, reserved
+ **/
+int vxssh_neg_get_kexinit(vxssh_mbuf_t *mb) {
+    vxssh_mbuf_t *tmbuf = NULL;
+    int err = OK;
+
+    if(!mb) {
+        return EINVAL;
+    }
+    if((err = vxssh_mbuf_alloc(&tmbuf, 512)) != OK) {
+        return err;
+    }
+    vxssh_mbuf_clear(mb);
+    /* kex algorithms */
+    vxssh_neg_get_kex_algorithms(tmbuf, true);
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);
+    /* server host key algorithms */
+    vxssh_neg_get_server_key_algorithms(tmbuf, true);
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);
+    /* encryption algorithms */
+    vxssh_neg_get_cipher_algorithms(tmbuf, true);
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // client to server
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // server to client
+    /* mac algorithms */
+    vxssh_neg_get_mac_algorithms(tmbuf, true);
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // client to server
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // server to client
+    /* comression */
+    vxssh_neg_get_compression_algorithms(tmbuf, true);
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // client to server
+    vxssh_mbuf_write_mbuf_sz(mb, tmbuf);   // server to client
+    /* other fields */
+    vxssh_mbuf_write_str_sz(mb, "");     // languages client to server
+    vxssh_mbuf_write_str_sz(mb, "");     // languages server to client
+    vxssh_mbuf_write_u8(mb, 0);          // kex first packet follows
+    vxssh_mbuf_write_u32(mb, 0);         // reserved
+
+    vxssh_mem_deref(tmbuf);
+    return err;
+}
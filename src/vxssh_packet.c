@@ -38,15 +38,15 @@ static int packet_receive_encypted(vxssh_session_t *session, vxssh_mbuf_t *mbuf,
             err = ETIME;
             break;
         }
-        if(!vxssh_fd_select_read(session->socfd, 1000)) {
+        if(!vxssh_session_rx_pending(session) && !vxssh_fd_select_read(session->socfd, 1000)) {
             continue;
         }
 
         if(packet_len > 0) {
             const int rsz = ((mbuf->pos + sizeof(buf)) > packet_len ? packet_len - mbuf->pos : sizeof(buf));
-            rds = read(session->socfd, (char *) buf, rsz);
+            rds = vxssh_session_read(session, buf, rsz);
         } else {
-            rds = read(session->socfd, &ch, 1);
+            rds = vxssh_session_read(session, &ch, 1);
         }
 
         if(rds > 0) {
@@ -88,6 +88,11 @@ static int packet_receive_encypted(vxssh_session_t *session, vxssh_mbuf_t *mbuf,
                             vxssh_log_warn("invalid packet alignment: %u (%u)", packet_len, kex->keys_in.enc->block_len);
                             err = ERANGE; break;
                         }
+                        /* a single block packet (e.g. NEWKEYS), only the mac is left */
+                        if(mbuf->pos >= packet_len) {
+                            packet_len += extra_len;
+                            extra_len = 0;
+                        }
                     }
                 }
             }
@@ -135,6 +140,116 @@ out:
     return err;
 }
 
+/**
+ * Encrypt-then-MAC: the length field is sent in clear and the mac covers the ciphertext
+ **/
+static int packet_receive_encypted_etm(vxssh_session_t *session, vxssh_mbuf_t *mbuf, int timeout) {
+    vxssh_kex_t *kex = session->kex;
+    int err = OK, rds = 0;
+    char buf[VXSSH_CIPHER_BLOCK_SIZE_MAX], ch = 0;
+    size_t packet_len = 0, pos = 0;
+    uint8_t padding_len = 0;
+    int expiry_flag = false;
+    WDOG_ID expiry_wd = NULL;
+
+    if(kex->keys_in.enc->block_len > sizeof(buf)) {
+        vxssh_log_error("fix me: dec chipher block > %i", sizeof(buf));
+        return ERROR;
+    }
+
+    if ((expiry_wd = wdCreate()) == NULL)  {
+        vxssh_log_warn("wdCreate() fail");
+        err = ERROR;
+        goto out;
+    }
+    if((err = wdStart(expiry_wd, (timeout * CLOCKS_PER_SEC), (FUNCPTR)callback_wd_expiry, (int) &expiry_flag)) != OK) {
+        vxssh_log_warn("wdStart() fail (%i)", err);
+        goto out;
+    }
+
+    vxssh_mbuf_clear(mbuf);
+    while(!vxssh_server_is_shutdown()) {
+        if(expiry_flag) {
+            err = ETIME;
+            break;
+        }
+
+        if(!vxssh_session_rx_pending(session) && !vxssh_fd_select_read(session->socfd, 1000)) {
+            continue;
+        }
+
+        if(packet_len > 0) {
+            const int rsz = ((mbuf->pos + sizeof(buf)) > packet_len ? packet_len - mbuf->pos : sizeof(buf));
+            rds = vxssh_session_read(session, buf, rsz);
+        } else {
+            rds = vxssh_session_read(session, &ch, 1);
+        }
+
+        if(rds > 0) {
+            if(packet_len > 0) {
+                err = vxssh_mbuf_write_mem(mbuf, (uint8_t *)buf, rds);
+                if(err != OK || mbuf->pos >= packet_len) {
+                    break;
+                }
+            } else {
+                if(mbuf->pos < 4) {
+                    vxssh_mbuf_write_u8(mbuf, ch);
+                    if(mbuf->pos == 4) {
+                        vxssh_mbuf_set_pos(mbuf, 0);
+                        packet_len = vxssh_mbuf_read_u32(mbuf);
+                        if(packet_len < VXSSH_CIPHER_BLOCK_SIZE_MIN || packet_len > VXSSH_PACKET_PAYLOAD_SIZE_MAX) {
+                            vxssh_log_warn("invalid packet lenght: %u", packet_len);
+                            err = ERANGE; break;
+                        }
+                        if(packet_len % kex->keys_in.enc->block_len > 0) {
+                            vxssh_log_warn("invalid packet alignment: %u (%u)", packet_len, kex->keys_in.enc->block_len);
+                            err = ERANGE; break;
+                        }
+                        packet_len += (4 + kex->keys_in.mac->mac_len);
+                    }
+                }
+            }
+        }
+    }
+    if(err != OK) {
+        goto out;
+    }
+
+    vxssh_mbuf_set_pos(mbuf, 0);
+    packet_len = (vxssh_mbuf_read_u32(mbuf) + 4);
+
+    uint8_t *macp = (mbuf->buf + packet_len);
+    if((err = vxssh_mac_check(kex->keys_in.mac, session->recv_seq, mbuf->buf, packet_len, macp, kex->keys_in.mac->mac_len)) != OK) {
+        vxssh_log_warn("mac mismatch (%i)", err);
+        goto out;
+    }
+
+    pos = 4;
+    while(pos < packet_len) {
+        if((err = vxssh_cipher_decrypt(kex->keys_in.enc, mbuf->buf + pos, kex->keys_in.enc->block_len, (uint8_t *)buf, kex->keys_in.enc->block_len)) != OK) {
+            vxssh_log_warn("decrypt faild: %i", err);
+            goto out;
+        }
+        memcpy(mbuf->buf + pos, buf, kex->keys_in.enc->block_len);
+        pos += kex->keys_in.enc->block_len;
+    }
+
+    /* correct postions */
+    vxssh_mbuf_set_pos(mbuf, 4);
+    padding_len = vxssh_mbuf_read_u8(mbuf);
+    if(padding_len > packet_len - 5) {
+        err = ERANGE;
+        goto out;
+    }
+    mbuf->end = (mbuf->end - padding_len - kex->keys_in.mac->mac_len);
+out:
+    if(expiry_wd) {
+        wdCancel(expiry_wd);
+        wdDelete(expiry_wd);
+    }
+    return err;
+}
+
 static int packet_receive_plain(vxssh_session_t *session, vxssh_mbuf_t *mbuf, int timeout) {
     char buf[32], ch = 0;
     int err = OK, rds = 0;
@@ -160,15 +275,15 @@ static int packet_receive_plain(vxssh_session_t *session, vxssh_mbuf_t *mbuf, in
             break;
         }
 
-        if(!vxssh_fd_select_read(session->socfd, 1000)) {
+        if(!vxssh_session_rx_pending(session) && !vxssh_fd_select_read(session->socfd, 1000)) {
             continue;
         }
 
         if(packet_len > 0) {
             const int rsz = ((mbuf->pos + sizeof(buf)) > packet_len ? packet_len - mbuf->pos : sizeof(buf));
-            rds = read(session->socfd, (char *) buf, rsz);
+            rds = vxssh_session_read(session, buf, rsz);
         } else {
-            rds = read(session->socfd, &ch, 1);
+            rds = vxssh_session_read(session, &ch, 1);
         }
 
         if(rds > 0) {
@@ -245,18 +360,22 @@ static int packet_send_encypted(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
     size_t pos = 0, packet_len = 0;
     char buf[VXSSH_CIPHER_BLOCK_SIZE_MAX];
     char mac[VXSSH_DIGEST_LENGTH_MAX];
+    int etm = kex->keys_out.mac->etm;
 
     if(kex->keys_out.enc->block_len > sizeof(buf)) {
         vxssh_log_error("fixme: enc chipher block > %i", sizeof(buf));
         return ERROR;
     }
 
-    if((err = vxssh_mac_compute(kex->keys_out.mac, session->send_seq, mbuf->buf, mbuf->end, (uint8_t *)mac, kex->keys_out.mac->mac_len)) != OK) {
-        vxssh_log_warn("mac_compute fail (%i)", err);
-        goto out;
+    if(!etm) {
+        if((err = vxssh_mac_compute(kex->keys_out.mac, session->send_seq, mbuf->buf, mbuf->end, (uint8_t *)mac, kex->keys_out.mac->mac_len)) != OK) {
+            vxssh_log_warn("mac_compute fail (%i)", err);
+            goto out;
+        }
     }
 
-    pos = 0;
+    /* etm: packet length stays in clear */
+    pos = (etm ? 4 : 0);
     packet_len = mbuf->end;
     while(pos < packet_len) {
         if((err = vxssh_cipher_encrypt(kex->keys_out.enc, mbuf->buf + pos, kex->keys_out.enc->block_len, (uint8_t *)buf, kex->keys_out.enc->block_len)) != OK) {
@@ -273,6 +392,13 @@ static int packet_send_encypted(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
         goto out;
     }
 
+    if(etm) {
+        if((err = vxssh_mac_compute(kex->keys_out.mac, session->send_seq, mbuf->buf, mbuf->end, (uint8_t *)mac, kex->keys_out.mac->mac_len)) != OK) {
+            vxssh_log_warn("mac_compute fail (%i)", err);
+            goto out;
+        }
+    }
+
     if((err = vxssh_mbuf_write_mem(mbuf, (uint8_t *)mac, kex->keys_out.mac->mac_len)) != OK){
         goto out;
     }
@@ -312,24 +438,26 @@ int vxssh_packet_end(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
     size_t block_len = VXSSH_CIPHER_BLOCK_SIZE_MIN;
     size_t packet_len = 0;
     uint8_t padding_len = 0;
-    int i;
+    int i, etm = 0;
 
     if(!session || !mbuf) {
         return EINVAL;
     }
 
-    if(session->fl_rekeying_done) {
-        block_len = kex->keys_in.enc->block_len;
+    if(kex->keys_out.enc) {
+        block_len = kex->keys_out.enc->block_len;
         if(block_len < VXSSH_CIPHER_BLOCK_SIZE_MIN) {
             block_len = VXSSH_CIPHER_BLOCK_SIZE_MIN;
         }
+        etm = kex->keys_out.mac->etm;
     }
 
-    padding_len = (block_len - (mbuf->end % block_len));
+    /* etm: the length field isn't a part of the encrypted data */
+    padding_len = (block_len - ((mbuf->end - (etm ? 4 : 0)) % block_len));
     if(padding_len < 4) {
         padding_len += block_len;
     }
-    if(!session->fl_rekeying_done) {
+    if(!kex->keys_out.enc) {
         vxssh_mbuf_fill(mbuf, 0, padding_len);
     } else {
 #ifndef VXSSH_USE_RANDOM_PADDING
@@ -379,14 +507,21 @@ int vxssh_packet_receive(vxssh_session_t *session, vxssh_mbuf_t *mbuf, int timeo
         return EINVAL;
     }
 
-    if(session->fl_rekeying_done) {
-        err = packet_receive_encypted(session, mbuf, timeout);
+    /* each direction is switched by its own NEWKEYS */
+    if(session->kex->keys_in.enc) {
+        if(session->kex->keys_in.mac->etm) {
+            err = packet_receive_encypted_etm(session, mbuf, timeout);
+        } else {
+            err = packet_receive_encypted(session, mbuf, timeout);
+        }
     } else {
         err = packet_receive_plain(session, mbuf, timeout);
     }
 
     if(err == OK) {
         session->recv_seq++;
+        session->rekey_packets++;
+        session->rekey_bytes += mbuf->end;
 
         uint8_t c = mbuf->buf[mbuf->pos];
         if(c == SSH_MSG_DISCONNECT) {
@@ -409,7 +544,7 @@ int vxssh_packet_send(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
         return EINVAL;
     }
 
-    if(session->fl_rekeying_done) {
+    if(session->kex->keys_out.enc) {
         err = packet_send_encypted(session, mbuf);
     } else {
         err = packet_send_plain(session, mbuf);
@@ -417,6 +552,8 @@ int vxssh_packet_send(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
 
     if(err == OK) {
         session->send_seq++;
+        session->rekey_packets++;
+        session->rekey_bytes += mbuf->end;
     }
 
     return err;
@@ -13,7 +13,8 @@
 #define METHOD_PASSWORD         "password"
 //#define AUTH_METHOD_PUBKEY      "publickey"
 
-static int read_cstr(vxssh_mbuf_t *mbuf, char **str, size_t *slen) {
+/* the strings of the exchange live in the handshake scope */
+static int read_cstr(vxssh_session_t *session, vxssh_mbuf_t *mbuf, char **str, size_t *slen) {
     int err = OK;
     char *s = NULL;
     size_t itmp;
@@ -23,7 +24,12 @@ static int read_cstr(vxssh_mbuf_t *mbuf, char **str, size_t *slen) {
         err = VXSSH_ERR_PROTO_ERROR;
         goto out;
     }
-    if((err = vxssh_mbuf_strdup(mbuf, &s, &itmp)) != OK) {
+    if((s = vxssh_mem_arena_scope_zalloc(session->arena, itmp + 1, NULL)) == NULL) {
+        err = ENOMEM;
+        goto out;
+    }
+    if((err = vxssh_mbuf_read_mem(mbuf, (uint8_t *)s, &itmp)) != OK) {
+        vxssh_mem_deref(s);
         goto out;
     }
 
@@ -83,9 +89,9 @@ int vxssh_packet_io_auth(vxssh_session_t *session, int timeout) {
     auth_tries = rt->auth_tries_max;
     while(auth_tries > 0 && !vxssh_server_is_shutdown()) {
         authorized = false;
-        vxssh_mem_deref(service);
-        vxssh_mem_deref(username);
-        vxssh_mem_deref(password);
+        service = vxssh_mem_deref(service);
+        username = vxssh_mem_deref(username);
+        password = vxssh_mem_deref(password);
 
         /* get request */
         if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
@@ -96,12 +102,12 @@ int vxssh_packet_io_auth(vxssh_session_t *session, int timeout) {
         }
 
         /* username */
-        if((err = read_cstr(mbuf, &username, &itmp)) != OK) {
+        if((err = read_cstr(session, mbuf, &username, &itmp)) != OK) {
             break;
         }
 
         /* service */
-        if((err = read_cstr(mbuf, &service, &itmp)) != OK) {
+        if((err = read_cstr(session, mbuf, &service, &itmp)) != OK) {
             break;
         }
         if(!vxssh_str_equal(service, itmp, SERVICE_SSH_CONNECTION, strlen(SERVICE_SSH_CONNECTION))) {
@@ -110,17 +116,22 @@ int vxssh_packet_io_auth(vxssh_session_t *session, int timeout) {
         }
 
         /* method */
-        vxssh_mem_deref(service);
-        if((err = read_cstr(mbuf, &service, &itmp)) != OK) {
+        service = vxssh_mem_deref(service);
+        if((err = read_cstr(session, mbuf, &service, &itmp)) != OK) {
             break;
         }
         if(vxssh_str_equal(service, itmp, METHOD_PASSWORD, strlen(METHOD_PASSWORD))) {
             vxssh_mbuf_read_u8(mbuf);
-            if((err = read_cstr(mbuf, &password, &itmp)) != OK) {
+            if((err = read_cstr(session, mbuf, &password, &itmp)) != OK) {
                 break;
             }
             if(loginUserVerify(username, password) == OK) {
-                session->username = username;
+                /* a copy for the session, the scope goes after the auth */
+                if((session->username = vxssh_mem_arena_zalloc(session->arena, strlen(username) + 1, NULL)) == NULL) {
+                    err = ENOMEM;
+                    break;
+                }
+                memcpy(session->username, username, strlen(username));
                 authorized = true;
                 break;
             }
@@ -156,10 +167,7 @@ out:
     if(err == VXSSH_ERR_PROTO_ERROR) {
         vxssh_packet_send_disconnect(session, SSH_DISCONNECT_PROTOCOL_ERROR, NULL);
     }
-    if(err != OK) {
-        vxssh_mem_deref(username);
-    }
-
+    vxssh_mem_deref(username);
     vxssh_mem_deref(service);
     vxssh_mem_deref(password);
 
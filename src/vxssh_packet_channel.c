@@ -4,10 +4,35 @@
  * https://akscf.org/
  **/
 #include "vxssh.h"
+#include "vxssh_str.h"
 #define CHANNEL_TYPE_SESSION    "session"
 #define CHANNEL_IS_PTY_REQ      "pty-req"
 #define CHANNEL_IS_SHELL        "shell"
 
+/*
+ * nothing but the transport messages may go out between our KEXINIT and our NEWKEYS (RFC 4253, 7.1),
+ * a reply made there is kept as a payload and sent by vxssh_packet_send_channel_deferred()
+ */
+static int send_reply(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
+    const size_t plen = (mbuf->end - 5);
+    int err = OK;
+
+    if(session->rekey_state != VXSSH_REKEY_STATE_KEXINIT_SENT && session->rekey_state != VXSSH_REKEY_STATE_WAIT_ECDH_INIT) {
+        vxssh_packet_end(session, mbuf);
+        return vxssh_packet_send(session, mbuf);
+    }
+
+    if(!session->defer && (err = vxssh_mbuf_alloc(&session->defer, 64)) != OK) {
+        return err;
+    }
+    if(session->defer->end + sizeof(uint32_t) + plen > VXSSH_SESSION_DEFER_SIZE) {
+        vxssh_log_warn("too many replies held by the rekey");
+        return ENOMEM;
+    }
+
+    return vxssh_mbuf_write_mem_sz(session->defer, mbuf->buf + 5, plen);
+}
+
 static int send_open_failure(vxssh_session_t *session, int chid, int reason, char *message) {
     vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
     int err = OK;
@@ -21,9 +46,8 @@ static int send_open_failure(vxssh_session_t *session, int chid, int reason, cha
     vxssh_mbuf_write_u32(mbuf, reason);
     vxssh_mbuf_write_str_sz(mbuf, message);
     vxssh_mbuf_write_u32(mbuf, 0);
-    vxssh_packet_end(session, mbuf);
 
-    err = vxssh_packet_send(session, mbuf);
+    err = send_reply(session, mbuf);
     return err;
 }
 
@@ -37,9 +61,8 @@ static int send_request_suceess(vxssh_session_t *session, int chid) {
 
     vxssh_packet_start(mbuf, SSH_MSG_CHANNEL_SUCCESS);
     vxssh_mbuf_write_u32(mbuf, chid);
-    vxssh_packet_end(session, mbuf);
 
-    err = vxssh_packet_send(session, mbuf);
+    err = send_reply(session, mbuf);
     return err;
 }
 
@@ -53,9 +76,8 @@ static int send_request_failure(vxssh_session_t *session, int chid) {
 
     vxssh_packet_start(mbuf, SSH_MSG_CHANNEL_FAILURE);
     vxssh_mbuf_write_u32(mbuf, chid);
-    vxssh_packet_end(session, mbuf);
 
-    err = vxssh_packet_send(session, mbuf);
+    err = send_reply(session, mbuf);
     return err;
 }
 
@@ -69,7 +91,8 @@ int vxssh_packet_do_channel_request(vxssh_session_t *session) {
     vxssh_server_runtime_t *rt = vxssh_server_get_runtime();
     vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
     int err = OK;
-    uint32_t chid = 0, itmp = 0;
+    uint32_t chid = 0;
+    size_t itmp = 0;
     uint8_t req_reqply = 0;
     char *ctype = NULL;
 
@@ -78,7 +101,7 @@ int vxssh_packet_do_channel_request(vxssh_session_t *session) {
         return EINVAL;
     }
 
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_REQUEST) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_REQUEST)) != OK) {
         goto out;
     }
     /* chid */
@@ -90,7 +113,7 @@ int vxssh_packet_do_channel_request(vxssh_session_t *session) {
         err = VXSSH_ERR_PROTO_ERROR;
         goto out;
     }
-    if((err = vxssh_mbuf_strdup(mbuf, &ctype, (size_t *)&itmp)) != OK) {
+    if((err = vxssh_mbuf_strdup(mbuf, &ctype, &itmp)) != OK) {
         goto out;
     }
     req_reqply = vxssh_mbuf_read_u8(mbuf);
@@ -135,14 +158,15 @@ out:
 int vxssh_packet_do_channel_open(vxssh_session_t *session) {
     vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
     int err = OK;
-    uint32_t chid = 0, iwsz = 0, mpsz = 0, itmp = 0;
+    uint32_t chid = 0, iwsz = 0, mpsz = 0;
+    size_t itmp = 0;
     char *ctype = NULL;
 
     if(!session) {
         return EINVAL;
     }
 
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_OPEN) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_OPEN)) != OK) {
         goto out;
     }
 
@@ -152,7 +176,7 @@ int vxssh_packet_do_channel_open(vxssh_session_t *session) {
         err = VXSSH_ERR_PROTO_ERROR;
         goto out;
     }
-    if((err = vxssh_mbuf_strdup(mbuf, &ctype,(size_t *)&itmp)) != OK) {
+    if((err = vxssh_mbuf_strdup(mbuf, &ctype, &itmp)) != OK) {
         goto out;
     }
     chid = vxssh_mbuf_read_u32(mbuf);
@@ -183,9 +207,8 @@ int vxssh_packet_do_channel_open(vxssh_session_t *session) {
     vxssh_mbuf_write_u32(mbuf, session->channel->id); /* sender*/
     vxssh_mbuf_write_u32(mbuf, session->channel->local_wsz);
     vxssh_mbuf_write_u32(mbuf, session->channel->packet_size);
-    vxssh_packet_end(session, mbuf);
 
-    if((err = vxssh_packet_send(session, mbuf)) != OK) {
+    if((err = send_reply(session, mbuf)) != OK) {
         goto out;
     }
 
@@ -206,7 +229,7 @@ int vxssh_packet_do_channel_data(vxssh_session_t *session, size_t *data_len) {
     if(!session) {
         return EINVAL;
     }
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_DATA) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_DATA)) != OK) {
         goto out;
     }
 
@@ -240,7 +263,7 @@ int vxssh_packet_do_channel_eof(vxssh_session_t *session) {
     if(!session) {
         return EINVAL;
     }
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_EOF) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_EOF)) != OK) {
         goto out;
     }
 
@@ -267,7 +290,7 @@ int vxssh_packet_do_channel_close(vxssh_session_t *session) {
     if(!session) {
         return EINVAL;
     }
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_CLOSE) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_CHANNEL_CLOSE)) != OK) {
         goto out;
     }
 
@@ -342,3 +365,42 @@ int vxssh_packet_send_channel_data(vxssh_session_t *session, vxssh_channel_t *ch
     err = vxssh_packet_send(session, mbuf);
     return err;
 }
+
+/***
+ * sends the replies held by a rekey, once our NEWKEYS is out
+ **/
+int vxssh_packet_send_channel_deferred(vxssh_session_t *session) {
+    vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
+    vxssh_mbuf_t *defer = (session ? session->defer : NULL);
+    uint32_t plen = 0;
+    int err = OK;
+
+    if(!session) {
+        return EINVAL;
+    }
+    if(!defer) {
+        return OK;
+    }
+
+    vxssh_mbuf_set_pos(defer, 0);
+    while(vxssh_mbuf_get_left(defer) > sizeof(uint32_t)) {
+        plen = vxssh_mbuf_read_u32(defer);
+        if(plen > vxssh_mbuf_get_left(defer)) {
+            err = ERROR;
+            break;
+        }
+        vxssh_mbuf_clear(mbuf);
+        vxssh_mbuf_write_u32(mbuf, 0);
+        vxssh_mbuf_write_u8(mbuf, 0);
+        vxssh_mbuf_write_mem(mbuf, defer->buf + defer->pos, plen);
+        vxssh_mbuf_set_pos(defer, defer->pos + plen);
+        vxssh_packet_end(session, mbuf);
+
+        if((err = vxssh_packet_send(session, mbuf)) != OK) {
+            break;
+        }
+    }
+
+    session->defer = vxssh_mem_deref(defer);
+    return err;
+}
@@ -5,18 +5,23 @@
  **/
 #include "vxssh.h"
 
+#define BANNER_LENGTH_MAX   255
+
 /**
- *
+ * The server banner and KEXINIT go out in one write,
+ * the client banner is taken from the read ahead buffer,
+ * whatever follows it (the client KEXINIT) stays there for the packet layer.
  **/
 int vxssh_packet_io_hello(vxssh_session_t *session, int timeout) {
     vxssh_kex_t *kex = (session ? session->kex : NULL);
+    vxssh_mbuf_t *rx = (session ? session->rxbuf : NULL);
+    vxssh_mbuf_t *mbuf = NULL;
     int pos = 0, wr = 0, rd = 0, err = OK;
-    char buf[255];
-    char ch;
-    int bsz = (sizeof(buf) - 1);
+    char buf[BANNER_LENGTH_MAX];
+    uint8_t *line, *eol;
     time_t expiry_ts;
 
-    if(!session || !kex) {
+    if(!session || !kex || !rx) {
         return EINVAL;
     }
 
@@ -28,51 +33,77 @@ int vxssh_packet_io_hello(vxssh_session_t *session, int timeout) {
 
     if(kex->server_version == NULL) {
         kex->server_version_len = (strlen((char *) buf) - 2);
-        kex->server_version = vxssh_mem_alloc(kex->server_version_len, NULL);
+        kex->server_version = vxssh_mem_arena_zalloc(session->arena, kex->server_version_len, NULL);
         if(kex->server_version == NULL) {
             return ENOMEM;
         }
         memcpy(kex->server_version, (char *)buf, kex->server_version_len);
     }
 
-    wr = write(session->socfd, (char *)buf, strlen(buf));
-    if(wr <= 0) { return ERROR; }
+    /* banner + KEXINIT */
+    if((err = vxssh_mbuf_alloc(&mbuf, 1024)) != OK) {
+        return err;
+    }
+    if((err = vxssh_packet_kexinit_build(session, session->iobuf)) != OK) {
+        goto out;
+    }
+    vxssh_mbuf_write_str(mbuf, buf);
+    vxssh_mbuf_write_mem(mbuf, session->iobuf->buf, session->iobuf->end);
 
-    explicit_bzero((char *)buf, sizeof(buf));
-    expiry_ts = vxssh_get_time() + (timeout * 1000L);
+    for(pos = 0; pos < mbuf->pos; pos += wr) {
+        if((wr = write(session->socfd, (char *) mbuf->buf + pos, mbuf->pos - pos)) <= 0) {
+            err = ERROR; goto out;
+        }
+    }
+    /* the packet is sent outside of vxssh_packet_send() */
+    session->send_seq++;
+    kex->fl_kexinit_sent = true;
 
+    /* client banner */
+    expiry_ts = vxssh_get_time() + (timeout * 1000L);
+    eol = NULL;
     while(!vxssh_server_is_shutdown()) {
-        if(expiry_ts < vxssh_get_time()) {
-            err = ETIME;
+        line = rx->buf + rx->pos;
+        if((eol = memchr(line, '\n', rx->end - rx->pos)) != NULL) {
             break;
         }
-
+        if(rx->end - rx->pos >= BANNER_LENGTH_MAX) {
+            break;
+        }
+        if(expiry_ts < vxssh_get_time()) {
+            err = ETIME; goto out;
+        }
         if(!vxssh_fd_select_read(session->socfd, 1000)) {
             continue;
         }
-
-        rd = read(session->socfd, &ch, 1);
-        if(rd == 1) {
-            if(ch == '\n' || pos >= bsz) { break; }
-            if(ch == '\r') { continue; }
-            buf[pos++] = ch;
+        if((rd = vxssh_session_rx_fill(session)) <= 0) {
+            err = EPROTO; goto out;
         }
     }
+    if(eol == NULL) {
+        err = (vxssh_server_is_shutdown() ? ERROR : EPROTO);
+        goto out;
+    }
 
-    if(err == OK) {
-        if(pos >= 7) {
-            kex->client_version = (kex->client_version_len > 0 ? vxssh_mem_realloc(kex->client_version, pos) : vxssh_mem_alloc(pos, NULL));
-            if(kex->client_version == NULL) { return ENOMEM; }
-            kex->client_version_len = pos;
-            memcpy(kex->client_version, (char *)buf, pos);
-            /* is 2.0 */
-            err = (strncmp("SSH-2.0", (char *)buf, 7) == 0 ? OK : EPROTO);
-        } else {
-            err = EPROTO;
-        }
+    pos = (eol - line);
+    rx->pos += pos + 1;
+    if(pos > 0 && line[pos - 1] == '\r') {
+        pos--;
     }
+    if(pos < 7) {
+        err = EPROTO; goto out;
+    }
+    vxssh_mem_deref(kex->client_version);
+    if((kex->client_version = vxssh_mem_arena_zalloc(session->arena, pos, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    kex->client_version_len = pos;
+    memcpy(kex->client_version, line, pos);
+
+    /* is 2.0 */
+    err = (strncmp("SSH-2.0", (char *)line, 7) == 0 ? OK : EPROTO);
 
+out:
+    vxssh_mem_deref(mbuf);
     return err;
 }
-
-
@@ -7,27 +7,32 @@
 
 /**
  * curve25519
- *
+ * ECDH_INIT (mbuf is positioned at the message id) -> ECDH_REPLY, NEWKEYS
+ * the s2c direction is on the new keys when it returns
  **/
-int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
+int vxssh_packet_kexecdh_reply(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
     vxssh_server_runtime_t *rt = vxssh_server_get_runtime();
     vxssh_kex_t *kex = (session ? session->kex : NULL);
-    vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
     int err = OK;
     size_t hash_len, dh_shared_key_len, dh_client_pub_key_len;
-    vxssh_mbuf_t *hk_blob = NULL, *sign_blob = NULL;
-    vxssh_crypto_object_t *signature;
+    vxssh_mbuf_t *hk_blob = NULL;
+    vxssh_mbuf_t *sign_blob = NULL;
+    vxssh_crypto_object_t *signature = NULL;
     uint8_t *dh_client_pub_key = NULL;
     uint8_t *dh_shared_key = NULL;
     uint8_t *hash = NULL;
     uint8_t dh_server_prv_key[CRYPTO_CURVE25519_SIZE];
     uint8_t dh_server_pub_key[CRYPTO_CURVE25519_SIZE];
+    uint8_t ed_sig[CRYPTO_ED25519_SIGNATURE_SIZE];
+    bool ed25519;
 
-    if(!session || !kex) {
+    if(!session || !kex || !mbuf || !rt || !kex->server_key_algorithm) {
         return EINVAL;
     }
-    if((err = vxssh_mbuf_alloc(&hk_blob, 512)) != OK) {
-        goto out;
+    ed25519 = (kex->server_key_algorithm->type == CRYPTO_OBJECT_ED25519_PRIVATE_KEY);
+    hk_blob = (ed25519 ? rt->server_key_ed25519_blob : rt->server_key_blob);
+    if(!hk_blob) {
+        return EINVAL;
     }
     if((err = vxssh_mbuf_alloc(&sign_blob, 255)) != OK) {
         goto out;
@@ -36,10 +41,7 @@ int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
     vxssh_kex_c25519_keygen(dh_server_prv_key, dh_server_pub_key);
 
     /* --- SSH2_MSG_KEX_ECDH_INIT --- */
-    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
-        goto out;
-    }
-    if(err = vxssh_packet_expect(mbuf, SSH2_MSG_KEX_ECDH_INIT) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH2_MSG_KEX_ECDH_INIT)) != OK) {
         goto out;
     }
     /* Q_C */
@@ -48,25 +50,24 @@ int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
         vxssh_log_warn("invalid Q_C len: %i", dh_client_pub_key_len);
         err = ERROR; goto out;
     }
-    if((dh_client_pub_key = vxssh_mem_zalloc(dh_client_pub_key_len, NULL)) == NULL) {
+    if((dh_client_pub_key = vxssh_mem_arena_scope_zalloc(session->arena, dh_client_pub_key_len, NULL)) == NULL) {
         err = ENOMEM;
         goto out;
     }
     if((err = vxssh_mbuf_read_mem(mbuf, dh_client_pub_key, &dh_client_pub_key_len)) != OK) {
         goto out;
     }
+    /* the multiplication and the signature yield to other tasks */
+    vxssh_crypto_budget_begin();
+
     /* make shared secret */
     vxssh_kex_c25519_shared_key(dh_server_prv_key, dh_client_pub_key, &dh_shared_key, &dh_shared_key_len);
-    // hostkey
-    if((err = vxssh_rsa_encode_public_key2(hk_blob, (vxssh_crypto_rsa_private_key_t *)rt->server_key->obj)) != OK) {
-        goto out;
-    }
     /* calc H */
     if((hash_len = vxssh_digest_bytes(kex->hash_alg)) == 0) {
         err = ERROR;
         goto out;
     }
-    if((hash = vxssh_mem_zalloc(hash_len, NULL)) == NULL)  {
+    if((hash = vxssh_mem_arena_scope_zalloc(session->arena, hash_len, NULL)) == NULL)  {
         err = ENOMEM;
         goto out;
     }
@@ -76,23 +77,36 @@ int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
         kex->server_version, kex->server_version_len,
         kex->client_kex_init, kex->client_kex_init_len,
         kex->server_kex_init, kex->server_kex_init_len,
-        hk_blob->buf, hk_blob->pos,
+        hk_blob->buf, hk_blob->end,
         dh_client_pub_key, dh_server_pub_key,
         dh_shared_key, dh_shared_key_len,
         hash, hash_len)) != OK) {
             goto out;
         }
     /* sign hash */
-    if((err = vxssh_rsa_sign((vxssh_crypto_rsa_private_key_t *)rt->server_key->obj, hash, hash_len, &signature)) != OK) {
-        goto out;
-    }
-    if((err = vxssh_rsa_encode_signature(sign_blob, ((vxssh_crypto_rsa_signature_t *)signature->obj))) != OK) {
-        goto out;
+    if(ed25519) {
+        if((err = vxssh_ed25519_sign((vxssh_crypto_ed25519_private_key_t *)rt->server_key_ed25519->obj, hash, hash_len, ed_sig)) != OK) {
+            goto out;
+        }
+        vxssh_crypto_budget_end();
+
+        if((err = vxssh_ed25519_encode_signature(sign_blob, ed_sig)) != OK) {
+            goto out;
+        }
+    } else {
+        if((err = vxssh_rsa_sign((vxssh_crypto_rsa_private_key_t *)rt->server_key->obj, hash, hash_len, &signature)) != OK) {
+            goto out;
+        }
+        vxssh_crypto_budget_end();
+
+        if((err = vxssh_rsa_encode_signature(sign_blob, ((vxssh_crypto_rsa_signature_t *)signature->obj))) != OK) {
+            goto out;
+        }
     }
     /* copy session_id */
     if (kex->session_id == NULL) {
         kex->session_id_len = hash_len;
-        if((kex->session_id = vxssh_mem_alloc(kex->session_id_len, NULL)) == NULL) {
+        if((kex->session_id = vxssh_mem_arena_zalloc(session->arena, kex->session_id_len, NULL)) == NULL) {
             err = ENOMEM;
             goto out;
         }
@@ -108,7 +122,7 @@ int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
 
     /* --- SSH2_MSG_KEX_ECDH_REPLY --- */
     vxssh_packet_start(mbuf, SSH2_MSG_KEX_ECDH_REPLY);
-    vxssh_mbuf_write_mem_sz(mbuf, hk_blob->buf, hk_blob->pos);
+    vxssh_mbuf_write_mem_sz(mbuf, hk_blob->buf, hk_blob->end);
     vxssh_mbuf_write_mem_sz(mbuf, dh_server_pub_key, CRYPTO_CURVE25519_SIZE);
     vxssh_mbuf_write_mem_sz(mbuf, sign_blob->buf, sign_blob->pos);
     vxssh_packet_end(session, mbuf);
@@ -117,36 +131,68 @@ int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
         goto out;
     }
 
-    /* key derivation */
+    /* key derivation, the current keys stay active until NEWKEYS */
+    if((err = vxssh_kex_newkeys_realloc(kex)) != OK) {
+        goto out;
+    }
     if((err = vxssh_kex_derive_keys(kex, hash, hash_len, dh_shared_key, dh_shared_key_len)) != OK) {
         goto out;
     }
+    if((err = vxssh_kex_newkeys_init(kex)) != OK) {
+        goto out;
+    }
 
-    /* SSH_MSG_NEWKEYS */
+    /* SSH_MSG_NEWKEYS, everything after it goes with the new keys */
     vxssh_packet_start(mbuf, SSH_MSG_NEWKEYS);
     vxssh_packet_end(session, mbuf);
 
     if((err = vxssh_packet_send(session, mbuf)) != OK) {
         goto out;
     }
-    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
-        goto out;
-    }
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_NEWKEYS) != OK) {
+    if((err = vxssh_kex_newkeys_activate(kex, true)) != OK) {
         goto out;
     }
 
 out:
-    vxssh_mem_deref(hk_blob);
+    vxssh_crypto_budget_end();
     vxssh_mem_deref(sign_blob);
     vxssh_mem_deref(signature);
     vxssh_mem_deref(dh_shared_key);
     vxssh_mem_deref(dh_client_pub_key);
     vxssh_mem_deref(hash);
 
-#ifdef VXSSH_CLEAR_MEMORY_ON_DEREF
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
     explicit_bzero(dh_server_prv_key, sizeof(dh_server_prv_key));
 #endif
 
     return err;
 }
+
+/**
+ * the initial exchange
+ **/
+int vxssh_packet_io_kexecdh(vxssh_session_t *session, int timeout) {
+    vxssh_kex_t *kex = (session ? session->kex : NULL);
+    vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
+    int err = OK;
+
+    if(!session || !kex) {
+        return EINVAL;
+    }
+    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_packet_kexecdh_reply(session, mbuf)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_NEWKEYS)) != OK) {
+        goto out;
+    }
+    err = vxssh_kex_newkeys_activate(kex, false);
+
+out:
+    return err;
+}
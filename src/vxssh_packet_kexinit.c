@@ -4,77 +4,80 @@
  * https://akscf.org/
  **/
 #include "vxssh.h"
+#include "vxssh_str.h"
 #define COOKIE_LENGTH 16
 
+/* the first name of the client list, that's what a guessed packet is based on */
+static bool is_client_first_choice(vxssh_mbuf_t *mbuf, size_t blen, const char *name) {
+    const char *buf = (void *) mbuf->buf + mbuf->pos;
+    const char *s = NULL;
+    int slen = 0;
+
+    s = vxssh_str_split(buf, blen, ',', &slen);
+    return (s != NULL && slen > 0 && vxssh_str_equal(s, slen, name, strlen(name)));
+}
+
 // -----------------------------------------------------------------------------------------------------------------
 // public
 // -----------------------------------------------------------------------------------------------------------------
 /**
- *
+ * build the server KEXINIT packet in mbuf (ready to send),
+ * the name-lists are prepared at server init, only the cookie is new.
+ * The payload is kept for the exchange hash.
  **/
-int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
+int vxssh_packet_kexinit_build(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
+    vxssh_server_runtime_t *rt = vxssh_server_get_runtime();
     vxssh_kex_t *kex = (session ? session->kex : NULL);
-    vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
     char cookie[COOKIE_LENGTH];
-    int err = OK;
-    uint32_t itmp;
-    vxssh_mbuf_t *tmbuf = NULL;
-    //
-    if(!session || !kex) {
+    size_t len;
+
+    if(!session || !kex || !mbuf) {
         return EINVAL;
     }
-    if((err = vxssh_mbuf_alloc(&tmbuf, 512)) != OK) {
-        goto out;
+    if(!rt || !rt->kexinit) {
+        return ERROR;
     }
-    /* --- send --- */
     vxssh_packet_start(mbuf, SSH_MSG_KEXINIT);
-    /* cookie */
     vxssh_rnd_bin((char *)cookie, COOKIE_LENGTH);
     vxssh_mbuf_write_mem(mbuf, (uint8_t *)cookie, COOKIE_LENGTH);
-    /* kex algorithms */
-    vxssh_neg_get_kex_algorithms(tmbuf, true);
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);
-    /* server host key algorithms */
-    vxssh_neg_get_server_key_algorithms(tmbuf, true);
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);
-    /* encryption algorithms */
-    vxssh_neg_get_cipher_algorithms(tmbuf, true);
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // client to server
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // server to client
-    /* mac algorithms */
-    vxssh_neg_get_mac_algorithms(tmbuf, true);
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // client to server
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // server to client
-    /* comression */
-    vxssh_neg_get_compression_algorithms(tmbuf, true);
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // client to server
-    vxssh_mbuf_write_mbuf_sz(mbuf, tmbuf);   // server to client
-    /* other fields */
-    vxssh_mbuf_write_str_sz(mbuf, "");     // languages client to server
-    vxssh_mbuf_write_str_sz(mbuf, "");     // languages server to client
-    vxssh_mbuf_write_u8(mbuf, 0);          // kex first packet follows
-    vxssh_mbuf_write_u32(mbuf, 0);         // reserved
-    /* copy payload */
-    kex->server_kex_init_len = (mbuf->end - 5);
-    kex->server_kex_init = (kex->server_kex_init ? vxssh_mem_realloc(kex->server_kex_init, kex->server_kex_init_len) : vxssh_mem_alloc(kex->server_kex_init_len, NULL));
-    if(kex->server_kex_init == NULL) { err = ENOMEM; goto out; }
-    memcpy(kex->server_kex_init, (mbuf->buf + 5), kex->server_kex_init_len);
-    // -------------------
-    vxssh_packet_end(session, mbuf);
-    if((err = vxssh_packet_send(session, mbuf)) != OK) {
-        goto out;
+    vxssh_mbuf_write_mem(mbuf, rt->kexinit->buf, rt->kexinit->end);
+
+    /* copy payload, it lives in the handshake scope */
+    len = (mbuf->end - 5);
+    if(kex->server_kex_init == NULL || kex->server_kex_init_len != len) {
+        vxssh_mem_deref(kex->server_kex_init);
+        if((kex->server_kex_init = vxssh_mem_arena_scope_zalloc(session->arena, len, NULL)) == NULL) {
+            kex->server_kex_init_len = 0;
+            return ENOMEM;
+        }
+        kex->server_kex_init_len = len;
     }
-    /* --- receicve --- */
-    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
-        goto out;
+    memcpy(kex->server_kex_init, (mbuf->buf + 5), len);
+
+    return vxssh_packet_end(session, mbuf);
+}
+
+/**
+ * client KEXINIT, mbuf is positioned at the message id
+ * (used by the initial exchange and by the rekey in the work loop)
+ **/
+int vxssh_packet_kexinit_parse(vxssh_session_t *session, vxssh_mbuf_t *mbuf) {
+    vxssh_kex_t *kex = (session ? session->kex : NULL);
+    int err = OK;
+    uint32_t itmp;
+    bool guess_ok = true;
+    //
+    if(!session || !kex || !mbuf) {
+        return EINVAL;
     }
-    if(err = vxssh_packet_expect(mbuf, SSH_MSG_KEXINIT) != OK) {
+    if((err = vxssh_packet_expect(mbuf, SSH_MSG_KEXINIT)) != OK) {
         goto out;
     }
     /* copy payload */
+    vxssh_mem_deref(kex->client_kex_init);
     kex->client_kex_init_len = (mbuf->end - 5);
-    kex->client_kex_init = (kex->client_kex_init ? vxssh_mem_realloc(kex->client_kex_init, kex->client_kex_init_len) : vxssh_mem_alloc(kex->client_kex_init_len, NULL));
-    if(kex->client_kex_init == NULL) { err = ENOMEM; goto out; }
+    kex->client_kex_init = vxssh_mem_arena_scope_zalloc(session->arena, kex->client_kex_init_len, NULL);
+    if(kex->client_kex_init == NULL) { kex->client_kex_init_len = 0; err = ENOMEM; goto out; }
     memcpy(kex->client_kex_init, (mbuf->buf + 5), kex->client_kex_init_len);
     // -------------------
 
@@ -88,6 +91,7 @@ int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
             vxssh_log_warn("kex-init: no matching key exchange method found");
             err = ERROR; goto out;
         }
+        guess_ok = guess_ok && is_client_first_choice(mbuf, itmp, kex->kex_algorithm->name);
         vxssh_mbuf_set_pos(mbuf, mbuf->pos + itmp);
     }
 
@@ -98,6 +102,7 @@ int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
             vxssh_log_warn("kex-init: no matching host key type found");
             err = ERROR; goto out;
         }
+        guess_ok = guess_ok && is_client_first_choice(mbuf, itmp, kex->server_key_algorithm->name);
         vxssh_mbuf_set_pos(mbuf, mbuf->pos + itmp);
     }
 
@@ -171,8 +176,15 @@ int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
         vxssh_mbuf_set_pos(mbuf, mbuf->pos + itmp);
     }
 
-    /* first follows */
-    kex->first_follows = vxssh_mbuf_read_u32(mbuf);
+    /* first follows (boolean) + reserved */
+    kex->first_follows = (vxssh_mbuf_read_u8(mbuf) != 0);
+    vxssh_mbuf_read_u32(mbuf);
+
+    /*
+     * RFC 4253, 7: a guessed packet based on a wrong guess is silently ignored,
+     * a right one is the first kex packet and will be read by the kex method
+     */
+    kex->fl_wrong_guess = (kex->first_follows && !guess_ok);
 
     /* */
     kex->hash_alg = kex->kex_algorithm->hash_alg;
@@ -192,7 +204,48 @@ int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
 #endif
 
 out:
-    vxssh_mem_deref(tmbuf);
+    return err;
+}
+
+/**
+ * the initial exchange
+ **/
+int vxssh_packet_io_kexinit(vxssh_session_t *session, int timeout) {
+    vxssh_kex_t *kex = (session ? session->kex : NULL);
+    vxssh_mbuf_t *mbuf = (session ? session->iobuf : NULL);
+    int err = OK;
     //
+    if(!session || !kex) {
+        return EINVAL;
+    }
+    /* --- send (unless it went out with the banner) --- */
+    if(!kex->fl_kexinit_sent) {
+        if((err = vxssh_packet_kexinit_build(session, mbuf)) != OK) {
+            goto out;
+        }
+        if((err = vxssh_packet_send(session, mbuf)) != OK) {
+            goto out;
+        }
+    }
+    kex->fl_kexinit_sent = false;
+
+    /* --- receicve --- */
+    if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_packet_kexinit_parse(session, mbuf)) != OK) {
+        goto out;
+    }
+    if(kex->fl_wrong_guess) {
+#ifdef VXSSH_DEBUG_KEX_INIT
+        vxssh_log_debug("kex-init: wrong guess, the next packet is ignored");
+#endif
+        kex->fl_wrong_guess = false;
+        if((err = vxssh_packet_receive(session, mbuf, timeout)) != OK) {
+            goto out;
+        }
+    }
+
+out:
     return err;
 }
@@ -13,10 +13,15 @@ static  void mem_destructor_vxssh_session_t(void *data) {
     }
 
     vxssh_mem_deref(session->iobuf);
+    vxssh_mem_deref(session->rxbuf);
+    vxssh_mem_deref(session->defer);
     vxssh_mem_deref(session->kex);
     vxssh_mem_deref(session->peerip);
     vxssh_mem_deref(session->username);
     vxssh_mem_deref(session->channel);
+
+    /* the objects above may be in it */
+    vxssh_mem_deref(session->arena);
 }
 
 // ----------------------------------------------------------------------------------------------------------------------------------------
@@ -41,9 +46,18 @@ int vxssh_session_alloc(vxssh_session_t **session) {
     tses->recv_seq = 0;
     tses->send_seq = 0;
 
+    /* the initial handshake starts right away */
+    if((err = vxssh_mem_arena_alloc(&tses->arena, VXSSH_SESSION_ARENA_SIZE)) != OK) {
+        goto out;
+    }
+    vxssh_mem_arena_scope_begin(tses->arena);
+
     if((err = vxssh_mbuf_alloc(&tses->iobuf, 2048)) != OK) {
         goto out;
     }
+    if((err = vxssh_mbuf_alloc(&tses->rxbuf, VXSSH_SESSION_RXBUF_SIZE)) != OK) {
+        goto out;
+    }
 
     if((err = vxssh_kex_alloc(&tses->kex)) != OK) {
         err = ENOMEM;
@@ -69,7 +83,7 @@ int vxssh_session_set_peerip(vxssh_session_t *session, char *ip) {
         return EINVAL;
     }
 
-    if((session->peerip = vxssh_mem_zalloc(len + 1, NULL)) == NULL) {
+    if((session->peerip = vxssh_mem_arena_zalloc(session->arena, len + 1, NULL)) == NULL) {
         return ENOMEM;
     }
 
@@ -78,3 +92,54 @@ int vxssh_session_set_peerip(vxssh_session_t *session, char *ip) {
     return OK;
 }
 
+/**
+ * bytes read ahead and not consumed yet
+ **/
+size_t vxssh_session_rx_pending(vxssh_session_t *session) {
+    if(!session || !session->rxbuf) {
+        return 0;
+    }
+    return (session->rxbuf->end - session->rxbuf->pos);
+}
+
+/**
+ * read as much as the socket has (up to the buffer space) in one call,
+ * returns the result of read()
+ **/
+int vxssh_session_rx_fill(vxssh_session_t *session) {
+    vxssh_mbuf_t *rx = (session ? session->rxbuf : NULL);
+    int rd;
+
+    if(!rx) {
+        return ERROR;
+    }
+    if(rx->pos > 0) {
+        memmove(rx->buf, rx->buf + rx->pos, rx->end - rx->pos);
+        rx->end -= rx->pos;
+        rx->pos = 0;
+    }
+    if(rx->end >= rx->size) {
+        return 0;
+    }
+    if((rd = read(session->socfd, (char *) rx->buf + rx->end, rx->size - rx->end)) > 0) {
+        rx->end += rd;
+    }
+    return rd;
+}
+
+/**
+ * read(), the read ahead data goes first
+ **/
+int vxssh_session_read(vxssh_session_t *session, void *buf, size_t size) {
+    size_t n = vxssh_session_rx_pending(session);
+
+    if(n > 0) {
+        if(n > size) {
+            n = size;
+        }
+        memcpy(buf, session->rxbuf->buf + session->rxbuf->pos, n);
+        session->rxbuf->pos += n;
+        return n;
+    }
+    return read(session->socfd, (char *) buf, size);
+}
@@ -5,6 +5,8 @@
  * Copyright (C) AlexandrinKS
  * https://akscf.org/
  **/
+#include <tickLib.h>
+#include <sysLib.h>
 #include "vxssh.h"
 
 LOCAL vxssh_server_runtime_t *server_runtime = NULL;
@@ -14,6 +16,12 @@ LOCAL void em_sshd_sesion_task(vxssh_session_t *);
 LOCAL void mem_destructor_vxssh_server_runtime_t(void *data) {
     vxssh_server_runtime_t *rt = data;
     //
+    if(rt->keygen_tid) {
+        rt->fl_keygen_stop = true;
+        while(rt->keygen_tid && taskIdVerify(rt->keygen_tid) == OK) {
+            taskDelay(1);
+        }
+    }
     if(rt->srv_sock) {
         close(rt->srv_sock);
     }
@@ -26,6 +34,144 @@ LOCAL void mem_destructor_vxssh_server_runtime_t(void *data) {
     if(rt->user_key) {
         vxssh_mem_deref(rt->user_key);
     }
+    vxssh_mem_deref(rt->server_key_ed25519);
+    vxssh_mem_deref(rt->server_key_blob);
+    vxssh_mem_deref(rt->server_key_ed25519_blob);
+    vxssh_mem_deref(rt->kexinit);
+    vxssh_kex_c25519_pool_stop();
+    vxssh_mem_deref(rt->server_key_pending);
+    vxssh_mem_deref(rt->server_key_file);
+}
+
+/**
+ * K_S of the rsa key and ssh-rsa in the negotiation
+ **/
+LOCAL int server_set_rsa_key(vxssh_server_runtime_t *rt) {
+    int err = OK;
+
+    rt->server_key_blob = vxssh_mem_deref(rt->server_key_blob);
+    if((err = vxssh_mbuf_alloc(&rt->server_key_blob, 512)) != OK) {
+        return err;
+    }
+    if((err = vxssh_rsa_encode_public_key2(rt->server_key_blob, (vxssh_crypto_rsa_private_key_t *)rt->server_key->obj)) != OK) {
+        vxssh_log_error("couldn't encode server key (%i)", err);
+        return err;
+    }
+    vxssh_neg_enable_server_key_algorithm(CRYPTO_OBJECT_RSA_PRIVATE_KEY, true);
+    return OK;
+}
+
+/**
+ * ENOENT if there is no key file yet
+ **/
+LOCAL int server_key_file_load(const char *path, vxssh_crypto_object_t **key) {
+    vxssh_mbuf_t *mb = NULL;
+    int fd, rd, err = OK;
+
+    if((fd = open(path, O_RDONLY, 0)) == ERROR) {
+        return ENOENT;
+    }
+    if((err = vxssh_mbuf_alloc(&mb, 1024)) != OK) {
+        goto out;
+    }
+    while((rd = read(fd, (char *)mb->buf + mb->end, mb->size - mb->end)) > 0) {
+        mb->end += rd;
+        if(mb->end == mb->size && (err = vxssh_mbuf_resize(mb, mb->size * 2)) != OK) {
+            goto out;
+        }
+    }
+    err = vxssh_rsa_key_load(mb, key);
+out:
+    close(fd);
+    if(mb) {
+        vxssh_mbuf_clear(mb);
+    }
+    vxssh_mem_deref(mb);
+    return err;
+}
+
+LOCAL int server_key_file_save(const char *path, vxssh_crypto_object_t *key) {
+    vxssh_mbuf_t *mb = NULL;
+    int fd, err = OK;
+
+    if((err = vxssh_mbuf_alloc(&mb, 1024)) != OK) {
+        return err;
+    }
+    if((err = vxssh_rsa_key_save(mb, (vxssh_crypto_rsa_private_key_t *)key->obj)) != OK) {
+        goto out;
+    }
+    if((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == ERROR) {
+        vxssh_log_error("couldn't create %s (%i)", path, errno);
+        err = ERROR; goto out;
+    }
+    if(write(fd, (char *)mb->buf, mb->end) != mb->end) {
+        vxssh_log_error("couldn't write %s (%i)", path, errno);
+        err = ERROR;
+    }
+    close(fd);
+out:
+    vxssh_mbuf_clear(mb);
+    vxssh_mem_deref(mb);
+    return err;
+}
+
+LOCAL int server_keygen_progress(int stage, uint32_t count, void *udata) {
+    if(server_runtime->fl_keygen_stop || server_runtime->fl_do_shutdown) {
+        return ERROR;
+    }
+    if(stage == VXSSH_RSA_KEYGEN_STAGE_PRIME) {
+        vxssh_log_debug("host key: prime %u of 2 found", count);
+    } else if(stage == VXSSH_RSA_KEYGEN_STAGE_CANDIDATE && (count % 100) == 0) {
+        vxssh_log_debug("host key: %u candidates tested", count);
+    }
+    return OK;
+}
+
+/**
+ * first start: the rsa host key is generated at the lowest priority and saved,
+ * the connection manager picks it up
+ **/
+LOCAL int server_keygen_task() {
+    vxssh_crypto_object_t *key = NULL;
+    int err;
+
+    vxssh_log_debug("host key: generating %i-bit rsa key...", server_runtime->server_key_bits);
+    if((err = vxssh_rsa_generate_key(&key, server_runtime->server_key_bits, server_keygen_progress, NULL)) != OK) {
+        vxssh_log_error("host key: generation fail (%i)", err);
+        goto out;
+    }
+    if(server_key_file_save(server_runtime->server_key_file, key) != OK) {
+        vxssh_log_warn("host key: couldn't be saved, it'll be generated again on the next start");
+    }
+    semTake(server_runtime->sem, WAIT_FOREVER);
+    server_runtime->server_key_pending = key;
+    semGive(server_runtime->sem);
+    vxssh_log_debug("host key: ready");
+out:
+    server_runtime->keygen_tid = 0;
+    exit(OK);
+}
+
+/**
+ * the connection manager with no sessions running: the generated key replaces nothing,
+ * it's added to the negotiation
+ **/
+LOCAL void server_install_pending_key() {
+    vxssh_crypto_object_t *key;
+
+    semTake(server_runtime->sem, WAIT_FOREVER);
+    key = server_runtime->server_key_pending;
+    server_runtime->server_key_pending = NULL;
+    semGive(server_runtime->sem);
+
+    vxssh_mem_deref(server_runtime->server_key);
+    server_runtime->server_key = key;
+    if(server_set_rsa_key(server_runtime) != OK) {
+        server_runtime->server_key = vxssh_mem_deref(server_runtime->server_key);
+        vxssh_neg_enable_server_key_algorithm(CRYPTO_OBJECT_RSA_PRIVATE_KEY, false);
+    }
+    vxssh_mbuf_clear(server_runtime->kexinit);
+    vxssh_neg_get_kexinit(server_runtime->kexinit);
 }
 
 // ----------------------------------------------------------------------------------------------------------------------------------------
@@ -111,14 +257,20 @@ STATUS vxssh_server_init(vxssh_server_config_t *config) {
         return EINVAL;
     }
     /* init submodules */
+    if(vxssh_mem_pool_init(config->mem_pool_size) != OK) {
+        vxssh_log_warn("mem pool init fail, objects will be allocated by malloc");
+    }
     vxssh_rnd_init();
+    if(vxssh_curve25519_base_init() != OK) {
+        vxssh_log_warn("curve25519: no memory for the fixed-base table, keygen will use the ladder");
+    }
 
     /* check options */
     if((server_runtime = vxssh_mem_zalloc(sizeof(vxssh_server_runtime_t), mem_destructor_vxssh_server_runtime_t)) == NULL) {
         return ENOMEM;
     }
-    if(config->server_key == NULL) {
-        vxssh_log_error("server_key should be set");
+    if(config->server_key == NULL && config->server_key_file == NULL && config->server_key_ed25519 == NULL) {
+        vxssh_log_error("server_key, server_key_file or server_key_ed25519 should be set");
         err = ERROR; goto out;
     }
     if(config->user_key == NULL && (config->auth_type == VXSSH_AUTH_PUBKEY || config->auth_type == VXSSH_AUTH_BOTH)) {
@@ -129,11 +281,34 @@ STATUS vxssh_server_init(vxssh_server_config_t *config) {
         vxssh_log_error("invalid listen_address");
         err = ERROR; goto out;
     }
-    /* preload server key */
-    err = vxssh_pem_decode(config->server_key, strlen(config->server_key), NULL, &server_runtime->server_key);
-    if(err != OK || server_runtime->server_key->type != CRYPTO_OBJECT_RSA_PRIVATE_KEY) {
-        vxssh_log_error("couldn't decode server key (%i)", err);
-        goto out;
+    /* preload server keys */
+    vxssh_neg_enable_server_key_algorithm(CRYPTO_OBJECT_RSA_PRIVATE_KEY, false);
+    vxssh_neg_enable_server_key_algorithm(CRYPTO_OBJECT_ED25519_PRIVATE_KEY, false);
+    if(config->server_key) {
+        err = vxssh_pem_decode(config->server_key, strlen(config->server_key), NULL, &server_runtime->server_key);
+        if(err != OK || server_runtime->server_key->type != CRYPTO_OBJECT_RSA_PRIVATE_KEY) {
+            vxssh_log_error("couldn't decode server key (%i)", err);
+            err = (err != OK ? err : EINVAL); goto out;
+        }
+    } else if(config->server_key_file) {
+        if((err = server_key_file_load(config->server_key_file, &server_runtime->server_key)) != OK) {
+            if(err != ENOENT) {
+                vxssh_log_warn("couldn't load %s (%i), a new key will be generated", config->server_key_file, err);
+            }
+            if((server_runtime->server_key_file = vxssh_mem_zalloc(strlen(config->server_key_file) + 1, NULL)) == NULL) {
+                err = ENOMEM; goto out;
+            }
+            strcpy(server_runtime->server_key_file, config->server_key_file);
+            server_runtime->server_key_bits = (config->server_key_bits > 0 ? config->server_key_bits : VXSSH_RSA_KEYGEN_BITS);
+            err = OK;
+        }
+    }
+    if(config->server_key_ed25519) {
+        err = vxssh_pem_decode(config->server_key_ed25519, strlen(config->server_key_ed25519), NULL, &server_runtime->server_key_ed25519);
+        if(err != OK || server_runtime->server_key_ed25519->type != CRYPTO_OBJECT_ED25519_PRIVATE_KEY) {
+            vxssh_log_error("couldn't decode server ed25519 key (%i)", err);
+            err = (err != OK ? err : EINVAL); goto out;
+        }
     }
     /* preload user key */
     if(config->auth_type == VXSSH_AUTH_PUBKEY || config->auth_type == VXSSH_AUTH_BOTH) {
@@ -144,6 +319,29 @@ STATUS vxssh_server_init(vxssh_server_config_t *config) {
         }
     }
 
+    /* the parts of the key exchange that don't change */
+    if(server_runtime->server_key) {
+        if((err = server_set_rsa_key(server_runtime)) != OK) {
+            goto out;
+        }
+    }
+    if(server_runtime->server_key_ed25519) {
+        if((err = vxssh_mbuf_alloc(&server_runtime->server_key_ed25519_blob, 64)) != OK) {
+            goto out;
+        }
+        if((err = vxssh_ed25519_encode_public_key(server_runtime->server_key_ed25519_blob, (vxssh_crypto_ed25519_private_key_t *)server_runtime->server_key_ed25519->obj)) != OK) {
+            vxssh_log_error("couldn't encode server ed25519 key (%i)", err);
+            goto out;
+        }
+        vxssh_neg_enable_server_key_algorithm(CRYPTO_OBJECT_ED25519_PRIVATE_KEY, true);
+    }
+    if((err = vxssh_mbuf_alloc(&server_runtime->kexinit, 512)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_neg_get_kexinit(server_runtime->kexinit)) != OK) {
+        goto out;
+    }
+
 #ifdef VXSSH_DEBUG_HOST_KEY
     if(server_runtime->server_key) {
         vxssh_crypto_rsa_private_key_t *pkey = server_runtime->server_key->obj;
@@ -162,6 +360,9 @@ STATUS vxssh_server_init(vxssh_server_config_t *config) {
     server_runtime->sessions_max = 1;
     server_runtime->auth_tries_max = VXSSH_AUTH_TRIES_MAX;
     server_runtime->auth_type = config->auth_type;
+    server_runtime->rekey_bytes = (config->rekey_bytes > 0 ? config->rekey_bytes : VXSSH_REKEY_BYTES);
+    server_runtime->rekey_packets = (config->rekey_packets > 0 ? config->rekey_packets : VXSSH_REKEY_PACKETS);
+    server_runtime->rekey_seconds = (config->rekey_seconds > 0 ? config->rekey_seconds : VXSSH_REKEY_SECONDS);
     server_runtime->srv_addr.sin_family = AF_INET;
     server_runtime->srv_addr.sin_port = htons(config->listen_port <= 0 ? VXSSH_DEFAULT_PORT : config->listen_port);
     server_runtime->srv_addr.sin_addr.s_addr = (strcmp(config->listen_address, "0.0.0.0") == 0 ? htonl(INADDR_ANY) : inet_addr(config->listen_address));
@@ -170,6 +371,21 @@ STATUS vxssh_server_init(vxssh_server_config_t *config) {
         vxssh_log_error("semMCreate() fail");
         err = ERROR; goto out;
     }
+    if(vxssh_crypto_budget_set((config->crypto_run_ticks > 0 ? config->crypto_run_ticks : VXSSH_CRYPTO_BUDGET_RUN_TICKS),
+                               (config->crypto_slice_ticks > 0 ? config->crypto_slice_ticks : VXSSH_CRYPTO_BUDGET_SLICE_TICKS)) != OK) {
+        vxssh_log_error("invalid crypto budget");
+        err = ERROR; goto out;
+    }
+    if(vxssh_kex_c25519_pool_start() != OK) {
+        vxssh_log_warn("curve25519: keypair pool start fail, keys will be generated inline");
+    }
+    if(server_runtime->server_key_file) {
+        if((server_runtime->keygen_tid = taskSpawn("sshd_keygen", VXSSH_RSA_KEYGEN_PRIORITY, 0, 8192, (FUNCPTR) server_keygen_task, 0,0,0,0,0,0,0,0,0,0)) == ERROR) {
+            server_runtime->keygen_tid = 0;
+            vxssh_log_error("sshd_keygen spawn fail: %i", errno);
+            err = ERROR; goto out;
+        }
+    }
 
 out:
     if(err != OK) {
@@ -271,6 +487,14 @@ LOCAL void vxssh_connection_mgr_task() {
             struct sockaddr_in paddr;
             int csz = sizeof(struct sockaddr_in);
 
+            if(server_runtime->server_key_pending && server_runtime->sessions == 0) {
+                server_install_pending_key();
+            }
+            if(!server_runtime->server_key && !server_runtime->server_key_ed25519) {
+                vxssh_log_warn("host key isn't ready yet");
+                close(cli_sock);
+                continue;
+            }
             if(server_runtime->sessions >= server_runtime->sessions_max) {
                 vxssh_log_warn("too many active sessions (%i)", server_runtime->sessions);
                 close(cli_sock);
@@ -301,7 +525,7 @@ LOCAL void vxssh_connection_mgr_task() {
             server_runtime->session = session;
             semGive(server_runtime->sem);
 
-            if(taskSpawn("sshd_sess", 200, 0, 16384, (FUNCPTR) em_sshd_sesion_task, (int)session, 0,0,0,0,0,0,0,0,0) != ERROR) {
+            if(taskSpawn("sshd_sess", 200, 0, VXSSH_SESSION_STACK_SIZE, (FUNCPTR) em_sshd_sesion_task, (int)session, 0,0,0,0,0,0,0,0,0) != ERROR) {
                 continue;
             }
             vxssh_log_warn("sshd_sess spawn fail: %i", errno);
@@ -323,6 +547,60 @@ LOCAL void vxssh_connection_mgr_task() {
     exit(OK);
 }
 
+/* counters of the current keys */
+LOCAL void rekey_reset(vxssh_session_t *session) {
+    session->rekey_state = VXSSH_REKEY_STATE_NONE;
+    session->rekey_bytes = 0;
+    session->rekey_packets = 0;
+    session->rekey_ticks = tickGet();
+}
+
+LOCAL bool rekey_is_due(vxssh_session_t *session) {
+    if(session->rekey_bytes >= server_runtime->rekey_bytes) {
+        return true;
+    }
+    if(session->rekey_packets >= server_runtime->rekey_packets) {
+        return true;
+    }
+    return ((tickGet() - session->rekey_ticks) / sysClkRateGet() >= server_runtime->rekey_seconds);
+}
+
+/**
+ * the handshake objects go back with the scope,
+ * nothing of the kex may point into it after that
+ **/
+LOCAL void handshake_end(vxssh_session_t *session) {
+    vxssh_kex_t *kex = session->kex;
+
+    kex->client_kex_init = vxssh_mem_deref(kex->client_kex_init);
+    kex->client_kex_init_len = 0;
+    kex->server_kex_init = vxssh_mem_deref(kex->server_kex_init);
+    kex->server_kex_init_len = 0;
+    if(vxssh_mem_arena_scope_end(session->arena) != OK) {
+        vxssh_log_warn("session arena: the handshake scope is still in use");
+    }
+}
+
+LOCAL int rekey_send_kexinit(vxssh_session_t *session) {
+    int err = OK;
+
+    vxssh_mem_arena_scope_begin(session->arena);
+    if((err = vxssh_packet_kexinit_build(session, session->iobuf)) != OK) {
+        return err;
+    }
+    return vxssh_packet_send(session, session->iobuf);
+}
+
+/**
+ * idle session: a used rsa blinding pair is regenerated here,
+ * the signing itself only squares it
+ **/
+LOCAL void server_idle() {
+    if(server_runtime->server_key) {
+        vxssh_rsa_blinding_update((vxssh_crypto_rsa_private_key_t *)server_runtime->server_key->obj, false);
+    }
+}
+
 LOCAL void em_sshd_sesion_task(vxssh_session_t *session) {
     int err = OK;
     uint8_t msgid;
@@ -338,31 +616,20 @@ LOCAL void em_sshd_sesion_task(vxssh_session_t *session) {
     vxssh_log_debug("session started: %i (%s)", taskIdSelf(), session->peerip);
 #endif
 
-    session->fl_rekeying_done = false;
     session->fl_authorized = false;
 
-rekeying:
-#ifdef VXSSH_DEBUG_SESSION
-    vxssh_log_debug("session rekeing...");
-#endif
     /* kex */
     session->state = VXSSH_SESSION_STATE_NEG;
     if((err = vxssh_packet_io_kexinit(session, 20)) != OK) {
         vxssh_log_warn("kex-init fail (%i)", err);
         goto out;
     }
-
-    vxssh_kex_newkeys_realloc(session->kex);
-
     if((err = vxssh_packet_io_kexecdh(session, 20)) != OK) {
         vxssh_log_warn("kex-echg fail (%i)", err);
         goto out;
     }
 
-    vxssh_mem_deref(session->kex->client_kex_init);
-    vxssh_mem_deref(session->kex->server_kex_init);
-    vxssh_kex_newkeys_init(session->kex);
-    session->fl_rekeying_done = true;
+    rekey_reset(session);
 
     /* auth */
     if(!session->fl_authorized) {
@@ -373,15 +640,31 @@ rekeying:
         }
         session->fl_authorized = true;
     }
+    /* the initial scope also holds the auth strings */
+    handshake_end(session);
 
     session->state = VXSSH_SESSION_STATE_WORK;
 
-    /* session loop */
+    /*
+     * session loop
+     * rekey is a state of it: channel data keeps going on the current keys,
+     * the pty output and the channel replies are held between our KEXINIT and our NEWKEYS (RFC 4253, 7.1)
+     */
     while(true) {
         if(server_runtime->fl_do_shutdown) {
             break;
         }
-        if(session->channel) {
+        if(session->rekey_state == VXSSH_REKEY_STATE_NONE && rekey_is_due(session)) {
+#ifdef VXSSH_DEBUG_SESSION
+            vxssh_log_debug("session rekeying (bytes=%u, packets=%u)", (uint32_t)session->rekey_bytes, session->rekey_packets);
+#endif
+            if((err = rekey_send_kexinit(session)) != OK) {
+                vxssh_log_warn("rekey: kex-init fail (%i)", err);
+                break;
+            }
+            session->rekey_state = VXSSH_REKEY_STATE_KEXINIT_SENT;
+        }
+        if(session->channel && (session->rekey_state == VXSSH_REKEY_STATE_NONE || session->rekey_state == VXSSH_REKEY_STATE_WAIT_NEWKEYS)) {
             if(session->channel->fl_do_close) {
                 taskDelay(CLOCKS_PER_SEC / 2);
                 vxssh_packet_send_disconnect(session, SSH_DISCONNECT_PROTOCOL_ERROR, NULL);
@@ -397,7 +680,8 @@ rekeying:
             }
         }
 
-        if(!vxssh_fd_select_read(session->socfd, 250)) {
+        if(!vxssh_session_rx_pending(session) && !vxssh_fd_select_read(session->socfd, 250)) {
+            server_idle();
             continue;
         }
         err = vxssh_packet_receive(session, session->iobuf, 10);
@@ -411,11 +695,64 @@ rekeying:
             break;
         }
 
+        /* the client guessed the kex method wrong, drop its first packet */
+        if(session->rekey_state == VXSSH_REKEY_STATE_WAIT_ECDH_INIT && session->kex->fl_wrong_guess) {
+            session->kex->fl_wrong_guess = false;
+            continue;
+        }
+
         msgid = vxssh_mbuf_read_u8(session->iobuf);
         switch(msgid) {
             case SSH_MSG_KEXINIT: {
-                session->fl_rekeying_done = false;
-                goto rekeying;
+                if(session->rekey_state != VXSSH_REKEY_STATE_NONE && session->rekey_state != VXSSH_REKEY_STATE_KEXINIT_SENT) {
+                    vxssh_packet_send_disconnect(session, SSH_DISCONNECT_PROTOCOL_ERROR, NULL);
+                    goto out;
+                }
+                vxssh_mbuf_set_pos(session->iobuf, session->iobuf->pos - 1);
+                vxssh_mem_arena_scope_begin(session->arena);
+                if((err = vxssh_packet_kexinit_parse(session, session->iobuf)) != OK) {
+                    vxssh_log_warn("rekey: kex-init fail (%i)", err);
+                    goto out;
+                }
+                /* initiated by the client, answer with ours (iobuf is free now) */
+                if(session->rekey_state == VXSSH_REKEY_STATE_NONE) {
+                    if((err = rekey_send_kexinit(session)) != OK) {
+                        vxssh_log_warn("rekey: kex-init fail (%i)", err);
+                        goto out;
+                    }
+                }
+                session->rekey_state = VXSSH_REKEY_STATE_WAIT_ECDH_INIT;
+                break;
+            }
+            case SSH2_MSG_KEX_ECDH_INIT: {
+                if(session->rekey_state != VXSSH_REKEY_STATE_WAIT_ECDH_INIT) {
+                    vxssh_packet_send_disconnect(session, SSH_DISCONNECT_PROTOCOL_ERROR, NULL);
+                    goto out;
+                }
+                vxssh_mbuf_set_pos(session->iobuf, session->iobuf->pos - 1);
+                if((err = vxssh_packet_kexecdh_reply(session, session->iobuf)) != OK) {
+                    vxssh_log_warn("rekey: kex-echg fail (%i)", err);
+                    goto out;
+                }
+                session->rekey_state = VXSSH_REKEY_STATE_WAIT_NEWKEYS;
+
+                /* our NEWKEYS is out, the channel replies made meanwhile can follow */
+                if((err = vxssh_packet_send_channel_deferred(session)) != OK) {
+                    vxssh_log_warn("rekey: deferred replies fail (%i)", err);
+                    goto out;
+                }
+                break;
+            }
+            case SSH_MSG_NEWKEYS: {
+                if(session->rekey_state != VXSSH_REKEY_STATE_WAIT_NEWKEYS) {
+                    vxssh_packet_send_disconnect(session, SSH_DISCONNECT_PROTOCOL_ERROR, NULL);
+                    goto out;
+                }
+                if((err = vxssh_kex_newkeys_activate(session->kex, false)) != OK) {
+                    goto out;
+                }
+                handshake_end(session);
+                rekey_reset(session);
                 break;
             }
             case SSH_MSG_CHANNEL_OPEN: {
@@ -0,0 +1,130 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include <tickLib.h>
+#include <sysLib.h>
+#include "emssh.h"
+
+#define BENCH_BUF_SIZE  4096
+#define BENCH_ROUNDS    256
+
+typedef struct {
+    int     impl;
+    char    *name;
+} bench_impl_t;
+
+static const bench_impl_t SHA1_IMPLS[] = {
+    { VXSSH_SHA1_IMPL_REF,      "ref"      },
+    { VXSSH_SHA1_IMPL_C,        "c"        },
+    { VXSSH_SHA1_IMPL_SHANI,    "sha-ni"   },
+    { 0, NULL }
+};
+
+static const bench_impl_t SHA256_IMPLS[] = {
+    { VXSSH_SHA2_IMPL_REF,      "ref"      },
+    { VXSSH_SHA2_IMPL_UNROLLED, "unrolled" },
+    { VXSSH_SHA2_IMPL_SHANI,    "sha-ni"   },
+    { VXSSH_SHA2_IMPL_ARMV8,    "armv8"    },
+    { 0, NULL }
+};
+
+static void bench_report(char *alg, char *name, ULONG ticks) {
+    uint32_t ms = (ticks * 1000) / sysClkRateGet();
+    uint32_t kb = (BENCH_BUF_SIZE / 1024) * BENCH_ROUNDS;
+
+    vxssh_log_debug("%s/%s: %u KB in %u ms (%u KB/s)", alg, name, kb, ms, (ms ? (kb * 1000) / ms : 0));
+}
+
+/**
+ * Throughput of every available sha1 transform,
+ * each one is checked against the reference first
+ **/
+int vxssh_bench_sha1() {
+    uint8_t ref[VXSSH_DIGEST_SHA1_LENGTH];
+    uint8_t digest[VXSSH_DIGEST_SHA1_LENGTH];
+    uint8_t *buf = NULL;
+    const bench_impl_t *p;
+    int i, saved, err = OK;
+    ULONG t;
+
+    if((buf = vxssh_mem_alloc(BENCH_BUF_SIZE, NULL)) == NULL) {
+        return ENOMEM;
+    }
+    for(i = 0; i < BENCH_BUF_SIZE; i++) {
+        buf[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    saved = vxssh_sha1_get_impl();
+    vxssh_sha1_set_impl(VXSSH_SHA1_IMPL_REF);
+    vxssh_digest_memory(VXSSH_DIGEST_SHA1, buf, BENCH_BUF_SIZE, ref, sizeof(ref));
+
+    for(p = SHA1_IMPLS; p->name; p++) {
+        if(vxssh_sha1_set_impl(p->impl) != OK) {
+            vxssh_log_debug("sha1/%s: not available", p->name);
+            continue;
+        }
+        vxssh_digest_memory(VXSSH_DIGEST_SHA1, buf, BENCH_BUF_SIZE, digest, sizeof(digest));
+        if(memcmp(ref, digest, sizeof(ref))) {
+            vxssh_log_error("sha1/%s: digest mismatch", p->name);
+            err = ERROR;
+            continue;
+        }
+        t = tickGet();
+        for(i = 0; i < BENCH_ROUNDS; i++) {
+            vxssh_digest_memory(VXSSH_DIGEST_SHA1, buf, BENCH_BUF_SIZE, digest, sizeof(digest));
+        }
+        bench_report("sha1", p->name, tickGet() - t);
+    }
+
+    vxssh_sha1_set_impl(saved);
+    vxssh_mem_deref(buf);
+    return err;
+}
+
+/**
+ * Throughput of every available sha256 transform,
+ * each one is checked against the reference first
+ **/
+int vxssh_bench_sha256() {
+    uint8_t ref[VXSSH_DIGEST_SHA256_LENGTH];
+    uint8_t digest[VXSSH_DIGEST_SHA256_LENGTH];
+    uint8_t *buf = NULL;
+    const bench_impl_t *p;
+    int i, saved, err = OK;
+    ULONG t;
+
+    if((buf = vxssh_mem_alloc(BENCH_BUF_SIZE, NULL)) == NULL) {
+        return ENOMEM;
+    }
+    for(i = 0; i < BENCH_BUF_SIZE; i++) {
+        buf[i] = (uint8_t) (i * 7 + 3);
+    }
+
+    saved = vxssh_sha256_get_impl();
+    vxssh_sha256_set_impl(VXSSH_SHA2_IMPL_REF);
+    vxssh_digest_memory(VXSSH_DIGEST_SHA256, buf, BENCH_BUF_SIZE, ref, sizeof(ref));
+
+    for(p = SHA256_IMPLS; p->name; p++) {
+        if(vxssh_sha256_set_impl(p->impl) != OK) {
+            vxssh_log_debug("sha256/%s: not available", p->name);
+            continue;
+        }
+        vxssh_digest_memory(VXSSH_DIGEST_SHA256, buf, BENCH_BUF_SIZE, digest, sizeof(digest));
+        if(memcmp(ref, digest, sizeof(ref))) {
+            vxssh_log_error("sha256/%s: digest mismatch", p->name);
+            err = ERROR;
+            continue;
+        }
+        t = tickGet();
+        for(i = 0; i < BENCH_ROUNDS; i++) {
+            vxssh_digest_memory(VXSSH_DIGEST_SHA256, buf, BENCH_BUF_SIZE, digest, sizeof(digest));
+        }
+        bench_report("sha256", p->name, tickGet() - t);
+    }
+
+    vxssh_sha256_set_impl(saved);
+    vxssh_mem_deref(buf);
+    return err;
+}
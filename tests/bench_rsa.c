@@ -0,0 +1,191 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include <tickLib.h>
+#include <sysLib.h>
+#include "emssh.h"
+
+static const int BENCH_RSA_BITS[] = { 1024, 2048, 3072 };
+
+/* random number of exactly bits, odd if asked */
+static void bench_random(mpz_t x, int bits, bool odd) {
+    uint8_t buf[384];
+    int len = (bits + 7) / 8;
+
+    vxssh_rnd_bin((char *)buf, len);
+    buf[0] &= (0xff >> (len * 8 - bits));
+    buf[0] |= (0x80 >> (len * 8 - bits));
+    if(odd) {
+        buf[len - 1] |= 1;
+    }
+    mpz_import(x, len, 1, 1, 0, 0, buf);
+}
+
+/**
+ * the private operation of an rsa-N sign is two N/2-bit exponentiations (CRT),
+ * binary mpz_powm() vs montgomery mpz_powm_sec(), results are compared
+ **/
+int vxssh_bench_powm() {
+    mpz_t m, e, b, r1, r2;
+    int i, s, rounds, err = OK;
+    ULONG t0, t1, t2;
+
+    mpz_init(m);
+    mpz_init(e);
+    mpz_init(b);
+    mpz_init(r1);
+    mpz_init(r2);
+
+    for(s = 0; s < sizeof(BENCH_RSA_BITS) / sizeof(BENCH_RSA_BITS[0]); s++) {
+        const int bits = BENCH_RSA_BITS[s] / 2;
+
+        bench_random(m, bits, true);
+        bench_random(e, bits, false);
+        bench_random(b, bits - 1, false);
+        rounds = (BENCH_RSA_BITS[s] <= 1024 ? 64 : 16);
+
+        t0 = tickGet();
+        for(i = 0; i < rounds; i++) {
+            mpz_powm(r1, b, e, m);
+        }
+        t1 = tickGet();
+        for(i = 0; i < rounds; i++) {
+            mpz_powm_sec(r2, b, e, m);
+        }
+        t2 = tickGet();
+
+        if(mpz_cmp(r1, r2) != 0) {
+            vxssh_log_error("rsa-%i: result mismatch", BENCH_RSA_BITS[s]);
+            err = ERROR;
+            continue;
+        }
+        vxssh_log_debug("rsa-%i sign (2 x %i-bit powm): binary %u us, montgomery %u us", BENCH_RSA_BITS[s], bits,
+            (uint32_t)(((t1 - t0) * 2000000ULL) / (sysClkRateGet() * rounds)), (uint32_t)(((t2 - t1) * 2000000ULL) / (sysClkRateGet() * rounds)));
+    }
+
+    mpz_clear(m);
+    mpz_clear(e);
+    mpz_clear(b);
+    mpz_clear(r1);
+    mpz_clear(r2);
+    return err;
+}
+
+#define BENCH_MUL_LIMBS_MAX     128
+#define BENCH_MUL_WORK          (1 << 24)   /* limb products per measurement */
+
+static const int BENCH_MUL_LIMBS[] = { 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+
+/* ticks of rounds n x n products (sqr: a x a) */
+static ULONG bench_mul(mp_ptr rp, mp_srcptr ap, mp_srcptr bp, int n, int rounds, bool sqr) {
+    ULONG t = tickGet();
+    int i;
+
+    for(i = 0; i < rounds; i++) {
+        if(sqr) {
+            mpn_sqr(rp, ap, n);
+        } else {
+            mpn_mul_n(rp, ap, bp, n);
+        }
+    }
+    return tickGet() - t;
+}
+
+/**
+ * Karatsuba thresholds for the target: at every size one level of karatsuba
+ * (the halves in the schoolbook) against the schoolbook,
+ * the size from which it keeps winning is the threshold for mp_set_karatsuba_thresholds()
+ **/
+int vxssh_bench_karatsuba() {
+    mp_limb_t *ap = NULL, *bp = NULL, *rp = NULL, *tp = NULL;
+    int s, n, rounds, mul_th = 0, sqr_th = 0, err = OK;
+    ULONG tb, tk;
+
+    ap = vxssh_mem_alloc(BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t), NULL);
+    bp = vxssh_mem_alloc(BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t), NULL);
+    rp = vxssh_mem_alloc(2 * BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t), NULL);
+    tp = vxssh_mem_alloc(2 * BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t), NULL);
+    if(!ap || !bp || !rp || !tp) {
+        err = ENOMEM; goto out;
+    }
+    vxssh_rnd_bin((char *)ap, BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t));
+    vxssh_rnd_bin((char *)bp, BENCH_MUL_LIMBS_MAX * sizeof(mp_limb_t));
+
+    for(s = 0; s < sizeof(BENCH_MUL_LIMBS) / sizeof(BENCH_MUL_LIMBS[0]); s++) {
+        n = BENCH_MUL_LIMBS[s];
+        rounds = BENCH_MUL_WORK / (n * n);
+
+        /* mul */
+        mp_set_karatsuba_thresholds(n + 1, 0);
+        mpn_mul_n(tp, ap, bp, n);
+        tb = bench_mul(rp, ap, bp, n, rounds, false);
+        mp_set_karatsuba_thresholds(n, 0);
+        mpn_mul_n(rp, ap, bp, n);
+        if(mpn_cmp(rp, tp, 2 * n) != 0) {
+            vxssh_log_error("mul %i limbs: result mismatch", n);
+            err = ERROR; goto out;
+        }
+        tk = bench_mul(rp, ap, bp, n, rounds, false);
+        mul_th = (tk < tb ? (mul_th ? mul_th : n) : 0);
+        vxssh_log_debug("mul %i limbs: schoolbook %u ticks, karatsuba %u ticks", n, tb, tk);
+
+        /* sqr */
+        mp_set_karatsuba_thresholds(0, n + 1);
+        mpn_sqr(tp, ap, n);
+        tb = bench_mul(rp, ap, ap, n, rounds, true);
+        mp_set_karatsuba_thresholds(0, n);
+        mpn_sqr(rp, ap, n);
+        if(mpn_cmp(rp, tp, 2 * n) != 0) {
+            vxssh_log_error("sqr %i limbs: result mismatch", n);
+            err = ERROR; goto out;
+        }
+        tk = bench_mul(rp, ap, ap, n, rounds, true);
+        sqr_th = (tk < tb ? (sqr_th ? sqr_th : n) : 0);
+        vxssh_log_debug("sqr %i limbs: schoolbook %u ticks, karatsuba %u ticks", n, tb, tk);
+    }
+    vxssh_log_debug("karatsuba thresholds: mul %i, sqr %i limbs (0 - not reached)", mul_th, sqr_th);
+
+out:
+    mp_set_karatsuba_thresholds(0, 0);
+    vxssh_mem_deref(ap);
+    vxssh_mem_deref(bp);
+    vxssh_mem_deref(rp);
+    vxssh_mem_deref(tp);
+    return err;
+}
+
+#define BENCH_LIMB_N            64
+#define BENCH_LIMB_ROUNDS       (1 << 18)
+
+/**
+ * the double-limb multiply under mpn_mul_1() and mpn_addmul_1(),
+ * build with MINI_GMP_NO_ASM for the portable C numbers
+ **/
+int vxssh_bench_mul_1() {
+    mp_limb_t ap[BENCH_LIMB_N], rp[BENCH_LIMB_N];
+    mp_limb_t v, cy = 0;
+    ULONG t0, t1, t2;
+    uint32_t limbs;
+    int i;
+
+    vxssh_rnd_bin((char *)ap, sizeof(ap));
+    vxssh_rnd_bin((char *)&v, sizeof(v));
+    memset(rp, 0, sizeof(rp));
+
+    t0 = tickGet();
+    for(i = 0; i < BENCH_LIMB_ROUNDS; i++) {
+        cy += mpn_mul_1(rp, ap, BENCH_LIMB_N, v + i);
+    }
+    t1 = tickGet();
+    for(i = 0; i < BENCH_LIMB_ROUNDS; i++) {
+        cy += mpn_addmul_1(rp, ap, BENCH_LIMB_N, v + i);
+    }
+    t2 = tickGet();
+
+    limbs = (uint32_t) BENCH_LIMB_N * BENCH_LIMB_ROUNDS;
+    vxssh_log_debug("%i-bit limbs, %u limb products: mul_1 %u ms, addmul_1 %u ms (%x)", mp_bits_per_limb, limbs,
+        (uint32_t)(((t1 - t0) * 1000) / sysClkRateGet()), (uint32_t)(((t2 - t1) * 1000) / sysClkRateGet()), (uint32_t) cy);
+    return OK;
+}
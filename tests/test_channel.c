@@ -0,0 +1,177 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "emssh.h"
+#include "vxssh_utils.h"
+
+#define TEST_CHANNEL_ID     3
+#define TEST_REQUEST_TYPE   "keepalive@openssh.com"
+
+/* a connected loopback pair: the session end and the client end */
+static int loopback_pair(int *sfd, int *cfd) {
+    struct sockaddr_in addr;
+    socklen_t alen = sizeof(addr);
+    int lfd = ERROR, err = OK;
+
+    *sfd = *cfd = ERROR;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0;
+
+    if((lfd = socket(AF_INET, SOCK_STREAM, 0)) == ERROR) {
+        err = ERROR; goto out;
+    }
+    if(bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) == ERROR || listen(lfd, 1) == ERROR) {
+        err = ERROR; goto out;
+    }
+    if(getsockname(lfd, (struct sockaddr *)&addr, &alen) == ERROR) {
+        err = ERROR; goto out;
+    }
+    if((*cfd = socket(AF_INET, SOCK_STREAM, 0)) == ERROR) {
+        err = ERROR; goto out;
+    }
+    if(connect(*cfd, (struct sockaddr *)&addr, sizeof(addr)) == ERROR) {
+        err = ERROR; goto out;
+    }
+    alen = sizeof(addr);
+    if((*sfd = accept(lfd, (struct sockaddr *)&addr, &alen)) == ERROR) {
+        err = ERROR; goto out;
+    }
+
+out:
+    if(lfd != ERROR) {
+        close(lfd);
+    }
+    if(err != OK && *cfd != ERROR) {
+        close(*cfd);
+        *cfd = ERROR;
+    }
+    return err;
+}
+
+/* a want_reply request the server doesn't know, it is answered with CHANNEL_FAILURE */
+static int channel_request(vxssh_session_t *session) {
+    vxssh_mbuf_t *mbuf = session->iobuf;
+
+    vxssh_mbuf_clear(mbuf);
+    vxssh_mbuf_write_u8(mbuf, SSH_MSG_CHANNEL_REQUEST);
+    vxssh_mbuf_write_u32(mbuf, TEST_CHANNEL_ID);
+    vxssh_mbuf_write_str_sz(mbuf, TEST_REQUEST_TYPE);
+    vxssh_mbuf_write_u8(mbuf, 1);
+    vxssh_mbuf_set_pos(mbuf, 0);
+
+    return vxssh_packet_do_channel_request(session);
+}
+
+/* reads the plain packets the session sent, each of them has to be CHANNEL_FAILURE for the test channel */
+static int expect_replies(int fd, int count) {
+    vxssh_mbuf_t *mbuf = NULL;
+    uint8_t buf[256];
+    uint32_t plen = 0;
+    int rd = 0, err = OK;
+
+    if((err = vxssh_mbuf_alloc(&mbuf, sizeof(buf))) != OK) {
+        goto out;
+    }
+    while(vxssh_fd_select_read(fd, 250000)) {
+        if((rd = read(fd, (char *)buf, sizeof(buf))) <= 0) {
+            break;
+        }
+        vxssh_mbuf_write_mem(mbuf, buf, rd);
+    }
+
+    vxssh_mbuf_set_pos(mbuf, 0);
+    for(; count > 0; count--) {
+        if(vxssh_mbuf_get_left(mbuf) < 10) {
+            vxssh_log_error("a reply is missing");
+            err = ERROR; goto out;
+        }
+        plen = vxssh_mbuf_read_u32(mbuf);
+        if(plen < 6 || plen > vxssh_mbuf_get_left(mbuf)) {
+            vxssh_log_error("malformed reply (%u)", plen);
+            err = ERROR; goto out;
+        }
+        vxssh_mbuf_read_u8(mbuf);
+        if(vxssh_mbuf_read_u8(mbuf) != SSH_MSG_CHANNEL_FAILURE || vxssh_mbuf_read_u32(mbuf) != TEST_CHANNEL_ID) {
+            vxssh_log_error("unexpected reply");
+            err = ERROR; goto out;
+        }
+        vxssh_mbuf_set_pos(mbuf, mbuf->pos + plen - 6);
+    }
+    if(vxssh_mbuf_get_left(mbuf) > 0) {
+        vxssh_log_error("more replies than expected");
+        err = ERROR; goto out;
+    }
+
+out:
+    vxssh_mem_deref(mbuf);
+    return err;
+}
+
+/* channel requests made between our KEXINIT and our NEWKEYS are answered after the NEWKEYS (RFC 4253, 7.1) */
+int vxssh_test_channel_rekey() {
+    vxssh_session_t *session = NULL;
+    int cfd = ERROR, err = OK;
+
+    vxssh_log_debug("channel rekey tests ...");
+
+    if((err = vxssh_session_alloc(&session)) != OK) {
+        goto out;
+    }
+    if((err = loopback_pair(&session->socfd, &cfd)) != OK) {
+        vxssh_log_error("loopback connection fail");
+        goto out;
+    }
+
+    /* at once outside of a rekey */
+    if((err = channel_request(session)) != OK) {
+        goto out;
+    }
+    if(session->send_seq != 1 || (err = expect_replies(cfd, 1)) != OK) {
+        vxssh_log_error("reply wasn't sent");
+        err = ERROR; goto out;
+    }
+
+    /* held after our KEXINIT, on both sides of the client one */
+    session->rekey_state = VXSSH_REKEY_STATE_KEXINIT_SENT;
+    if((err = channel_request(session)) != OK) {
+        goto out;
+    }
+    session->rekey_state = VXSSH_REKEY_STATE_WAIT_ECDH_INIT;
+    if((err = channel_request(session)) != OK) {
+        goto out;
+    }
+    if(session->send_seq != 1 || vxssh_fd_select_read(cfd, 250000)) {
+        vxssh_log_error("reply sent in the middle of the rekey");
+        err = ERROR; goto out;
+    }
+
+    /* our NEWKEYS is out */
+    session->rekey_state = VXSSH_REKEY_STATE_WAIT_NEWKEYS;
+    if((err = vxssh_packet_send_channel_deferred(session)) != OK) {
+        goto out;
+    }
+    if(session->send_seq != 3 || session->defer != NULL || (err = expect_replies(cfd, 2)) != OK) {
+        vxssh_log_error("held replies weren't sent");
+        err = ERROR; goto out;
+    }
+
+    /* nothing is held until the next rekey */
+    if((err = vxssh_packet_send_channel_deferred(session)) != OK || session->send_seq != 3) {
+        vxssh_log_error("held replies sent twice");
+        err = ERROR; goto out;
+    }
+
+out:
+    if(cfd != ERROR) {
+        close(cfd);
+    }
+    vxssh_mem_deref(session);
+
+    vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
+    return err;
+}
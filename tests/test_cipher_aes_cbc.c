@@ -26,8 +26,8 @@ int vxssh_test_aes_cbc() {
         vxssh_log_error("vxssh_cipher_alloc(1) fail, err=%i", err);
         goto out;
     }
-    cip_enc->iv = vxssh_mem_dup(iv, sizeof(iv));
-    cip_enc->key = vxssh_mem_dup(key, sizeof(key));
+    memcpy(cip_enc->iv, iv, sizeof(iv));
+    memcpy(cip_enc->key, key, sizeof(key));
 
     if((err = vxssh_cipher_init(cip_enc)) != OK) {
         vxssh_log_error("vxssh_cipher_init(1) fail, err=%i", err);
@@ -50,8 +50,8 @@ int vxssh_test_aes_cbc() {
         vxssh_log_error("vxssh_cipher_alloc(2) fail, err=%i", err);
         goto out;
     }
-    cip_dec->iv = vxssh_mem_dup(iv, sizeof(iv));
-    cip_dec->key = vxssh_mem_dup(key, sizeof(key));
+    memcpy(cip_dec->iv, iv, sizeof(iv));
+    memcpy(cip_dec->key, key, sizeof(key));
 
     if((err = vxssh_cipher_init(cip_dec)) != OK) {
         vxssh_log_error("vxssh_cipher_init(2) fail, err=%i", err);
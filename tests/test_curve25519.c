@@ -0,0 +1,180 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "emssh.h"
+
+static void hex2bin(const char *hex, uint8_t *out, size_t out_len) {
+    size_t i;
+    unsigned int v;
+
+    for(i = 0; i < out_len; i++) {
+        sscanf(hex + i * 2, "%2x", &v);
+        out[i] = (uint8_t) v;
+    }
+}
+
+static int x25519_test(const char *scalar_hex, const char *u_hex, const char *result_hex) {
+    uint8_t k[CRYPTO_CURVE25519_SIZE], u[CRYPTO_CURVE25519_SIZE];
+    uint8_t r[CRYPTO_CURVE25519_SIZE], t[CRYPTO_CURVE25519_SIZE];
+
+    hex2bin(scalar_hex, k, sizeof(k));
+    hex2bin(u_hex, u, sizeof(u));
+    hex2bin(result_hex, t, sizeof(t));
+
+    vxssh_scalarmult_curve25519(r, k, u);
+    if(memcmp(r, t, sizeof(r))) {
+        vxssh_hexdump2("CUR.....: ", r, sizeof(r));
+        vxssh_hexdump2("EXPECTED: ", t, sizeof(t));
+        return ERROR;
+    }
+    return OK;
+}
+
+/* RFC 7748, 5.2: k = u = 9, then k <- X25519(k, u), u <- k */
+static int x25519_iterated_test(int iterations, const char *result_hex) {
+    uint8_t k[CRYPTO_CURVE25519_SIZE] = {9}, u[CRYPTO_CURVE25519_SIZE] = {9};
+    uint8_t r[CRYPTO_CURVE25519_SIZE], t[CRYPTO_CURVE25519_SIZE];
+    int i;
+
+    for(i = 0; i < iterations; i++) {
+        vxssh_scalarmult_curve25519(r, k, u);
+        memcpy(u, k, sizeof(u));
+        memcpy(k, r, sizeof(k));
+    }
+
+    hex2bin(result_hex, t, sizeof(t));
+    if(memcmp(k, t, sizeof(k))) {
+        vxssh_hexdump2("CUR.....: ", k, sizeof(k));
+        vxssh_hexdump2("EXPECTED: ", t, sizeof(t));
+        return ERROR;
+    }
+    return OK;
+}
+
+/* fixed-base keygen path against the ladder */
+static int x25519_base_test(int count) {
+    static const uint8_t basepoint[CRYPTO_CURVE25519_SIZE] = {9};
+    uint8_t k[CRYPTO_CURVE25519_SIZE];
+    uint8_t r1[CRYPTO_CURVE25519_SIZE], r2[CRYPTO_CURVE25519_SIZE];
+    int i, err;
+
+    if((err = vxssh_curve25519_base_init()) != OK) {
+        vxssh_log_error("vxssh_curve25519_base_init() fail, err=%i", err);
+        return err;
+    }
+
+    /* 6.1: Alice's public key */
+    hex2bin("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", k, sizeof(k));
+    hex2bin("8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a", r2, sizeof(r2));
+    vxssh_scalarmult_curve25519_base(r1, k);
+    if(memcmp(r1, r2, sizeof(r1))) {
+        vxssh_hexdump2("CUR.....: ", r1, sizeof(r1));
+        vxssh_hexdump2("EXPECTED: ", r2, sizeof(r2));
+        return ERROR;
+    }
+
+    for(i = 0; i < count; i++) {
+        vxssh_rnd_bin((char *)k, sizeof(k));
+        vxssh_scalarmult_curve25519_base(r1, k);
+        vxssh_scalarmult_curve25519(r2, k, basepoint);
+        if(memcmp(r1, r2, sizeof(r1))) {
+            vxssh_hexdump2("BASE....: ", r1, sizeof(r1));
+            vxssh_hexdump2("LADDER..: ", r2, sizeof(r2));
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+/* keypair pool: every pair is valid and handed out only once */
+static int x25519_pool_test() {
+    static const uint8_t basepoint[CRYPTO_CURVE25519_SIZE] = {9};
+    uint8_t k1[CRYPTO_CURVE25519_SIZE], p1[CRYPTO_CURVE25519_SIZE];
+    uint8_t k2[CRYPTO_CURVE25519_SIZE], p2[CRYPTO_CURVE25519_SIZE];
+    uint8_t r[CRYPTO_CURVE25519_SIZE];
+    int i, err = OK;
+
+    if((err = vxssh_kex_c25519_pool_start()) != OK) {
+        vxssh_log_error("vxssh_kex_c25519_pool_start() fail, err=%i", err);
+        return err;
+    }
+    for(i = 0; i < 100 && vxssh_kex_c25519_pool_take(k1, p1) != OK; i++) {
+        taskDelay(1);
+    }
+    if(i == 100) {
+        vxssh_log_error("pool is still empty");
+        err = ERROR; goto out;
+    }
+    for(i = 0; i < 100 && vxssh_kex_c25519_pool_take(k2, p2) != OK; i++) {
+        taskDelay(1);
+    }
+    if(i == 100) {
+        vxssh_log_error("pool is still empty");
+        err = ERROR; goto out;
+    }
+    vxssh_scalarmult_curve25519(r, k1, basepoint);
+    if(memcmp(r, p1, sizeof(r)) || !memcmp(k1, k2, sizeof(k1))) {
+        vxssh_hexdump2("KEY1....: ", k1, sizeof(k1));
+        vxssh_hexdump2("KEY2....: ", k2, sizeof(k2));
+        err = ERROR; goto out;
+    }
+out:
+    vxssh_kex_c25519_pool_stop();
+    explicit_bzero(k1, sizeof(k1));
+    explicit_bzero(k2, sizeof(k2));
+    return err;
+}
+
+int vxssh_test_curve25519() {
+    int err = OK;
+
+    vxssh_log_debug("curve25519 tests (RFC 7748)...");
+
+    /* 5.2 */
+    if((err = x25519_test("a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",
+                          "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",
+                          "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552")) != OK) {
+        goto out;
+    }
+    if((err = x25519_test("4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d",
+                          "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493",
+                          "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957")) != OK) {
+        goto out;
+    }
+    if((err = x25519_iterated_test(1, "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079")) != OK) {
+        goto out;
+    }
+    if((err = x25519_iterated_test(1000, "684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51")) != OK) {
+        goto out;
+    }
+
+    /* 6.1: public keys and the shared secret */
+    if((err = x25519_test("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+                          "0900000000000000000000000000000000000000000000000000000000000000",
+                          "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a")) != OK) {
+        goto out;
+    }
+    if((err = x25519_test("5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb",
+                          "0900000000000000000000000000000000000000000000000000000000000000",
+                          "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f")) != OK) {
+        goto out;
+    }
+    if((err = x25519_test("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+                          "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f",
+                          "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742")) != OK) {
+        goto out;
+    }
+
+    if((err = x25519_base_test(16)) != OK) {
+        goto out;
+    }
+    if((err = x25519_pool_test()) != OK) {
+        goto out;
+    }
+
+out:
+    vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
+    return err;
+}
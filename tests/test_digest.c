@@ -54,6 +54,28 @@ static int digest_test(int alg, char *msg, size_t mlen, uint8_t *digest, size_t
     return err;
 }
 
+/* a freed pool block keeps its data, so the state can be looked at after the deref */
+static int digest_wipe_test(int alg) {
+    vxssh_digest_ctx_t *ctx = NULL;
+    uint8_t *state;
+    size_t i, len;
+
+    if(vxssh_mem_pool_init(0) != OK || vxssh_digest_alloc(&ctx, alg) != OK) {
+        return ENOMEM;
+    }
+    vxssh_digest_update(ctx, "secret", 6);
+    state = (uint8_t *) ctx->state;
+    len = ctx->ops->ctx_size;
+    vxssh_mem_deref(ctx);
+
+    for(i = 0; i < len && state[i] == 0; i++);
+    if(i != len) {
+        vxssh_log_error("digest %i: the state wasn't wiped", alg);
+        return ERROR;
+    }
+    return OK;
+}
+
 int vxssh_test_digest() {
     int err = OK;
     char *msg = "what do ya want for nothing?";
@@ -67,11 +89,21 @@ int vxssh_test_digest() {
     uint8_t h_sha256[]={
         0xb3,0x81,0xe7,0xfe,0xc6,0x53,0xfc,0x3a,0xb9,0xb1,0x78,0x27,0x23,0x66,0xb8,0xac,0x87,0xfe,0xd8,0xd3,0x1c,0xb2,0x5e,0xd1,0xd0,0xe1,0xf3,0x31,0x86,0x44,0xc8,0x9c
     };
+    uint8_t h_sha512[]={
+        0xa3,0xad,0xca,0x3c,0x9c,0x1e,0x45,0xb3,0x9e,0xf5,0x1b,0x07,0x03,0x69,0x2e,0x09,0xab,0x3a,0x20,0x40,0x4d,0xd7,0x61,0x75,0x37,0x14,0x47,0x20,0xf3,0x5e,0x30,0x4e,
+        0x89,0xe5,0x30,0xdb,0x6d,0xb9,0xde,0xb5,0x0f,0x8b,0x33,0xe3,0x8d,0x95,0x1f,0x2f,0xfc,0x97,0x30,0x85,0xb7,0xf0,0xcc,0xb1,0x11,0x78,0x79,0x9d,0x11,0x34,0x81,0xf2
+    };
 
     vxssh_log_debug("Digest tests...");
     err = digest_test(VXSSH_DIGEST_MD5, msg, strlen(msg), h_md5, sizeof(h_md5));
     err = digest_test(VXSSH_DIGEST_SHA1, msg, strlen(msg), h_sha1, sizeof(h_sha1));
     err = digest_test(VXSSH_DIGEST_SHA256, msg, strlen(msg), h_sha256, sizeof(h_sha256));
+    err = digest_test(VXSSH_DIGEST_SHA512, msg, strlen(msg), h_sha512, sizeof(h_sha512));
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
+    if(err == OK) {
+        err = digest_wipe_test(VXSSH_DIGEST_SHA256);
+    }
+#endif
     vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
 
     return err;
@@ -5,12 +5,12 @@
  **/
 #include "emssh.h"
 
-static int hmac_test(void *key, size_t klen, void *m, size_t mlen, uint8_t *e, size_t elen) {
+static int hmac_test(int alg, void *key, size_t klen, void *m, size_t mlen, uint8_t *e, size_t elen) {
     vxssh_hmac_ctx_t *ctx;
-    uint8_t digest[VXSSH_DIGEST_MD5_LENGTH];
+    uint8_t digest[VXSSH_DIGEST_LENGTH_MAX];
     int  i, err = OK;
 
-    err = vxssh_hmac_alloc(&ctx, VXSSH_DIGEST_MD5);
+    err = vxssh_hmac_alloc(&ctx, alg);
     if(err != OK) {
         vxssh_log_error("vxssh_hmac_alloc() fail, err=%i", err);
         return err;
@@ -25,7 +25,7 @@ static int hmac_test(void *key, size_t klen, void *m, size_t mlen, uint8_t *e, s
         vxssh_log_error("vxssh_hmac_update() fail, err=%i", err);
         return err;
     }
-    err = vxssh_hmac_final(ctx, digest, sizeof(digest));
+    err = vxssh_hmac_final(ctx, digest, elen);
     if(err != OK) {
         vxssh_log_error("vxssh_hmac_final() fail, err=%i", err);
         return err;
@@ -45,6 +45,29 @@ static int hmac_test(void *key, size_t klen, void *m, size_t mlen, uint8_t *e, s
     return err;
 }
 
+/* the digests and the key buffer, looked at in the freed pool block */
+static int hmac_wipe_test(int alg) {
+    vxssh_hmac_ctx_t *ctx = NULL;
+    uint8_t *p;
+    size_t i, len;
+
+    if(vxssh_mem_pool_init(0) != OK || vxssh_hmac_alloc(&ctx, alg) != OK) {
+        return ENOMEM;
+    }
+    vxssh_hmac_init(ctx, "secret", 6);
+    vxssh_hmac_update(ctx, "data", 4);
+    p = (uint8_t *) ctx->ictx;
+    len = (ctx->buf + ctx->buf_len) - p;
+    vxssh_mem_deref(ctx);
+
+    for(i = 0; i < len && p[i] == 0; i++);
+    if(i != len) {
+        vxssh_log_error("hmac %i: the context wasn't wiped", alg);
+        return ERROR;
+    }
+    return OK;
+}
+
 int vxssh_test_hmac() {
     int err = OK;
 
@@ -65,6 +88,17 @@ int vxssh_test_hmac() {
         0xea, 0xa8, 0x6e, 0x31, 0x0a, 0x5d, 0xb7, 0x38
     };
 
+    uint8_t dig2_sha256[32] = {
+        0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e, 0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+        0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83, 0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+    };
+    uint8_t dig2_sha512[64] = {
+        0x16, 0x4b, 0x7a, 0x7b, 0xfc, 0xf8, 0x19, 0xe2, 0xe3, 0x95, 0xfb, 0xe7, 0x3b, 0x56, 0xe0, 0xa3,
+        0x87, 0xbd, 0x64, 0x22, 0x2e, 0x83, 0x1f, 0xd6, 0x10, 0x27, 0x0c, 0xd7, 0xea, 0x25, 0x05, 0x54,
+        0x97, 0x58, 0xbf, 0x75, 0xc0, 0x5a, 0x99, 0x4a, 0x6d, 0x03, 0x4f, 0x65, 0xf8, 0xf0, 0xe6, 0xfd,
+        0xca, 0xea, 0xb1, 0xa3, 0x4d, 0x4a, 0x6b, 0x4b, 0x63, 0x6e, 0x07, 0x0a, 0x38, 0xbc, 0xe7, 0x37
+    };
+
     uint8_t key3[16];
     uint8_t data3[50];
     uint8_t dig3[16] = {
@@ -76,9 +110,19 @@ int vxssh_test_hmac() {
 
     vxssh_log_debug("HMAC tests (MD5)...");
 
-    err = hmac_test(key1, sizeof(key1), data1, strlen(data1), dig1, sizeof(dig1));
-    err = hmac_test(key2, strlen(key2), data2, strlen(data2), dig2, sizeof(dig2));
-    err = hmac_test(key3, sizeof(key3), data3, sizeof(data3), dig3, sizeof(dig3));
+    err = hmac_test(VXSSH_DIGEST_MD5, key1, sizeof(key1), data1, strlen(data1), dig1, sizeof(dig1));
+    err = hmac_test(VXSSH_DIGEST_MD5, key2, strlen(key2), data2, strlen(data2), dig2, sizeof(dig2));
+    err = hmac_test(VXSSH_DIGEST_MD5, key3, sizeof(key3), data3, sizeof(data3), dig3, sizeof(dig3));
+
+    vxssh_log_debug("HMAC tests (SHA2)...");
+
+    err = hmac_test(VXSSH_DIGEST_SHA256, key2, strlen(key2), data2, strlen(data2), dig2_sha256, sizeof(dig2_sha256));
+    err = hmac_test(VXSSH_DIGEST_SHA512, key2, strlen(key2), data2, strlen(data2), dig2_sha512, sizeof(dig2_sha512));
+#ifdef VXSSH_MEMORY_CLEAR_ON_DEREF
+    if(err == OK) {
+        err = hmac_wipe_test(VXSSH_DIGEST_SHA512);
+    }
+#endif
 
     vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
 
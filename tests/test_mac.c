@@ -22,7 +22,7 @@ int vxssh_test_mac() {
         vxssh_log_error("vxssh_mac_alloc() fail, err=%i", err);
         goto out;
     }
-    ctx->key = vxssh_mem_dup(key, sizeof(key));
+    memcpy(ctx->key, key, sizeof(key));
 
     if((err = vxssh_mac_init(ctx)) != OK) {
         vxssh_log_error("vxssh_mac_init() fail, err=%i", err);
@@ -0,0 +1,188 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "emssh.h"
+
+static int destructor_calls = 0;
+
+static void test_destructor(void *data) {
+    destructor_calls++;
+}
+
+/* the class of every size, growing through the classes, refs and destructors on pool blocks */
+int vxssh_test_mem_pool() {
+    vxssh_mem_pool_stats_t st0[VXSSH_MEM_POOL_CLASSES], st[VXSSH_MEM_POOL_CLASSES];
+    uint32_t large0 = 0, large = 0;
+    uint8_t *p = NULL;
+    size_t sz;
+    int c, err = OK;
+
+    vxssh_log_debug("mem pool tests ...");
+
+    destructor_calls = 0;
+    if((err = vxssh_mem_pool_init(0)) != OK) {
+        goto out;
+    }
+    vxssh_mem_pool_get_stats(st0, &large0);
+    for(sz = 1, c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        for(; sz <= st0[c].size; sz++) {
+            if((p = vxssh_mem_alloc(sz, NULL)) == NULL) {
+                err = ENOMEM; goto out;
+            }
+            memset(p, 0xa5, sz);
+            vxssh_mem_pool_get_stats(st, NULL);
+            if(st[c].used != st0[c].used + 1) {
+                vxssh_log_error("%u bytes: wrong class", (uint32_t) sz);
+                err = ERROR; goto out;
+            }
+            p = vxssh_mem_deref(p);
+        }
+    }
+
+    /* realloc keeps the content and the header */
+    if((p = vxssh_mem_alloc(10, test_destructor)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    vxssh_mem_ref(p);
+    for(sz = 0; sz < 10; sz++) {
+        p[sz] = (uint8_t) sz;
+    }
+    for(sz = 16; sz <= 2 * VXSSH_MEM_POOL_MAX_SIZE; sz *= 2) {
+        if((p = vxssh_mem_realloc(p, sz)) == NULL) {
+            err = ENOMEM; goto out;
+        }
+        for(c = 0; c < 10 && p[c] == c; c++);
+        if(c != 10 || vxssh_mem_get_refs(p) != 2) {
+            vxssh_log_error("realloc to %u bytes lost the data", (uint32_t) sz);
+            err = ERROR; goto out;
+        }
+    }
+    vxssh_mem_pool_get_stats(st, &large);
+    if(large != large0 + 1) {
+        vxssh_log_error("large block wasn't counted");
+        err = ERROR; goto out;
+    }
+    vxssh_mem_deref(p);
+    p = vxssh_mem_deref(p);
+    if(destructor_calls != 1) {
+        vxssh_log_error("destructor calls: %i", destructor_calls);
+        err = ERROR; goto out;
+    }
+
+    /* everything is back */
+    vxssh_mem_pool_get_stats(st, &large);
+    for(c = 0; c < VXSSH_MEM_POOL_CLASSES; c++) {
+        if(st[c].used != st0[c].used) {
+            vxssh_log_error("class %u: %u blocks leaked", st[c].size, st[c].used - st0[c].used);
+            err = ERROR; goto out;
+        }
+    }
+    if(large != large0) {
+        err = ERROR; goto out;
+    }
+    vxssh_mem_pool_show();
+out:
+    vxssh_mem_deref(p);
+    vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
+    return err;
+}
+
+/* the bottom and the scope, the scope end, realloc out of the arena, the pool when it's full */
+int vxssh_test_mem_arena() {
+    vxssh_mem_arena_t *arena = NULL;
+    uint8_t *a = NULL, *b = NULL, *c = NULL;
+    size_t hi;
+    int i, err = OK;
+
+    vxssh_log_debug("mem arena tests ...");
+
+    destructor_calls = 0;
+    if((err = vxssh_mem_arena_alloc(&arena, VXSSH_MEM_POOL_MAX_SIZE)) != OK) {
+        goto out;
+    }
+    hi = arena->hi;
+
+    /* the scope objects go to the pool until it's open */
+    if((a = vxssh_mem_arena_scope_zalloc(arena, 32, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    if(arena->hi != hi || (a >= arena->buf && a < arena->buf + arena->size)) {
+        vxssh_log_error("scope object without the scope");
+        err = ERROR; goto out;
+    }
+    a = vxssh_mem_deref(a);
+
+    if((a = vxssh_mem_arena_zalloc(arena, 20, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    vxssh_mem_arena_scope_begin(arena);
+    if((b = vxssh_mem_arena_scope_zalloc(arena, 100, test_destructor)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    for(i = 0; i < 100 && b[i] == 0; i++);
+    if(i != 100 || b < arena->buf + arena->lo || b >= arena->buf + arena->size || ((size_t) b & 7)) {
+        vxssh_log_error("scope object isn't zeroed or aligned");
+        err = ERROR; goto out;
+    }
+    memset(b, 0xa5, 100);
+
+    /* a referenced object keeps the scope */
+    if(vxssh_mem_arena_scope_end(arena) != EBUSY) {
+        vxssh_log_error("scope was released with a live object");
+        err = ERROR; goto out;
+    }
+    b = vxssh_mem_deref(b);
+    if(destructor_calls != 1 || vxssh_mem_arena_scope_end(arena) != OK || arena->hi != hi || arena->fl_scope) {
+        vxssh_log_error("scope end fail");
+        err = ERROR; goto out;
+    }
+    for(i = 0; i < arena->size - arena->lo && arena->buf[arena->lo + i] == 0; i++);
+    if(i != arena->size - arena->lo) {
+        vxssh_log_error("scope wasn't wiped");
+        err = ERROR; goto out;
+    }
+
+    /* realloc moves it to the pool with the content */
+    vxssh_mem_arena_scope_begin(arena);
+    if((b = vxssh_mem_arena_scope_zalloc(arena, 16, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    memset(b, 0x5a, 16);
+    if((c = vxssh_mem_realloc(b, 16)) != b) {
+        vxssh_log_error("realloc within the block moved it");
+        err = ERROR; goto out;
+    }
+    if((c = vxssh_mem_realloc(b, 200)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    b = NULL;
+    for(i = 0; i < 16 && c[i] == 0x5a; i++);
+    if(i != 16 || (c >= arena->buf && c < arena->buf + arena->size)) {
+        vxssh_log_error("realloc out of the arena fail");
+        err = ERROR; goto out;
+    }
+    if(vxssh_mem_arena_scope_end(arena) != OK) {
+        vxssh_log_error("moved object kept the scope");
+        err = ERROR; goto out;
+    }
+    c = vxssh_mem_deref(c);
+
+    /* full, goes to the pool */
+    if((b = vxssh_mem_arena_zalloc(arena, arena->size, NULL)) == NULL) {
+        err = ENOMEM; goto out;
+    }
+    if(arena->misses != 1 || (b >= arena->buf && b < arena->buf + arena->size)) {
+        vxssh_log_error("misses: %u", arena->misses);
+        err = ERROR; goto out;
+    }
+    vxssh_log_debug("arena: %u of %u bytes used, peak %u", (uint32_t) arena->lo, (uint32_t) arena->size, (uint32_t) arena->peak);
+out:
+    vxssh_mem_deref(a);
+    vxssh_mem_deref(b);
+    vxssh_mem_deref(c);
+    vxssh_mem_deref(arena);
+    vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
+    return err;
+}
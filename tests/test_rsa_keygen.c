@@ -0,0 +1,95 @@
+/**
+ *
+ * Copyright (C) AlexandrinKS
+ * https://akscf.org/
+ **/
+#include "emssh.h"
+
+static uint32_t keygen_stages[3];
+
+static int keygen_progress(int stage, uint32_t count, void *udata) {
+    keygen_stages[stage] = count;
+    return OK;
+}
+
+/* x^(e*d) = x (mod n) and the CRT parameters agree with d */
+static int rsa_key_check(vxssh_crypto_rsa_private_key_t *key, uint32_t bits) {
+    mpz_t x, y, t;
+    int err = OK;
+
+    mpz_init_set_ui(x, 0x1234567);
+    mpz_init(y);
+    mpz_init(t);
+    if(mpz_sizeinbase(key->n, 2) != bits || mpz_cmp(key->p, key->q) <= 0) {
+        err = ERROR; goto out;
+    }
+    mpz_mul(t, key->p, key->q);
+    if(mpz_cmp(t, key->n) != 0) {
+        err = ERROR; goto out;
+    }
+    mpz_powm(y, x, key->d, key->n);
+    mpz_powm(t, y, key->e, key->n);
+    if(mpz_cmp(t, x) != 0) {
+        err = ERROR; goto out;
+    }
+    mpz_mul(t, key->q, key->qinv);
+    mpz_mod(t, t, key->p);
+    if(mpz_cmp_ui(t, 1) != 0) {
+        err = ERROR; goto out;
+    }
+out:
+    mpz_clear(x);
+    mpz_clear(y);
+    mpz_clear(t);
+    return err;
+}
+
+int vxssh_test_rsa_keygen() {
+    vxssh_crypto_object_t *key = NULL, *key2 = NULL;
+    vxssh_crypto_rsa_private_key_t *k1, *k2;
+    vxssh_mbuf_t *mb = NULL;
+    int err = OK;
+
+    vxssh_log_debug("RSA keygen tests ...");
+
+    if((err = vxssh_rsa_generate_key(&key, 1024, keygen_progress, NULL)) != OK) {
+        vxssh_log_error("vxssh_rsa_generate_key() fail, err=%i", err);
+        goto out;
+    }
+    vxssh_log_debug("1024 bits: %u windows sieved, %u candidates tested", keygen_stages[VXSSH_RSA_KEYGEN_STAGE_SIEVE], keygen_stages[VXSSH_RSA_KEYGEN_STAGE_CANDIDATE]);
+    k1 = key->obj;
+    if(keygen_stages[VXSSH_RSA_KEYGEN_STAGE_PRIME] != 2 || (err = rsa_key_check(k1, 1024)) != OK) {
+        vxssh_log_error("invalid key");
+        err = ERROR; goto out;
+    }
+
+    /* persisted form */
+    if((err = vxssh_mbuf_alloc(&mb, 0)) != OK) {
+        goto out;
+    }
+    if((err = vxssh_rsa_key_save(mb, k1)) != OK) {
+        goto out;
+    }
+    vxssh_mbuf_set_pos(mb, 0);
+    if((err = vxssh_rsa_key_load(mb, &key2)) != OK) {
+        goto out;
+    }
+    k2 = key2->obj;
+    if(mpz_cmp(k1->n, k2->n) || mpz_cmp(k1->d, k2->d) || mpz_cmp(k1->dp, k2->dp) || mpz_cmp(k1->dq, k2->dq) || mpz_cmp(k1->qinv, k2->qinv)) {
+        vxssh_log_error("loaded key mismatch");
+        err = ERROR; goto out;
+    }
+    key2 = vxssh_mem_deref(key2);
+    mb->buf[mb->end / 2] ^= 0x1;
+    vxssh_mbuf_set_pos(mb, 0);
+    if(vxssh_rsa_key_load(mb, &key2) == OK) {
+        vxssh_log_error("corrupted key was loaded");
+        err = ERROR; goto out;
+    }
+out:
+    vxssh_log_debug("%s", err == OK ? "SUCCESS" : "FAIL");
+    vxssh_mem_deref(mb);
+    vxssh_mem_deref(key);
+    vxssh_mem_deref(key2);
+    return err;
+}